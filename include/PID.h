@@ -1,7 +1,7 @@
 #ifndef _PID_H
 #define _PID_H
 
-#include <Arduino.h>
+#include <stdint.h>
 
 #define PID_PIN_RELAY           25
 #define PID_WINDOW_SIZE         5000
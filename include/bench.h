@@ -0,0 +1,27 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+
+// build with -DBENCH_ENABLE to compile the benchmark and its hooks in other modules (config)
+
+#define BENCH_ITERATIONS        1000    // timed calls of controller and GUI hot paths
+#define BENCH_PID_ITERATIONS    50      // PID computes once per PID_INTERVAL_COMPUTE, every call waits for it
+#define BENCH_CONF_ITERATIONS   5       // bake list store/load (flash bound)
+#define BENCH_LINE_LENGTH       160     // max length of one result line
+
+typedef void (* benchOutputCb)( const char * line );
+
+/**
+ * Time hot paths of the controller (PID, heater, buzzer), bake list and on the target also of GUI setters
+ * Every benchmark gives one JSON line:
+ *   {"bench":"PID_Compute","iter":50,"min":1234,"avg":1300,"max":1500,"unit":"cycles","mhz":240}
+ * Heater is started with 0C setpoint (relay stays off) and stopped afterwards, bake list is not changed
+ * Call from the task which edits the bake list, takes about BENCH_PID_ITERATIONS * PID_INTERVAL_COMPUTE
+ * output   - called with every line (NULL terminated, with new line)
+ *
+ * return   - false when not compiled in or the heater is running
+ */
+bool BENCH_Run( benchOutputCb output );
+
+#endif  // _BENCH_H_
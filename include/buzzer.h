@@ -11,6 +11,12 @@
  */
 void BUZZ_Init( void );
 
+/**
+ * Update buzzer output according to 'buzzing' list (called by buzzer task every 10ms)
+ * currentTime  -   [milliseconds], nothing is done when it's the same as in the previous call
+ */
+void BUZZ_Handle( unsigned long currentTime );
+
 /**
  * Add 'buzzing' to the list, it will be triggered according to provided parameters
  * startDelay   -   'buzzing' will be triggered after this time [milliseconds]
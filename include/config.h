@@ -1,58 +1,56 @@
 #ifndef _CONFIG_H_
 #define _CONFIG_H_
 
-#include "SPI.h"
-#include "WString.h"
+#include "hal.h"
+#include "persist.h"
+#include "helper.h"
 
 // #define BAKES_COUNT       20
-#define BAKE_NAME_LENGTH    64
 #define BAKE_FILE_NAME      "/bakes.txt"
-#define BAKE_MAX_STEPS      10    // how much steps can be in one 'bakes curve'
+// #define CONF_LAZY_STEPS         // only names stay in RAM, steps are read from flash on demand (for big bake lists)
 
-typedef char bakeName[ BAKE_NAME_LENGTH ];
-
-typedef struct
-{
-  int32_t  temp;
-  int32_t  time;
-} bakeStep_t;
-
-typedef struct
-{
-  bakeName    name;
-  uint32_t    stepCount;
-  bakeStep_t  step[ BAKE_MAX_STEPS ];
-} bake_t;
+// options kept by configuration module
+typedef enum confOption {
+  CONF_OPT_BUZZER = 0,    // bool
+  CONF_OPT_OTA,           // bool
+  CONF_OPT_COUNT
+} confOption_t;
 
 /**
- * Need to be called from main Setup/Init function to run the service
+ * Need to be called from main Setup/Init function to run the service (after PERSIST_Init())
+ * Bake list functions have to be called from one task only (flash writes are done by persistence worker)
  * spi      - SPI instance for SDCard operations
  */
-void CONF_Init( SPIClass * spi );
+void CONF_Init( halSpi_t * spi );
 
 /**
- * Get specific configuration option
+ * Get specific configuration option (served from RAM, options are loaded once by CONF_Init)
  * option   - which options you're interested in
  * 
- * return   - options value
+ * return   - options value (default value when option has different type)
  */
-int CONF_getOptionInt( int32_t option );
-bool CONF_getOptionBool( int32_t option );
+int CONF_getOptionInt( confOption_t option );
+bool CONF_getOptionBool( confOption_t option );
 
 /**
  * Set specific configuration option
- * option   - which options you're interested in (EEPROM address)
+ * Value is changed in RAM immediately, all changes are written to NVS together shortly after the last one
+ * option   - which options you're interested in
  * value    - value to be stored
  */
-void CONF_setOptionBool( int32_t option, bool value );
-void CONF_setOptionInt( int32_t option, int32_t value );
+void CONF_setOptionBool( confOption_t option, bool value );
+void CONF_setOptionInt( confOption_t option, int32_t value );
+
+/**
+ * Get number of bakes on the list
+ */
+uint32_t CONF_getBakeCount( void );
 
 /**
- * Get all names from bake list
- * array    - pointer to dynamically allocated memory where bake names will be stored
- * cnt      - number of elements in allocated memory
+ * Get bake list generation, it changes on every list modification (add/remove/swap/move/reorder)
+ * When it differs from the one seen before, all positions seen before are outdated
  */
-void CONF_getBakeNames( bakeName **bList, uint32_t *cnt );
+uint32_t CONF_getBakeListGeneration( void );
 
 /**
  * Get temperature for specified bake
@@ -72,6 +70,18 @@ uint32_t CONF_getBakeTemp( uint32_t idx, uint32_t step );
  */
 int32_t CONF_getBakeTime( uint32_t idx, uint32_t step );
 
+/**
+ * Copy name and all steps of specified bake at once (consistent even when the list is modified meanwhile)
+ * idx      - index for particular bake on the list (count from 0)
+ * name     - output buffer for the name (NULL - not needed)
+ * nameSize - name buffer size (BAKE_NAME_LENGTH is enough)
+ * steps[]  - output array for steps
+ * max      - steps[] size (BAKE_MAX_STEPS is enough)
+ *
+ * return   - number of steps copied, 0 when bake doesn't exist or steps can't be read
+ */
+uint32_t CONF_copyBake( uint32_t idx, char * name, uint32_t nameSize, bakeStep_t steps[], uint32_t max );
+
 /**
  * Get steps count for specified bake
  * idx      - index for particular bake on the list (count from 0)
@@ -83,35 +93,104 @@ uint32_t CONF_getBakeStepCount( uint32_t idx );
 /**
  * Get specified bake's name
  * idx      - index for particular bake on the list (count from 0)
+ * name     - buffer for name copy (NULL terminated, BAKE_NAME_LENGTH is enough)
+ * size     - buffer size
  * 
- * return   - pointer to name (NULL terminated)
+ * return   - false when there is no such bake
  */
-char * CONF_getBakeName( uint32_t idx );
+bool CONF_getBakeName( uint32_t idx, char * name, uint32_t size );
 
 /**
- * Remove bakes from the list
- * list[]   - array with indexes (which bake positions on the list should be removed, count from 0)
+ * Remove bakes from the list (change is journaled on flash in background)
+ * list[]   - array with indexes (which bake positions on the list should be removed, count from 0, any order)
+ * count    - number of elements in list[] (no limit)
  * 
  * return   - true if bakes found on the list and removed
  */
-bool CONF_removeBakes( uint8_t list[], uint32_t count );
+bool CONF_removeBakes( const uint16_t list[], uint32_t count );
 
 /**
- * Swap two bakes on the list
- * list[]   - array with indexes (which bake positions on the list should be swapped, count from 0)
+ * Swap two bakes on the list (change is journaled on flash in background)
+ * first, second  - bake positions on the list (count from 0)
  * 
  * return   - true if bakes found on the list and swapped
  */
-bool CONF_swapBakes( uint8_t list[] );
+bool CONF_swapBakes( uint32_t first, uint32_t second );
+
+/**
+ * Move bake to another position, bakes in between are shifted by one (change is journaled on flash in background)
+ * from     - current bake position (count from 0)
+ * to       - new bake position (count from 0)
+ * 
+ * return   - true if bake found on the list and moved
+ */
+bool CONF_moveBake( uint32_t from, uint32_t to );
+
+/**
+ * Arrange whole bake list at once (change is journaled on flash in background)
+ * order[]  - for every new position: current position of the bake placed there (each bake exactly once)
+ * count    - number of elements in order[], has to be equal to bakes count
+ * 
+ * return   - true if order[] was valid and applied
+ */
+bool CONF_reorderBakes( const uint16_t order[], uint32_t count );
+
+/**
+ * Find bakes by name (case insensitive), uses name index kept up to date with the list
+ * Bakes with name starting with query come first, then the ones containing it (query of 3+ chars)
+ * query    - text to look for
+ * results  - buffer for positions of found bakes (count from 0)
+ * max      - results buffer size
+ * 
+ * return   - number of found bakes (written to results)
+ */
+uint32_t CONF_findBakes( const char * query, uint16_t results[], uint32_t max );
 
 /**
- * Add bakes from file to current list
+ * Add bakes from file to current list (new bakes are journaled on flash in background)
+ * Blocks while the file is read, call it from the task editing the bake list
  */
 void CONF_addBakesFromFile( void );
 
 /**
- * Save bake list as file on spiffs partition
+ * Save whole bake list as new snapshot file on flash (LittleFS, atomic replace) and start new, empty journal
+ * Not needed after ordinary edits, those are journaled and merged into snapshot automatically
  */
 void CONF_storeBakeList( void );
 
+/**
+ * Write all waiting changes (options and bake list edits) to flash without waiting for their usual delay
+ * Writing is done by persistence worker, the call returns immediately
+ * done     - called from worker task when everything is written (can be NULL)
+ */
+void CONF_flush( persistDoneCb done );
+
+#ifdef BENCH_ENABLE
+/**
+ * Bake list benchmark hooks (see bench.h), call them from the task which edits the bake list
+ * Bake list on flash is never touched, the benchmark uses its own file
+ */
+
+/**
+ * Write current bake list (all steps) to benchmark file as snapshot
+ */
+bool CONF_benchStore( void );
+
+/**
+ * Swap in empty scratch list, edits made from now on are neither journaled nor persisted
+ * return   - false when the list can't be swapped now (snapshot being written, benchmark already running)
+ */
+bool CONF_benchBegin( void );
+
+/**
+ * Empty scratch list and parse benchmark file into it (steps are kept in RAM)
+ */
+bool CONF_benchLoad( void );
+
+/**
+ * Drop scratch list, bring the real one back and remove benchmark file
+ */
+void CONF_benchEnd( void );
+#endif
+
 #endif  // _CONFIG_H_
@@ -0,0 +1,89 @@
+#ifndef _CONTROLLER_H_
+#define _CONTROLLER_H_
+
+#include <stdint.h>
+#include "helper.h"
+
+#define CONTROLLER_STACK_SIZE       8192
+#define CONTROLLER_TASK_PRIORITY    2       // above loop() (GUI), below heater
+#define CONTROLLER_QUEUE_LENGTH     16      // user commands waiting for the controller task (heater doesn't use it)
+#define CONTROLLER_STEPS_MAX        8       // state machine passes per event (chained transitions)
+#define CONTROLLER_TICK             100     // state machine runs at least this often, special events watch temperature [ms]
+#define CONTROLLER_POST_RETRY       10      // command waiting for free queue slot tries again after this time [ms]
+
+// controller task notification bits, repeated ones are merged until the task takes them
+#define CTRL_NOTIFY_COMMAND         0x01    // command queued
+#define CTRL_NOTIFY_HEATER_DONE     0x02    // heater: heating time is up
+
+// controller task commands, everything changing bake state goes through its queue (heater uses notification bit)
+typedef enum {
+    CTRL_EVT_START = 0,         // user: START
+    CTRL_EVT_STOP,              // user: STOP
+    CTRL_EVT_PAUSE,             // user: PAUSE/CONTINUE
+    CTRL_EVT_SET_TEMP,          // user: value - temperature [C]
+    CTRL_EVT_SET_TIME,          // user: value - time [ms]
+    CTRL_EVT_ADJUST_TIME,       // user: value - change [min]
+    CTRL_EVT_BAKE_PICKUP,       // user: value - bake index, arg - long press (start immediately)
+    CTRL_EVT_COUNT
+} ctrl_event_type;
+
+typedef struct {
+    ctrl_event_type type;
+    int32_t         value;
+    uint32_t        arg;
+} ctrlEvent_t;
+
+// controller state published for other tasks (screen, shell), written by controller task only
+typedef struct {
+    heater_state    state;
+    uint16_t        targetTemp;             // [C]
+    uint32_t        targetTime;             // [ms]
+    uint32_t        targetUpdates;          // increased whenever targets have to be shown again (also with the same values)
+    bool            manual;                 // manual operation, no bake selected
+    uint32_t        bakeIdx;                // selected bake (count from 0)
+    char            bakeName[ BAKE_NAME_LENGTH ];
+    uint32_t        step;                   // running segment of the bake (count from 0)
+    uint32_t        steps;
+    int32_t         event;                  // special event of the running segment, 0 - heating
+    uint32_t        totalTime;              // expected duration of the whole bake [ms]
+    uint32_t        remainingAfter;         // expected duration of segments after the running one [ms]
+    bool            segmentTimed;           // running segment counts time (doesn't wait for user)
+    buttonsGroup_t  buttons;                // operation buttons to show
+    bool            changeAllowed;          // target time/temperature can be edited
+    bool            blinkFrame;             // screen frame blinks (heating)
+    bool            blinkTime;              // current time blinks (paused, waiting for user)
+    uint32_t        mainTabRequests;        // increased when main tab has to be shown (bake picked up)
+} ctrlStatus_t;
+
+/**
+ * Bake state change notification (e.g. for MQTT), called from controller task
+ * name     - "bake" (value: bake number, 0 - manual operation) or "state" (value: heater_state)
+ */
+typedef void (* ctrlEventCb)( const char * name, int32_t value );
+
+/**
+ * Need to be called from main Setup/Init function to run the service (after HEATER_Init() and CONF_Init())
+ * Heater callback is taken by the controller
+ */
+void CTRL_Init( void );
+
+/**
+ * Set bake state change notification (call before CTRL_Init())
+ */
+void CTRL_setEventCallback( ctrlEventCb callback );
+
+/**
+ * Queue command for the controller task, command is never dropped: caller waits for free slot when the controller is behind
+ * Can be called from any task except controller and heater (heater lock held)
+ * type     - CTRL_EVT_x
+ * value    - see ctrl_event_type
+ * arg      - see ctrl_event_type
+ */
+void CTRL_Post( ctrl_event_type type, int32_t value, uint32_t arg );
+
+/**
+ * Get consistent copy of the state published by the controller (any task)
+ */
+void CTRL_getStatus( ctrlStatus_t * status );
+
+#endif  // _CONTROLLER_H_
@@ -4,22 +4,12 @@
 #include <stdint.h>
 #include "SPI.h"
 #include "lvgl.h"
+#include "helper.h"
 
-#define BAKES_TO_REMOVE_MAX         5  // how much elements can be removed from bakes list at once
-#define MINUTE_TO_MILLIS(m)         ((m) * 60 * 1000)
-#define HOUR_TO_MILLIS(h)           ((h) * 60 * 60 * 1000)
-#define MAX_ALLOWED_TIME            ( HOUR_TO_MILLIS(99) + MINUTE_TO_MILLIS(59) )   // 100 hours max
 #define BLINK_TIMECURRENT_FREQ      500
 #define BLINK_SCREENFRAME_FREQ      500
 #define DEFAULT_TAB_AFTER_MS        10000
-
-typedef enum operationButton {
-    BUTTONS_START = 1,
-    BUTTONS_PAUSE_STOP,
-    BUTTONS_CONTINUE_STOP,
-    BUTTONS_STOP,
-    BUTTONS_MAX_COUNT
-} buttonsGroup_t;
+#define BAKE_FILTER_LENGTH          32      // max length of bake search text (including NULL)
 
 // available options
 typedef enum optionType {
@@ -56,8 +46,11 @@ typedef void (* updateTempCb)( uint16_t );
 typedef void (* operationCb)( void );
 typedef void (* bakePickupCb)( uint32_t, bool );
 typedef void (* adjustTimeCb)( int32_t );
-typedef void (* removeBakesCb)( const uint8_t * );
-typedef void (* swapBakesCb)( const uint8_t * );
+typedef void (* removeBakesCb)( const uint16_t *, uint32_t );
+typedef void (* swapBakesCb)( uint32_t, uint32_t );
+typedef void (* moveBakeCb)( uint32_t, uint32_t );
+typedef bool (* bakeNameCb)( uint32_t, char *, uint32_t );   // position, buffer for name copy, buffer size
+typedef void (* bakeFilterCb)( const char * );
 
 /**
  * Need to be called from main Setup/Init function to run the service
@@ -154,6 +147,18 @@ void GUI_setRemoveBakesFromListCallback( removeBakesCb func );
  */
 void GUI_setSwapBakesOnListCallback( swapBakesCb func );
 
+/**
+ * Set a callback function that will be called when user click on 'Move bake' option
+ * func             -   callback function (from, to: bake positions counted from 0)
+ */
+void GUI_setMoveBakeOnListCallback( moveBakeCb func );
+
+/**
+ * Set a callback function that will be called when user changes text in bake search field
+ * func             -   callback function (current search text, empty when search is cleared)
+ */
+void GUI_setBakeFilterCallback( bakeFilterCb func );
+
 /**
  * Set which group of buttons should be shown on the screen
  * btnGroup         -   BUTTON_START or BUTTON_PAUSE_STOP
@@ -184,12 +189,18 @@ void GUI_setBlinkScreenFrame( bool active );
 SPIClass * GUI_getSPIinstance( void );
 
 /**
- * Show bake names as list on the screen
- * nameList         - pointer to memory where all names are (treat as elements of type char* with nameLength length)
- * nameLength       - max name length (every element on the list can be such long)
+ * Show bake names as list on the screen (first BAKE_ROWS_MAX positions, the rest is reachable by search)
+ * getName          - function copying name of given position (count from 0), kept for GUI_filterBakeList()
  * nameCount        - number of position on the list
  */
-void GUI_populateBakeListNames( char *nameList, uint32_t nameLength, uint32_t nameCount );
+void GUI_populateBakeListNames( bakeNameCb getName, uint32_t nameCount );
+
+/**
+ * Show only some positions of bake list (rows are created for them, until next call)
+ * positions        - positions to show (count from 0, shown in this order), NULL: show whole list
+ * count            - number of elements in positions
+ */
+void GUI_filterBakeList( const uint16_t positions[], uint32_t count );
 
 /**
  * Set time's progress bar fill out
@@ -227,6 +238,12 @@ void GUI_setPowerIndicator( bool active );
  */
 void GUI_setSoundIcon( bool active );
 
+/**
+ * Set remaining time of the whole bake (all steps) on the screen
+ * time     - remaining time [ms], 0 - hide (manual operation)
+ */
+void GUI_setTotalTime( uint32_t time );
+
 /**
  * Activate WiFi icon
  * active           - whether the icon should be glowing
@@ -246,4 +263,23 @@ void GUI_optionsPopulate( setting_t options[], uint32_t cnt );
  */
 void GUI_updateOption( setting_t &option );
 
+/**
+ * Hidden diagnostics page: opened by long press on options TAB button, closed by click on it
+ */
+bool GUI_isDiagnosticsVisible( void );
+
+/**
+ * Set text shown on diagnostics page
+ * text             - multi-line text
+ */
+void GUI_setDiagnosticsText( const char * text );
+
+/**
+ * Get LVGL heap usage
+ * used/total       - [bytes]
+ *
+ * return           - false when LVGL allocates from system heap (no own heap)
+ */
+bool GUI_getMemoryUsage( uint32_t * used, uint32_t * total );
+
 #endif  // _GUI_H
@@ -0,0 +1,239 @@
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Hardware abstraction for portable modules (PID, buzzer, heater, logger, ...)
+// ESP32 backend: src/hal_esp32.cpp (Arduino + FreeRTOS), POSIX backend: src/hal_posix.cpp ([env:native])
+
+#define HAL_WAIT_FOREVER      UINT32_MAX      // mutex timeout without limit
+#define HAL_CORE_ANY          -1              // task isn't pinned to any core
+
+#ifdef ARDUINO
+  #include <Arduino.h>
+  #include "SPI.h"
+
+  #define HAL_FLASH_ROOT        "/littlefs"   // VFS mount point of the flash partition
+  #define HAL_FLASH_PARTITION   "spiffs"      // partition label from partition table (the one used by SPIFFS before)
+  #define HAL_FLASH_MAX_FILES   5
+  #define HAL_IRAM              IRAM_ATTR     // function called from ISR or with flash cache disabled
+
+  typedef SPIClass      halSpi_t;
+  typedef StackType_t   halStack_t;
+
+  typedef struct {
+    SemaphoreHandle_t   handle;
+    StaticSemaphore_t   buffer;
+  } halMutex_t;
+
+  typedef struct {
+    TaskHandle_t        handle;
+    StaticTask_t        tcb;
+  } halTask_t;
+#else
+  #include <math.h>
+  #include <pthread.h>
+
+  #define HAL_FLASH_ROOT        "flash"       // directory relative to working directory
+  #define HAL_IRAM
+
+  // SPI bus without hardware, device model answers the transfers (e.g. simulated thermocouple)
+  typedef struct {
+    uint16_t          (* transfer16)( uint8_t cs );   // NULL - bus reads 0xFFFF (nothing attached)
+  } halSpi_t;
+
+  typedef uint8_t       halStack_t;         // threads get default stack, buffer from the module is not used
+
+  typedef struct {
+    pthread_mutex_t     handle;
+  } halMutex_t;
+
+  typedef struct {
+    pthread_t           handle;
+    void              (* func)( void * );
+    void              * param;
+    const char        * name;
+    pthread_mutex_t     notifyLock;
+    pthread_cond_t      notifyCond;
+    uint32_t            notified;         // bits set by HAL_taskNotify(), guarded by notifyLock
+  } halTask_t;
+#endif
+
+/**
+ * Time since start [ms], wraps after ~49 days
+ */
+uint32_t HAL_millis( void );
+
+/**
+ * Time since start [us], wraps after ~71 minutes
+ */
+uint32_t HAL_micros( void );
+
+/**
+ * Block calling task at least for given time (other tasks run meanwhile)
+ * ms       - delay [ms]
+ */
+void HAL_delay( uint32_t ms );
+
+/**
+ * CPU cycle counter of the core running the caller (POSIX: host nanoseconds scaled by HAL_cpuMhz(), simulated clock doesn't apply)
+ */
+uint32_t HAL_cycles( void );
+
+/**
+ * CPU frequency for HAL_cycles() to time conversion [MHz]
+ */
+uint32_t HAL_cpuMhz( void );
+
+/**
+ * Core running the caller (POSIX: always 0)
+ */
+uint8_t HAL_coreId( void );
+
+/**
+ * Configure pin as output
+ * pin      - GPIO number
+ * level    - initial output level
+ */
+void HAL_pinOutput( uint8_t pin, bool level );
+
+/**
+ * Set output level of the pin configured by HAL_pinOutput()
+ */
+void HAL_pinWrite( uint8_t pin, bool level );
+
+/**
+ * Read back output level (POSIX: last written level, lets host programs watch relay/buzzer)
+ */
+bool HAL_pinRead( uint8_t pin );
+
+/**
+ * Start SPI bus
+ */
+void HAL_spiBegin( halSpi_t * spi );
+
+/**
+ * Read 16 bits from SPI device in one transaction (mode 0, MSB first)
+ * spi      - bus
+ * cs       - chip select pin (active low)
+ * frequency- SPI clock [Hz]
+ *
+ * return   - received word
+ */
+uint16_t HAL_spiRead16( halSpi_t * spi, uint8_t cs, uint32_t frequency );
+
+/**
+ * Create mutex (without priority inheritance on POSIX)
+ */
+void HAL_mutexInit( halMutex_t * mutex );
+
+/**
+ * Take mutex
+ * timeout  - [ms], 0 - don't wait, HAL_WAIT_FOREVER - wait without limit
+ *
+ * return   - true when taken
+ */
+bool HAL_mutexTake( halMutex_t * mutex, uint32_t timeout );
+
+/**
+ * Release mutex taken by HAL_mutexTake()
+ */
+void HAL_mutexGive( halMutex_t * mutex );
+
+/**
+ * Create task running given function (function never returns)
+ * task     - task control block, has to stay valid (static)
+ * func     - task body
+ * name     - task name, has to stay valid
+ * stack    - stack buffer (not used on POSIX)
+ * stackSize- stack size [StackType_t]
+ * priority - FreeRTOS priority (not used on POSIX)
+ * core     - core to pin the task to, HAL_CORE_ANY - not pinned
+ *
+ * return   - true when task runs
+ */
+bool HAL_taskCreate( halTask_t * task, void (* func)( void * ), const char * name, halStack_t * stack, uint32_t stackSize, uint32_t priority, int32_t core );
+
+/**
+ * Name of the task calling it (pointer is the same for all calls from one task)
+ */
+const char * HAL_taskName( void );
+
+/**
+ * Set notification bits of the task, never blocks (task wakes up from HAL_taskWait())
+ * task     - task created by HAL_taskCreate()
+ * bits     - ORed to bits not taken by the task yet
+ */
+void HAL_taskNotify( halTask_t * task, uint32_t bits );
+
+/**
+ * Wait for notification bits of the calling task (task created by HAL_taskCreate() only)
+ * timeout  - [ms], HAL_WAIT_FOREVER - wait without limit
+ *
+ * return   - bits set since the previous call (they are cleared), 0 on timeout
+ */
+uint32_t HAL_taskWait( uint32_t timeout );
+
+/**
+ * Mount flash filesystem at HAL_FLASH_ROOT (POSIX: create the directory)
+ * format   - format partition if it can't be mounted
+ *
+ * return   - true when mounted
+ */
+bool HAL_fsMount( bool format );
+
+/**
+ * Flash filesystem size
+ * total    - output, partition size [B]
+ * used     - output, space taken by files [B]
+ */
+void HAL_fsUsage( uint32_t * total, uint32_t * used );
+
+/**
+ * Read integer from non-volatile key/value storage (ESP: NVS, POSIX: file per key under HAL_FLASH_ROOT)
+ * space    - namespace (15 chars max)
+ * key      - key (15 chars max)
+ * value    - output, untouched when key doesn't exist
+ *
+ * return   - true when key exists
+ */
+bool HAL_nvsGetInt( const char * space, const char * key, int32_t * value );
+
+/**
+ * Write integer to non-volatile key/value storage, nothing is written when the same value is stored (flash wear)
+ *
+ * return   - true on success
+ */
+bool HAL_nvsSetInt( const char * space, const char * key, int32_t value );
+
+/**
+ * Write text to console (Serial / stdout)
+ */
+void HAL_print( const char * text );
+int HAL_printf( const char * format, ... ) __attribute__(( format( printf, 1, 2 ) ));
+
+#ifndef ARDUINO
+/**
+ * Switch POSIX backend to simulated clock, call before any task is created
+ * Time stands still except in HAL_simRun(), tasks become coroutines of the calling thread
+ * and HAL_delay() only moves them in simulated time (closed loop runs much faster than real time)
+ * Tasks must not wait for mutex held by other task (nothing else runs meanwhile)
+ */
+void HAL_simEnable( void );
+
+/**
+ * Run tasks in order of their wake up time until simulated time reaches given point
+ * HAL_delay() called outside of tasks does the same for now + delay
+ * until    - simulated time [us]
+ */
+void HAL_simRun( uint64_t until );
+
+/**
+ * Simulated time [us] (not wrapping)
+ */
+uint64_t HAL_simTime( void );
+#endif
+
+#endif  // _HAL_H_
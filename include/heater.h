@@ -1,7 +1,7 @@
 #ifndef _HEATER_H
 #define _HEATER_H
 
-#include "SPI.h"
+#include "hal.h"
 
 #define HEATER_STACK_SIZE       2048
 #define HEATER_TASK_PRIORITY    3
@@ -17,7 +17,12 @@ typedef void (* heaterDoneCb)( void );
  * Need to be called from main Setup/Init function to run the service
  * spi      - pointer to SPI instance which will be used for communication
  */
-void HEATER_Init( SPIClass * spi );
+void HEATER_Init( halSpi_t * spi );
+
+/**
+ * One control cycle: check heating time, compute PID (called by heater task every PID_INTERVAL_COMPUTE)
+ */
+void HEATER_Handle( void );
 
 /**
  * Set target temperature
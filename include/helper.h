@@ -1,10 +1,17 @@
 #ifndef _HELPER_H
 #define _HELPER_H
 
+#include <stdint.h>
+
 #define MM_SS_TO_HH_MM(a)           ((a) * 60)
 #define SECONDS_TO_MILISECONDS(a)   ((a) * 1000)
 #define MINUTES_TO_SECONDS(a)       ((a) * 60)
 #define HOURS_TO_SECONDS(a)         (MINUTES_TO_SECONDS((a) * 60))
+#define MINUTE_TO_MILLIS(m)         ((m) * 60 * 1000)
+#define HOUR_TO_MILLIS(h)           ((h) * 60 * 60 * 1000)
+#define MAX_ALLOWED_TIME            ( HOUR_TO_MILLIS(99) + MINUTE_TO_MILLIS(59) )   // 100 hours max
+#define BAKE_NAME_LENGTH            64
+#define BAKE_MAX_STEPS              255     // how much steps can be in one 'bakes curve' (memory is taken only for steps really used)
 #define BUZZ_EVENT_PREHEATING       100, 10000, UINT32_MAX
 #define BUZZ_EVENT_TEMP_REACHED     5000, 25000, UINT32_MAX
 #define BUZZ_EVENT_PAUSE            1000, 9000, UINT32_MAX
@@ -57,4 +64,20 @@ typedef enum {
     EVENT_STATE_COUNT
 } event_state;
 
+// operation buttons shown on the main tab
+typedef enum operationButton {
+    BUTTONS_START = 1,
+    BUTTONS_PAUSE_STOP,
+    BUTTONS_CONTINUE_STOP,
+    BUTTONS_STOP,
+    BUTTONS_MAX_COUNT
+} buttonsGroup_t;
+
+// one step of the bake's curve as stored in the bake list
+typedef struct
+{
+  int32_t  temp;
+  int32_t  time;
+} bakeStep_t;
+
 #endif  // _HELPER_H
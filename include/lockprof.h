@@ -0,0 +1,80 @@
+#ifndef _LOCKPROF_H_
+#define _LOCKPROF_H_
+
+#include <stdint.h>
+#include "hal.h"
+
+#define LOCK_HIST_BUCKETS     8       // wait/hold histogram: <16us, <64us, <256us, <1ms, <4ms, <16ms, <64ms, longer
+#define LOCK_SITES_MAX        12      // callers (function + task) tracked per lock, the rest is counted as "other"
+#define LOCK_REPORT_LENGTH    3072    // text report buffer size for all locks
+
+typedef struct {
+  const char  * site;           // function taking the lock
+  const char  * task;           // task it was called from
+  uint32_t      count;
+  uint32_t      holdMax;        // [us]
+  uint64_t      holdTotal;      // [us]
+  uint32_t      blockedCount;   // times other caller had to wait while this one held the lock
+  uint32_t      blockedMax;     // longest wait it caused [us]
+} lockSite_t;
+
+typedef struct {
+  uint32_t      takes;
+  uint32_t      contended;      // lock was not free at the first attempt
+  uint32_t      timeouts;
+  uint32_t      waitHist[ LOCK_HIST_BUCKETS ];    // contended takes only
+  uint32_t      holdHist[ LOCK_HIST_BUCKETS ];
+  uint32_t      waitMax;        // [us]
+  const char  * waitMaxSite;    // who waited longest
+  const char  * waitMaxHolder;  // and who held the lock meanwhile
+  uint32_t      otherCount;     // takes from sites not fitting into the table
+  lockSite_t    site[ LOCK_SITES_MAX ];
+} lockStats_t;
+
+// HAL mutex with contention statistics, statistics are guarded by the mutex itself
+typedef struct profLock {
+  halMutex_t          mutex;
+  const char        * name;
+  const char        * ownerSite;  // valid while taken
+  const char        * ownerTask;
+  uint32_t            takenAt;    // HAL_micros() time [us]
+  int32_t             siteIdx;    // owner's lockSite_t, -1 - other
+  lockStats_t         stats;
+  struct profLock   * next;       // list of all locks for the report
+} profLock_t;
+
+/**
+ * Create the mutex and register it for LOCK_format(), call once before other tasks use it
+ * name     - shown in report, must stay valid
+ */
+void LOCK_Init( profLock_t * lock, const char * name );
+
+/**
+ * Take the mutex like HAL_mutexTake(), caller function name is recorded
+ * timeout  - [ms], HAL_WAIT_FOREVER - wait without limit
+ *
+ * return   - true when taken
+ */
+#define LOCK_Take( lock, timeout )    LOCK_TakeFrom( (lock), (timeout), __func__ )
+bool LOCK_TakeFrom( profLock_t * lock, uint32_t timeout, const char * site );
+
+/**
+ * Release the mutex, hold time is recorded
+ */
+void LOCK_Give( profLock_t * lock );
+
+/**
+ * Clear statistics of all locks
+ */
+void LOCK_Reset( void );
+
+/**
+ * Format statistics of all locks as multi-line text report
+ * buf      - output buffer (LOCK_REPORT_LENGTH is enough)
+ * size     - buffer size
+ *
+ * return   - report length
+ */
+uint32_t LOCK_format( char * buf, uint32_t size );
+
+#endif  // _LOCKPROF_H_
@@ -0,0 +1,48 @@
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include <stdint.h>
+
+#define LOG_STACK_SIZE        3072
+#define LOG_TASK_PRIORITY     1     // lowest priority, output must never delay UI/heater
+#define LOG_QUEUE_LENGTH      32    // number of records waiting for output (power of 2)
+#define LOG_TEXT_LENGTH       92    // max length of one message including NULL (longer one is truncated)
+#define LOG_DRAIN_PERIOD      20    // how often records are written out [ms]
+
+typedef enum {
+  LOG_ERROR = 0,
+  LOG_WARNING,
+  LOG_INFO,
+  LOG_DEBUG,
+} logLevel;
+
+typedef void (* logSinkCb)( const char * text );
+
+/**
+ * Need to be called from main Setup/Init function to run the output task
+ * Messages logged before are kept in the queue (up to LOG_QUEUE_LENGTH)
+ */
+void LOG_Init( void );
+
+/**
+ * Messages above given level are ignored (not formatted at all), default is LOG_INFO
+ */
+void LOG_setLevel( logLevel level );
+
+/**
+ * Additional output (e.g. telnet client) for every record, called from the output task after console output
+ * func     - NULL - console only
+ */
+void LOG_setSink( logSinkCb func );
+
+/**
+ * Format message into fixed size record and queue it, never blocks nor allocates (safe with mutex held)
+ * Record is written to console and the sink by low priority task, new line is added
+ * level    - message importance
+ * format   - printf like format string
+ *
+ * return   - false when message was dropped (queue full or level filtered)
+ */
+bool LOG_Printf( logLevel level, const char * format, ... ) __attribute__(( format( printf, 2, 3 ) ));
+
+#endif  // _LOGGER_H_
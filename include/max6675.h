@@ -1,18 +1,19 @@
 #ifndef _MAX6675_H
 #define _MAX6675_H
 
-#include "SPI.h"
+#include "hal.h"
 
 #define TEMP_READ_INTERVAL      1000        // in millis
 #define MAX6675_STACK_SIZE      1536
 #define MAX6675_TASK_PRIORITY   3
+#define MAX6675_SPI_FREQUENCY   4000000     // max SPI speed used succesfully:25MHz
 
 /**
  * Need to be called from main Setup/Init function to run the service
  * spi          - SPI instance which will be used for communication
  * _CS          - SPI chip select pin
  */
-void MAX6675_Init( SPIClass * spi, int8_t _CS );
+void MAX6675_Init( halSpi_t * spi, int8_t _CS );
 
 /**
  * Read temperature
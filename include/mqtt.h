@@ -0,0 +1,70 @@
+#ifndef _MQTT_H_
+#define _MQTT_H_
+
+#include <stdint.h>
+
+#ifndef MQTT_BROKER
+#define MQTT_BROKER             "192.168.2.2"   // broker address (can be set with build flag -DMQTT_BROKER=\"...\")
+#endif
+#define MQTT_PORT               1883
+#define MQTT_TOPIC_TELEMETRY    "/telemetry"    // topics are prefixed with OTA_HOST_NAME
+#define MQTT_TOPIC_EVENT        "/event"
+#define MQTT_STACK_SIZE         4096
+#define MQTT_TASK_PRIORITY      1               // lowest priority, network I/O must never delay UI/heater
+#define MQTT_POLL_PERIOD        100             // how often queues are checked [ms]
+#define MQTT_RECONNECT_PERIOD   5000            // broker connection retry [ms]
+#define MQTT_KEEPALIVE          60              // [s]
+#define MQTT_SAMPLE_QUEUE       256             // samples kept while broker is not reachable (power of 2)
+#define MQTT_EVENT_QUEUE        32              // events kept while broker is not reachable (power of 2)
+#define MQTT_BATCH_SAMPLES      10              // samples published together
+#define MQTT_PACKET_LENGTH      1024            // max MQTT packet (one batch)
+
+typedef struct {
+  uint32_t  time;         // millis() when sample was taken
+  int16_t   temp;         // measured temperature [0.1 C]
+  uint16_t  setpoint;     // target temperature [C]
+  uint8_t   power;        // heater power [%]
+  uint8_t   state;        // controller state (heater_state)
+} mqttSample_t;
+
+typedef struct {
+  uint32_t  queued;       // samples waiting for publishing
+  uint32_t  published;    // samples published since boot
+  uint32_t  dropped;      // samples lost because of full queue
+  uint32_t  maxCycles;    // worst case MQTT_Sample()/MQTT_Event() cost [CPU cycles]
+  bool      connected;    // broker connection is up
+} mqttStats_t;
+
+/**
+ * Need to be called from main Setup/Init function to run the service (connection is started by MQTT_Activate())
+ */
+void MQTT_Init( void );
+
+/**
+ * Connect/disconnect broker, to be called when WiFi connection changes state
+ * Samples and events are queued also while disconnected and published on reconnect
+ * active   - WiFi is connected
+ */
+void MQTT_Activate( bool active );
+
+/**
+ * Queue telemetry sample, never blocks nor allocates (single producer - controller loop)
+ * sample   - sample to copy
+ *
+ * return   - false when queue is full (sample dropped)
+ */
+bool MQTT_Sample( const mqttSample_t * sample );
+
+/**
+ * Queue state change event, same rules as MQTT_Sample()
+ * name     - event name (string literal, only pointer is kept)
+ * value    - event value
+ */
+bool MQTT_Event( const char * name, int32_t value );
+
+/**
+ * Get publisher statistics
+ */
+void MQTT_getStats( mqttStats_t * stats );
+
+#endif  // _MQTT_H_
@@ -5,8 +5,10 @@
 #define OTA_HOST_NAME       "ElectricStove"
 #define OTA_STACK_SIZE      2048// number of words, at 1965 OTA OK, at 1964 OTA failing sometimes
 #define OTA_TASK_PRIORITY   1
+#define OTA_LINE_LENGTH     64     // max command line received over telnet (including NULL)
 
 typedef void (* otaActiveCb)( bool );
+typedef bool (* otaCommandCb)( const char * );
 
 /**
  * Need to be called from main Setup/Init function to run the service
@@ -19,6 +21,13 @@ void OTA_Init();
  */
 void OTA_setOtaActiveCallback( otaActiveCb func );
 
+/**
+ * Set a callback function that will be called (from OTA task) with every command line received over telnet
+ * Without callback received data are pushed to the UART
+ * func         -   callback function, returns false when command can't be accepted now
+ */
+void OTA_setCommandCallback( otaCommandCb func );
+
 /**
  * Turn on/off OTA service
  * active       -   whether to activate OTA
@@ -0,0 +1,71 @@
+#ifndef _NAMEINDEX_H_
+#define _NAMEINDEX_H_
+
+#include <stdint.h>
+
+#define NIDX_MIN_SIZE       32    // initial number of index entries (grows by doubling)
+#define NIDX_TRIGRAM_MIN    3     // shorter query is matched as name prefix only
+
+typedef const char * (* nidxNameCb)( uint32_t pos );
+typedef uint32_t (* nidxCountCb)( void );
+
+/**
+ * Name index keeps list positions sorted by name (case insensitive) together with trigram signature of every name
+ * Index is not thread safe, owner has to serialize all calls with list modifications
+ * getName  - function returning name for given list position
+ * getCount - function returning number of positions on the list
+ */
+void NIDX_Init( nidxNameCb getName, nidxCountCb getCount );
+
+/**
+ * Drop index content, it is rebuilt from the list on next NIDX_Find() call
+ * Use before bulk list changes (loading, import), all updates are ignored until rebuild
+ */
+void NIDX_Invalidate( void );
+
+/**
+ * Build index from the list now (after bulk changes) instead of on next NIDX_Find() call
+ */
+void NIDX_Rebuild( void );
+
+/**
+ * Position 'pos' was appended to the list
+ */
+void NIDX_Add( uint32_t pos );
+
+/**
+ * Positions were removed from the list, remaining ones slid over them
+ * removed  - bitmap of removed positions (in list numbering before removal)
+ * oldCount - number of positions on the list before removal
+ */
+void NIDX_Remove( const uint8_t removed[], uint32_t oldCount );
+
+/**
+ * Positions 'first' and 'second' exchanged their names
+ */
+void NIDX_Swap( uint32_t first, uint32_t second );
+
+/**
+ * Name moved from position 'from' to 'to', positions in between shifted by one
+ */
+void NIDX_Move( uint32_t from, uint32_t to );
+
+/**
+ * Whole list was rearranged
+ * order[]  - for every new position: old position of the name
+ * count    - number of positions on the list
+ */
+void NIDX_Reorder( const uint16_t order[], uint32_t count );
+
+/**
+ * Find names matching query (case insensitive)
+ * Names starting with query come first (sorted by name), then names containing it (query length >= NIDX_TRIGRAM_MIN)
+ * query    - text to look for, empty query matches every name
+ * results  - buffer for list positions of matching names
+ * max      - results buffer size
+ *
+ * return   - number of positions written to results
+ */
+uint32_t NIDX_Find( const char * query, uint16_t results[], uint32_t max );
+
+#endif  // _NAMEINDEX_H_
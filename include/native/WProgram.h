@@ -0,0 +1,12 @@
+#ifndef _WPROGRAM_H_
+#define _WPROGRAM_H_
+
+// Minimal Arduino API for libraries built by [env:native] (PID_v1 includes it when ARDUINO isn't defined)
+
+#include "hal.h"
+
+static inline unsigned long millis( void ) {
+  return HAL_millis();
+}
+
+#endif  // _WPROGRAM_H_
@@ -0,0 +1,66 @@
+#ifndef _PERSIST_H_
+#define _PERSIST_H_
+
+#include <stdint.h>
+
+#define PERSIST_STACK_SIZE      4096
+#define PERSIST_TASK_PRIORITY   1     // lowest priority, storage writes must never delay UI/heater
+#define PERSIST_QUEUE_LENGTH    8     // max number of requests waiting for the worker
+
+// jobs started by PERSIST_Signal() (task notification bit each, no queue slot)
+typedef enum {
+  PERSIST_SIGNAL_RECORDER = 0,        // run recorder block flush
+  PERSIST_SIGNAL_SDCARD,              // SD card insertion/removal probe
+  PERSIST_SIGNAL_COUNT
+} persistSignal;
+
+/**
+ * Job executed by persistence worker (flash/SD write)
+ * arg      - argument given to PERSIST_Submit()
+ *
+ * return   - true on success
+ */
+typedef bool (* persistJob)( void * arg );
+
+/**
+ * Completion callback, called from worker task context when the job is done
+ * success  - value returned by the job
+ */
+typedef void (* persistDoneCb)( bool success );
+
+/**
+ * Need to be called from main Setup/Init function to run the service (before other modules submit jobs)
+ */
+void PERSIST_Init( void );
+
+/**
+ * Queue job for the persistence worker
+ * Request identical to one still waiting in the queue (same job, arg and done) is merged with it
+ * job      - function doing the write
+ * arg      - argument passed to job
+ * done     - completion callback (can be NULL)
+ *
+ * return   - true if job is queued (or merged), false when queue is full
+ */
+bool PERSIST_Submit( persistJob job, void * arg, persistDoneCb done );
+
+/**
+ * Register job started by PERSIST_Signal() (call once from Setup/Init, after PERSIST_Init())
+ * signal   - PERSIST_SIGNAL_x
+ * job      - function doing the write, arg is NULL
+ */
+void PERSIST_setSignalJob( persistSignal signal, persistJob job );
+
+/**
+ * Start registered job, never blocks nor allocates (safe with mutex held and from the heater task)
+ * Signals given before the job runs are merged into one run, queued requests are not delayed by it
+ * signal   - PERSIST_SIGNAL_x
+ */
+void PERSIST_Signal( persistSignal signal );
+
+/**
+ * Check whether worker is idle (no queued or running job)
+ */
+bool PERSIST_isIdle( void );
+
+#endif  // _PERSIST_H_
@@ -0,0 +1,54 @@
+#ifndef _PLANT_H_
+#define _PLANT_H_
+
+#include <stdint.h>
+
+#define PLANT_DEAD_STEPS_MAX    1024        // dead time delay line length [steps]
+#define PLANT_TC_RESOLUTION     0.25f       // MAX6675 LSB [C]
+#define PLANT_TC_MAX            1023.75f    // MAX6675 range [C]
+
+// furnace model: heating element >> oven (thermal mass with losses) >> thermocouple
+typedef struct {
+  float     ambient;        // [C]
+  float     power;          // heating element power when relay is on [W]
+  float     capacity;       // thermal mass of the oven [J/K]
+  float     loss;           // heat losses to ambient [W/K]
+  float     deadTime;       // relay switch >> element heating/cooling starts [s]
+  float     elementLag;     // heating element time constant [s]
+  float     sensorLag;      // thermocouple time constant [s]
+} plantParams_t;
+
+/**
+ * Default parameters (small electric oven, ~2kW, ~300C max)
+ */
+void PLANT_getDefaults( plantParams_t * params );
+
+/**
+ * Set parameters and cool the oven down to ambient temperature
+ * params   - model parameters (copied)
+ * step     - integration step [s] (dead time resolution, PLANT_DEAD_STEPS_MAX limits dead time)
+ */
+void PLANT_Init( const plantParams_t * params, float step );
+
+/**
+ * Advance the model by one step
+ * heaterOn - relay state during the step
+ */
+void PLANT_Step( bool heaterOn );
+
+/**
+ * Oven temperature [C] (what the bake sees)
+ */
+float PLANT_getTemperature( void );
+
+/**
+ * Thermocouple temperature [C] (lagging, not quantised)
+ */
+float PLANT_getSensor( void );
+
+/**
+ * Thermocouple read as MAX6675 conversion word (12 bits of 0.25C from bit 3, open input flag clear)
+ */
+uint16_t PLANT_readMax6675( void );
+
+#endif  // _PLANT_H_
@@ -0,0 +1,65 @@
+#ifndef _RECIPE_H_
+#define _RECIPE_H_
+
+#include <stdint.h>
+#include "helper.h"
+
+#define RECIPE_SEGMENTS_MAX     BAKE_MAX_STEPS
+
+// one step of the bake's curve, values are validated and limited at compile time
+typedef struct {
+  int32_t   event;            // 0 - heating for given time, otherwise specialEvents code (EVENT_PREHEATING, ...)
+  uint16_t  temp;             // target temperature [C], 0 - heater off
+  uint32_t  time;             // expected duration [ms], 0 - until user reacts (preheating, pause, end)
+  uint32_t  deadline;         // longest allowed duration [ms] (safety limit for segments waiting for user)
+  uint32_t  remainingAfter;   // expected duration of all following segments [ms]
+} recipeSegment_t;
+
+typedef struct {
+  char              name[ BAKE_NAME_LENGTH ];
+  uint32_t          count;          // segments in the timeline
+  uint32_t          current;        // running segment (count when finished)
+  uint32_t          totalTime;      // expected duration of the whole bake [ms], waiting for user not included
+  recipeSegment_t   segment[ RECIPE_SEGMENTS_MAX ];
+} recipe_t;
+
+/**
+ * Compile bake's steps into a timeline (steps are copied, later list changes don't affect it)
+ * Timeline ends with first step with time 0 or with EVENT_END, unknown event codes make the bake invalid
+ * name     - bake name
+ * steps    - bake's curve (e.g. from CONF_copyBake())
+ * count    - number of steps
+ * recipe   - output, positioned at the first segment
+ *
+ * return   - false when bake is empty or invalid
+ */
+bool RECIPE_Compile( const char * name, const bakeStep_t steps[], uint32_t count, recipe_t * recipe );
+
+/**
+ * Go back to the first segment (run the same bake again)
+ */
+void RECIPE_Rewind( recipe_t * recipe );
+
+/**
+ * Get running segment
+ *
+ * return   - NULL when timeline is finished
+ */
+const recipeSegment_t * RECIPE_Current( const recipe_t * recipe );
+
+/**
+ * Advance to the next segment
+ *
+ * return   - new running segment, NULL when timeline is finished
+ */
+const recipeSegment_t * RECIPE_Next( recipe_t * recipe );
+
+/**
+ * Expected remaining time of the whole bake
+ * segmentRemaining - remaining time of the running segment [ms] (from heater)
+ *
+ * return   - [ms], 0 when timeline is finished
+ */
+uint32_t RECIPE_getRemaining( const recipe_t * recipe, uint32_t segmentRemaining );
+
+#endif  // _RECIPE_H_
@@ -0,0 +1,75 @@
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+
+#include <stdint.h>
+
+#define REC_FILE_PATH         "/bakes.rec"  // all runs are appended to this file on SD card
+#define REC_MAGIC             0x43455242    // "BREC", starts every block in the file
+#define REC_RING_SAMPLES      1024          // RAM ring buffer size [samples] (power of 2)
+#define REC_NAME_LENGTH       20            // bake name kept in block header (truncated)
+#define REC_BLOCK_SIZE        4096          // file is written in such blocks (header + samples), SD_BULK_SIZE [bytes]
+
+// events recorded with a sample (bits, more of them can happen between two samples)
+#define REC_EVENT_RUN_START   0x0001        // first sample of the run
+#define REC_EVENT_RUN_END     0x0002        // last sample of the run
+#define REC_EVENT_START       0x0004        // heater started
+#define REC_EVENT_PAUSE       0x0008
+#define REC_EVENT_RESUME      0x0010
+#define REC_EVENT_STOP        0x0020        // heater stopped by user
+#define REC_EVENT_DONE        0x0040        // step time is up
+#define REC_EVENT_STEP        0x0080        // next step of bake curve started
+#define REC_EVENT_SPECIAL     0x0100        // special event step (heater is off)
+#define REC_EVENT_TEMP_ERROR  0x0200        // thermocouple read failure
+
+typedef struct __attribute__((packed)) recSample {
+  uint16_t  dt;         // time from previous sample [ms] (saturated)
+  int16_t   temp;       // measured temperature [0.1 C]
+  uint16_t  setpoint;   // target temperature [C]
+  uint8_t   power;      // heater power [%]
+  uint8_t   state;      // heater state
+  uint16_t  events;     // REC_EVENT_x
+} recSample_t;
+
+typedef struct __attribute__((packed)) recBlockHeader {
+  uint32_t  magic;                      // REC_MAGIC
+  uint32_t  runStart;                   // millis() when the run started (identifies run within one power up)
+  uint16_t  block;                      // block number within the run (count from 0)
+  uint16_t  count;                      // number of samples following the header
+  char      name[ REC_NAME_LENGTH ];    // bake name (NULL padded)
+} recBlockHeader_t;
+
+#define REC_BLOCK_SAMPLES     ( ( REC_BLOCK_SIZE - sizeof( recBlockHeader_t ) ) / sizeof( recSample_t ) )
+
+/**
+ * Need to be called from main Setup/Init function, after PERSIST_Init() (blocks are written by persistence worker)
+ */
+void REC_Init( void );
+
+/**
+ * Begin recording of new run, samples are taken from the next REC_Sample() call
+ * name     - bake name stored with the run
+ */
+void REC_Start( const char * name );
+
+/**
+ * Finish the run, remaining samples are written to SD card
+ */
+void REC_Stop( void );
+
+/**
+ * Mark event, it is stored with the next sample (can be called from any task)
+ * events   - REC_EVENT_x bits
+ */
+void REC_Event( uint16_t events );
+
+/**
+ * Store one sample in RAM ring buffer (no allocation, no blocking), called by heater task only
+ * Full blocks are written to SD card by persistence worker
+ * temp     - measured temperature [C]
+ * setpoint - target temperature [C]
+ * power    - heater power [%]
+ * state    - heater state
+ */
+void REC_Sample( float temp, uint16_t setpoint, uint8_t power, uint8_t state );
+
+#endif  // _RECORDER_H_
@@ -1,19 +1,49 @@
 #ifndef _SDCARD_H_
 #define _SDCARD_H_
 
-#include "SD.h"
+#include <stdint.h>
+#include "hal.h"
 
 #define SD_CS 14
+#define SD_FREQUENCIES        { 40000000, 26000000, 20000000, 16000000, 10000000, 4000000 } // tried from the highest one [Hz]
+#define SD_PROBE_FREQUENCY    4000000   // used to detect card presence before negotiation [Hz]
+#define SD_SECTOR_SIZE        512
+#define SD_BULK_SIZE          ( 8 * SD_SECTOR_SIZE )  // data is transferred in such sector aligned chunks [bytes]
+#define SD_ABSENT_PROBE_EVERY 5         // missing card is looked for on every n-th SDCARD_Handle() call
+#define SD_HOST_ROOT          "sdcard"  // POSIX: directory standing for the card (relative to working directory, inserted when it exists)
+
+/**
+ * Need to be called from main Setup/Init function to run the service
+ * Card (if inserted) is mounted and stays mounted until removed
+ * spi      - pointer to SPI instance which will be used for communication (shared bus)
+ */
+void SDCARD_Setup( halSpi_t * spi );
+
+/**
+ * Need to be called periodically (e.g. every second) to detect card insertion and removal
+ */
+void SDCARD_Handle( void );
+
+/**
+ * Check whether card is mounted, tries to mount it immediately if it's not
+ *
+ * return   - true if card is ready for use
+ */
+bool SDCARD_isAvailable( void );
+
+/**
+ * Get SPI clock negotiated with currently mounted card
+ *
+ * return   - frequency [Hz], 0 when no card is mounted
+ */
+uint32_t SDCARD_getFrequency( void );
 
-void SDCARD_Setup( SPIClass * spi );
-bool SDCARD_Reinit();
-void SDCARD_Eject();
 void SDCARD_list();
 
 /**
  * Read file <path> and return its content
  * path   - path to file
- * 
+ *
  * return - file content as integer (1B values only) or -1 on error
  */
 int SDCARD_readFile( const char * path );
@@ -32,11 +62,23 @@ void SDCARD_writeFile( const char * path, int value );
  */
 void SDCARD_writeFile( const char * path, const char * msg );
 
+/**
+ * Write binary data to file in sector aligned chunks
+ * path     - path to file
+ * data     - data to be written
+ * len      - data length [bytes]
+ * append   - add data at the end of file instead of overwriting it
+ *
+ * return   - written bytes
+ */
+uint32_t SDCARD_writeBulk( const char * path, const uint8_t * data, uint32_t len, bool append );
+
 /**
  * Read file content to dynamically allocated buffer and return pointer to that buffer with it's size
+ * File is read in sector aligned chunks, buffer is NULL terminated (one byte more than returned size)
  * path     - path to a file
  * buf      - pointer to pointer to buffer
- * 
+ *
  * return   - read bytes from file
  */
 uint32_t SDCARD_getFileContent( const char * path, uint8_t ** buf );
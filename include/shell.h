@@ -0,0 +1,45 @@
+#ifndef _SHELL_H_
+#define _SHELL_H_
+
+#include <stdint.h>
+
+#define SHELL_LINE_LENGTH     64    // max command line length including NULL
+#define SHELL_ARGS_MAX        4     // command name + arguments
+#define SHELL_REPLY_LENGTH    128   // max length of one SHELL_Printf() output
+
+typedef void (* shellHandler)( int argc, char * argv[] );
+
+typedef struct {
+  const char *  name;
+  const char *  args;       // argument description shown by help (can be NULL)
+  const char *  help;
+  shellHandler  handler;    // argv[0] is command name
+} shellCommand_t;
+
+/**
+ * Set command table (kept by reference), 'help' command is built in
+ * commands - table of commands
+ * count    - number of commands in table
+ */
+void SHELL_Init( const shellCommand_t commands[], uint32_t count );
+
+/**
+ * Pass received command line (can be called from any task), it is executed by SHELL_Handle()
+ * line     - command line without new line
+ *
+ * return   - false when previous line was not executed yet (line is ignored)
+ */
+bool SHELL_Input( const char * line );
+
+/**
+ * Execute pending command line, need to be called from main loop (command handlers run in its context)
+ */
+void SHELL_Handle( void );
+
+/**
+ * Send reply to the shell client (telnet)
+ * format   - printf like format string
+ */
+void SHELL_Printf( const char * format, ... ) __attribute__(( format( printf, 1, 2 ) ));
+
+#endif  // _SHELL_H_
@@ -0,0 +1,71 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+#include "plant.h"
+#include "recipe.h"
+
+#define SIM_STEP                100         // plant step and controller poll period [ms] (= PID_INTERVAL_COMPUTE)
+#define SIM_BAND                2.0f        // default settling band, +-[C]
+#define SIM_USER_DELAY          60          // default time the user needs to press CONTINUE (preheating, pause) [s]
+#define SIM_STEADY_WINDOW       600         // steady state error is averaged over the end of the segment [s]
+#define SIM_NEVER               UINT32_MAX  // segment never settled
+#define SIM_CHECK_TOLERANCE     0.01f       // rounding allowed by SIM_Check() [C]
+
+typedef struct {
+  plantParams_t   plant;
+  float           band;         // settling band +-[C]
+  uint32_t        userDelay;    // user's reaction time [ms]
+} simConfig_t;
+
+// closed loop behaviour during one segment, temperatures are the oven's (not thermocouple's)
+typedef struct {
+  int32_t         event;        // recipeSegment_t.event
+  uint16_t        temp;         // setpoint [C], 0 - heater off (no temperature metrics)
+  uint32_t        duration;     // [ms]
+  bool            rising;       // setpoint is not lower than the previous one (ambient after heater off)
+  float           overshoot;    // furthest beyond setpoint since segment start [C], above it when rising, otherwise below it
+  uint32_t        settling;     // segment start >> temperature stays within band [ms], SIM_NEVER - not settled
+  float           steadyError;  // mean (temperature - setpoint) over last SIM_STEADY_WINDOW [C]
+  uint32_t        relayCycles;  // relay switched on
+} simSegment_t;
+
+typedef struct {
+  uint32_t        count;
+  uint32_t        duration;     // simulated time of the whole run [ms]
+  uint32_t        cpuTime;      // host time spent on the run [ms]
+  bool            completed;    // false - preheating/pause deadline hit (controller stops the bake)
+  float           maxTemp;      // [C]
+  uint32_t        relayCycles;
+  simSegment_t    segment[ RECIPE_SEGMENTS_MAX ];
+} simResult_t;
+
+/**
+ * Switch HAL to simulated clock and start heater with the plant model connected (call before any other module)
+ * Controller (CTRL_Init()) is started by the caller when bakes are simulated, it takes the heater callback
+ * config   - plant and simulated user, kept for all runs
+ */
+void SIM_Init( const simConfig_t * config );
+
+/**
+ * Pick up the bake from the list and run it by the controller, user presses CONTINUE after config->userDelay and STOP at the end
+ * Oven starts at ambient temperature, PID keeps its state from the previous run (like the device does)
+ * idx      - bake on the list (controller must be idle)
+ * recipe   - the same bake compiled by the caller, segments are only looked up for the metrics
+ * result   - output
+ */
+void SIM_Run( uint32_t idx, const recipe_t * recipe, simResult_t * result );
+
+/**
+ * Print table with metrics of every segment
+ */
+void SIM_Print( const recipe_t * recipe, const simResult_t * result );
+
+/**
+ * Check metrics of last run against each other, print segments where they contradict
+ *
+ * return   - false when some metric is wrong
+ */
+bool SIM_Check( const simResult_t * result );
+
+#endif  // _SIM_H_
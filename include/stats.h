@@ -0,0 +1,59 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+#include <Arduino.h>
+
+#define STATS_STACK_SIZE        4096
+#define STATS_TASK_PRIORITY     1       // lowest priority, only observes other tasks
+#define STATS_PERIOD            5000    // how often statistics are collected [ms]
+#define STATS_SERIAL_PERIOD     60000   // how often report is printed on serial [ms], 0 - never
+#define STATS_TASKS_MAX         20      // tasks tracked
+#define STATS_STACK_WARNING     384     // warn when task has less unused stack [bytes]
+#define STATS_REPORT_LENGTH     1536    // text report buffer size
+
+typedef struct {
+  char          name[ configMAX_TASK_NAME_LEN ];
+  uint32_t      priority;
+  uint32_t      stackFree;      // stack high-water mark (never used so far) [bytes]
+  int32_t       cpu;            // share of one core during last period [0.1 %], -1 when not available
+                                // (kernel run time counters when enabled, else sampled every tick - 1 ms resolution)
+} statsTask_t;
+
+typedef struct {
+  uint32_t      time;           // millis() when collected
+  uint32_t      taskCount;      // tasks in the list
+  uint32_t      taskTotal;      // all tasks in the system
+  statsTask_t   task[ STATS_TASKS_MAX ];
+  uint32_t      heapFree;
+  uint32_t      heapMinFree;    // lowest free heap since boot
+  uint32_t      heapMaxBlock;   // largest free block
+  uint32_t      lvglUsed;       // LVGL own heap (0 when LVGL uses system heap)
+  uint32_t      lvglTotal;
+} stats_t;
+
+/**
+ * Need to be called from main Setup/Init function to run the service (after other tasks are created)
+ */
+void STATS_Init( void );
+
+/**
+ * Report LVGL heap usage (LVGL is not thread safe, values are taken by the GUI owner)
+ */
+void STATS_setLvglMemory( uint32_t used, uint32_t total );
+
+/**
+ * Get copy of last collected statistics
+ */
+void STATS_get( stats_t * stats );
+
+/**
+ * Format last collected statistics as multi-line text report
+ * buf      - output buffer (STATS_REPORT_LENGTH is enough)
+ * size     - buffer size
+ *
+ * return   - report length
+ */
+uint32_t STATS_format( char * buf, uint32_t size );
+
+#endif  // _STATS_H_
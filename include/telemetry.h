@@ -0,0 +1,49 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+
+#define TELEM_PORT              80    // HTTP server port (status page and WebSocket)
+#define TELEM_STACK_SIZE        4096
+#define TELEM_TASK_PRIORITY     1     // lowest priority, network I/O must never delay UI/heater
+#define TELEM_POLL_PERIOD       20    // how often connections are serviced [ms]
+#define TELEM_PERIOD_DEFAULT    500   // telemetry push period [ms]
+#define TELEM_PERIOD_MIN        100   // status is updated by controller every 100ms, no point to push faster
+#define TELEM_CLIENTS_MAX       2     // simultaneous connections (page requests and WebSockets)
+#define TELEM_REQUEST_LENGTH    512   // max HTTP request header length
+#define TELEM_FRAME_LENGTH      96    // max WebSocket frame (one telemetry update)
+
+typedef struct {
+  int16_t   temp;         // measured temperature [0.1 C]
+  uint16_t  setpoint;     // target temperature [C]
+  uint8_t   power;        // heater power [%]
+  uint8_t   state;        // controller state (heater_state)
+  uint32_t  remaining;    // remaining time [s]
+} telemStatus_t;
+
+/**
+ * Need to be called from main Setup/Init function to run the service (server is started by TELEM_Activate())
+ */
+void TELEM_Init( void );
+
+/**
+ * Start/stop HTTP server, to be called when WiFi connection changes state
+ * active   - WiFi is connected
+ */
+void TELEM_Activate( bool active );
+
+/**
+ * Publish current status snapshot, never blocks (single writer - controller loop)
+ * WebSocket clients get only fields changed since their previous update
+ * status   - current status
+ */
+void TELEM_Update( const telemStatus_t * status );
+
+/**
+ * Set push period for WebSocket clients
+ * period   - [ms], at least TELEM_PERIOD_MIN
+ */
+void TELEM_setPeriod( uint32_t period );
+uint32_t TELEM_getPeriod( void );
+
+#endif  // _TELEMETRY_H_
@@ -0,0 +1,76 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+// #define TRACE_ENABLE                  // uncomment (or build with -DTRACE_ENABLE) to compile tracepoints in
+
+#define TRACE_FILE_PATH       "/trace.bin"  // dump file on SD card (see tools/tracetool.py)
+#define TRACE_MAGIC           0x31435254    // "TRC1", starts the dump
+#define TRACE_RECORDS         1024          // trace buffer size [records] (power of 2), oldest are overwritten
+
+// tracepoints (keep in sync with tools/tracetool.py)
+typedef enum {
+  TRACE_HEATER_CYCLE = 0,   // instant: heater task loop iteration starts
+  TRACE_SENSOR_READ,        // span: MAX6675 SPI conversion read, arg: raw value
+  TRACE_PID_COMPUTE,        // span: PID computation and relay decision
+  TRACE_RELAY,              // instant: relay edge, arg: 1 - on, 0 - off
+  TRACE_GUI_FLUSH,          // span: display flush, arg: pixels
+  TRACE_HEATER_LOCK,        // span: waiting for heater mutex
+  TRACE_GUI_LOCK,           // span: waiting for GUI mutex
+  TRACE_CONF_LOCK,          // span: waiting for config mutex
+  TRACE_ID_COUNT
+} traceId;
+
+typedef enum {
+  TRACE_TYPE_INSTANT = 0,
+  TRACE_TYPE_BEGIN,
+  TRACE_TYPE_END,
+} traceType;
+
+typedef struct __attribute__((packed)) {
+  uint32_t  time;         // HAL_micros() time [us] (same for both cores)
+  uint32_t  cycles;       // CPU cycle counter of the core
+  uint16_t  id;           // traceId
+  uint8_t   type;         // traceType
+  uint8_t   core;
+  uint32_t  arg;
+} traceRecord_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t  magic;        // TRACE_MAGIC
+  uint16_t  cpuMhz;       // cycles to time conversion
+  uint16_t  recordSize;   // sizeof( traceRecord_t )
+  uint32_t  count;        // records following the header (oldest first)
+  uint32_t  lost;         // records overwritten before the dump
+} traceHeader_t;
+
+#ifdef TRACE_ENABLE
+  #define TRACE_POINT( id, arg )    TRACE_Record( (id), TRACE_TYPE_INSTANT, (arg) )
+  #define TRACE_BEGIN( id, arg )    TRACE_Record( (id), TRACE_TYPE_BEGIN, (arg) )
+  #define TRACE_END( id, arg )      TRACE_Record( (id), TRACE_TYPE_END, (arg) )
+#else
+  #define TRACE_POINT( id, arg )    do {} while( 0 )
+  #define TRACE_BEGIN( id, arg )    do {} while( 0 )
+  #define TRACE_END( id, arg )      do {} while( 0 )
+#endif
+
+/**
+ * Store trace record, lock-free (any task, any core), no-op while tracing is stopped
+ * Use TRACE_POINT/TRACE_BEGIN/TRACE_END macros, they are compiled out without TRACE_ENABLE
+ */
+void TRACE_Record( uint16_t id, uint8_t type, uint32_t arg );
+
+/**
+ * Clear trace buffer and start tracing
+ */
+void TRACE_Start( void );
+
+/**
+ * Stop tracing and write the buffer to SD card (TRACE_FILE_PATH) by persistence worker
+ *
+ * return   - false when tracing is not compiled in or the job can't be queued
+ */
+bool TRACE_Dump( void );
+
+#endif  // _TRACE_H_
@@ -1,6 +1,7 @@
-#include <Arduino.h>
 #include <PID.h>
 #include <PID_v1.h>
+#include "trace.h"
+#include "hal.h"
 
 #define TOTAL_WINDOW_SIZE   ( PID_WINDOW_SIZE + PID_DEADTIME_SIZE )
 #define START_NEW_PROCESS   ( -1.0f )
@@ -16,16 +17,23 @@ static double Kp=70, Ki=0.1, Kd=1000;   //CDHW methode from [https://newton.ex.a
 
 PID myPID( &input, &output, &setPoint, Kp, Ki, Kd, DIRECT );
 
+static void relaySet( bool active ) {
+  if( active != isHeaterActive ) {
+    TRACE_POINT( TRACE_RELAY, active );   // edges only
+  }
+  HAL_pinWrite( PID_PIN_RELAY, active );
+  isHeaterActive = active;
+}
+
 void PID_Init() {
-  pinMode( PID_PIN_RELAY, OUTPUT );
-  digitalWrite( PID_PIN_RELAY, LOW );
+  HAL_pinOutput( PID_PIN_RELAY, false );
   isOn = false;
   isHeaterActive = false;
-  windowStartTime = millis();
+  windowStartTime = HAL_millis();
   setPoint = 20;
   output = 0.0;
   myPID.SetOutputLimits( 0, PID_WINDOW_SIZE );
-  myPID.SetSampleTime( PID_INTERVAL_COMPUTE / portTICK_PERIOD_MS );
+  myPID.SetSampleTime( PID_INTERVAL_COMPUTE );
   myPID.SetMode( AUTOMATIC );
 }
 
@@ -33,13 +41,12 @@ void PID_Compute() {
   static double sumOutput = 0.0f;
 
   if( !isOn ) {
-    digitalWrite( PID_PIN_RELAY, LOW );
-    isHeaterActive = false;
+    relaySet( false );
     return;
   }
 
   myPID.Compute();
-  currentTime = millis();
+  currentTime = HAL_millis();
 
   if( START_NEW_PROCESS == avgOutput ) {
     avgOutput = output;   // use first value at the beginning of the first cycle (total windows time)
@@ -48,12 +55,10 @@ void PID_Compute() {
   sumOutput += output;
 
   if( avgOutput > currentTime - windowStartTime ) {
-    digitalWrite( PID_PIN_RELAY, HIGH );
-    isHeaterActive = true;
+    relaySet( true );
   }
   else {
-    digitalWrite( PID_PIN_RELAY, LOW );
-    isHeaterActive = false;
+    relaySet( false );
   }
 
   if( currentTime - windowStartTime > TOTAL_WINDOW_SIZE )
@@ -72,15 +77,14 @@ void PID_SetPoint( uint16_t targetPoint ) {
 }
 
 void PID_On() {
-  windowStartTime = millis();
+  windowStartTime = HAL_millis();
   avgOutput = START_NEW_PROCESS;
   lastAvgOutput = 0;
   isOn = true;
 }
 
 void PID_Off() {
-  digitalWrite( PID_PIN_RELAY, LOW );
-  isHeaterActive = false;
+  relaySet( false );
   lastAvgOutput = 0;
   isOn = false;
 }
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "hal.h"
+
+#ifdef BENCH_ENABLE
+
+#include "PID.h"
+#include "heater.h"
+#include "buzzer.h"
+#include "helper.h"
+#include "config.h"
+#ifdef ARDUINO
+#include "gui.h"
+#endif
+
+typedef struct {
+  uint32_t    count;
+  uint32_t    min;        // [cycles]
+  uint32_t    max;
+  uint64_t    sum;
+} benchStats_t;
+
+static benchOutputCb      output;
+
+static void statsClear( benchStats_t * stats ) {
+  stats->count = 0;
+  stats->min = UINT32_MAX;
+  stats->max = 0;
+  stats->sum = 0;
+}
+
+static void statsAdd( benchStats_t * stats, uint32_t cycles ) {
+  stats->count++;
+  stats->sum += cycles;
+  if( cycles < stats->min ) {
+    stats->min = cycles;
+  }
+  if( cycles > stats->max ) {
+    stats->max = cycles;
+  }
+}
+
+static void report( const char * name, const benchStats_t * stats ) {
+  char line[ BENCH_LINE_LENGTH ];
+
+  if( 0 == stats->count ) {
+    snprintf( line, sizeof( line ), "{\"bench\":\"%s\",\"iter\":0}\n", name );
+  } else {
+    snprintf( line, sizeof( line ), "{\"bench\":\"%s\",\"iter\":%u,\"min\":%u,\"avg\":%u,\"max\":%u,\"unit\":\"cycles\",\"mhz\":%u}\n",
+              name, stats->count, stats->min, (uint32_t)( stats->sum / stats->count ), stats->max, HAL_cpuMhz() );
+  }
+  output( line );
+}
+
+// cost of timing itself, included in every result
+static void benchOverhead( void ) {
+  benchStats_t stats;
+
+  statsClear( &stats );
+  for( uint32_t x=0; x<BENCH_ITERATIONS; x++ ) {
+    uint32_t start = HAL_cycles();
+    statsAdd( &stats, HAL_cycles() - start );
+  }
+  report( "overhead", &stats );
+}
+
+static void benchPid( void ) {
+  benchStats_t stats;
+
+  statsClear( &stats );
+  PID_SetPoint( 0 );    // output stays 0, relay is never switched on
+  PID_updateTemp( (double)HEATER_getCurrentTemperature() );
+  PID_On();
+  for( uint32_t x=0; x<BENCH_PID_ITERATIONS; x++ ) {
+    HAL_delay( PID_INTERVAL_COMPUTE );    // otherwise PID returns without computing
+
+    uint32_t start = HAL_cycles();
+    PID_Compute();
+    statsAdd( &stats, HAL_cycles() - start );
+  }
+  PID_Off();
+  report( "PID_Compute", &stats );
+}
+
+// called back to back, PID inside computes only when its sample time passed
+static void benchHeater( const char * name ) {
+  benchStats_t stats;
+
+  statsClear( &stats );
+  for( uint32_t x=0; x<BENCH_ITERATIONS; x++ ) {
+    uint32_t start = HAL_cycles();
+    HEATER_Handle();
+    statsAdd( &stats, HAL_cycles() - start );
+  }
+  report( name, &stats );
+}
+
+static void benchBuzzer( void ) {
+  benchStats_t stats;
+  unsigned long now = HAL_millis();
+  unsigned long base = ( BENCH_ITERATIONS < now ) ? now - BENCH_ITERATIONS : 0;   // times already passed, 'buzzings' are not shifted
+
+  statsClear( &stats );
+  for( uint32_t x=0; x<BENCH_ITERATIONS; x++ ) {
+    uint32_t start = HAL_cycles();
+    BUZZ_Handle( base + x + 1 );    // the same time twice returns immediately
+    statsAdd( &stats, HAL_cycles() - start );
+  }
+  report( "BUZZ_Handle", &stats );
+}
+
+static void benchConf( void ) {
+  benchStats_t storeStats, loadStats, removeStats;
+  uint16_t * list = NULL;
+  uint32_t start;
+
+  statsClear( &storeStats );
+  statsClear( &loadStats );
+  statsClear( &removeStats );
+
+  for( uint32_t x=0; x<BENCH_CONF_ITERATIONS; x++ ) {
+    start = HAL_cycles();
+    if( !CONF_benchStore() ) {
+      break;
+    }
+    statsAdd( &storeStats, HAL_cycles() - start );
+  }
+  report( "CONF_store", &storeStats );
+
+  if( 0 == storeStats.count || !CONF_benchBegin() ) {
+    report( "CONF_load", &loadStats );
+    report( "CONF_removeBakes", &removeStats );
+    return;
+  }
+
+  for( uint32_t x=0; x<BENCH_CONF_ITERATIONS; x++ ) {
+    start = HAL_cycles();
+    if( !CONF_benchLoad() ) {
+      break;
+    }
+    statsAdd( &loadStats, HAL_cycles() - start );
+  }
+  report( "CONF_load", &loadStats );
+
+  // every other bake, from the list loaded again each time
+  for( uint32_t x=0; x<BENCH_CONF_ITERATIONS && 0 < loadStats.count; x++ ) {
+    uint32_t count;
+
+    if( !CONF_benchLoad() || 2 > ( count = CONF_getBakeCount() / 2 ) ) {
+      break;
+    }
+    if( NULL == list ) {
+      list = (uint16_t *)malloc( count * sizeof( uint16_t ) );
+      if( NULL == list ) {
+        break;
+      }
+    }
+    for( uint32_t y=0; y<count; y++ ) {
+      list[y] = (uint16_t)( y * 2 );
+    }
+
+    start = HAL_cycles();
+    CONF_removeBakes( list, count );
+    statsAdd( &removeStats, HAL_cycles() - start );
+  }
+  free( list );
+  CONF_benchEnd();
+  report( "CONF_removeBakes", &removeStats );
+}
+
+#ifdef ARDUINO
+static void benchGui( void ) {
+  benchStats_t stats;
+  uint32_t start;
+
+  statsClear( &stats );
+  for( uint32_t x=0; x<BENCH_ITERATIONS; x++ ) {
+    start = HAL_cycles();
+    GUI_SetCurrentTemp( (uint16_t)( x % MAX_ALLOWED_TEMP ) );   // text changes every call
+    statsAdd( &stats, HAL_cycles() - start );
+  }
+  report( "GUI_SetCurrentTemp", &stats );
+
+  statsClear( &stats );
+  for( uint32_t x=0; x<BENCH_ITERATIONS; x++ ) {
+    start = HAL_cycles();
+    GUI_SetTargetTemp( (uint16_t)( x % MAX_ALLOWED_TEMP ) );
+    statsAdd( &stats, HAL_cycles() - start );
+  }
+  report( "GUI_SetTargetTemp", &stats );
+
+  statsClear( &stats );
+  for( uint32_t x=0; x<BENCH_ITERATIONS; x++ ) {
+    start = HAL_cycles();
+    GUI_SetCurrentTime( MINUTE_TO_MILLIS( x ) );
+    statsAdd( &stats, HAL_cycles() - start );
+  }
+  report( "GUI_SetCurrentTime", &stats );
+
+  statsClear( &stats );
+  for( uint32_t x=0; x<BENCH_ITERATIONS; x++ ) {
+    start = HAL_cycles();
+    GUI_SetTargetTime( MINUTE_TO_MILLIS( x ) );
+    statsAdd( &stats, HAL_cycles() - start );
+  }
+  report( "GUI_SetTargetTime", &stats );
+}
+#endif
+
+bool BENCH_Run( benchOutputCb outputCb ) {
+  if( NULL == outputCb || HEATER_isHeating() ) {
+    return false;
+  }
+  output = outputCb;
+
+  benchOverhead();
+  benchPid();
+  benchHeater( "HEATER_Handle(idle)" );
+
+  HEATER_setTempTime( 0, HOUR_TO_MILLIS( 1 ) );   // setpoint 0C, relay stays off
+  HEATER_start();
+  benchHeater( "HEATER_Handle(heating)" );
+  HEATER_stop();
+
+  benchBuzzer();
+  benchConf();
+#ifdef ARDUINO
+  benchGui();
+#endif
+
+  return true;
+}
+
+#else
+
+bool BENCH_Run( benchOutputCb outputCb ) {
+  return false;
+}
+
+#endif  // BENCH_ENABLE
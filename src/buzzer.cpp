@@ -1,5 +1,9 @@
+#include <assert.h>
+#include <limits.h>
 #include "buzzer.h"
-#include <Arduino.h>
+#include "hal.h"
+#include "logger.h"
+#include "lockprof.h"
 
 typedef struct buzzer
 {
@@ -16,32 +20,29 @@ static unsigned int       idx;
 static unsigned long      globalTime;
 static bool               initialized = false;
 static bool               muted = false;
-static SemaphoreHandle_t  xSemaphore = NULL;
-static StaticSemaphore_t  xMutexBuffer;
+static profLock_t         xLock;                      // mutex with contention statistics
 static uint32_t           failSemaphoreCounter = 0;   // debug purpose only
-static TaskHandle_t       taskHandle = NULL;
-static StaticTask_t       taskTCB;
-static StackType_t        taskStack[ BUZZER_STACK_SIZE ];
+static halTask_t          task;
+static halStack_t         taskStack[ BUZZER_STACK_SIZE ];
 
 static unsigned int getNextHash();
 static int getFreeSlotIndex();
 static void vTaskBuzzer( void * pvParameters );
-static void buzzerHandle( unsigned long currentTime );
 
 static unsigned int getNextHash() {
   unsigned int tmpHash = 0;
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 100/portTICK_PERIOD_MS ) ) ) {
+  if( LOCK_Take( &xLock, 100 ) ) {
     for( int x=0; x<BUZZ_BUZZERS_MAX; x++ ) {
       if( buzzerList[ x ].hash > tmpHash ) {
         tmpHash = buzzerList[ x ].hash;
       }
     }
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "BUZZ_hash: couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "BUZZ_hash: couldn't take semaphore %u times", failSemaphoreCounter );
   }
 
   return ++tmpHash;
@@ -50,7 +51,7 @@ static unsigned int getNextHash() {
 static int getFreeSlotIndex() {
   int freeSlotIdx = -1;
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 100/portTICK_PERIOD_MS ) ) ) {
+  if( LOCK_Take( &xLock, 100 ) ) {
     for( int x=0; x<BUZZ_BUZZERS_MAX; x++ ) {
       if( (0 == buzzerList[ x ].hash) || (false == buzzerList[ x ].active) ) {
         freeSlotIdx = x;
@@ -58,10 +59,10 @@ static int getFreeSlotIndex() {
       }
     }
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "BUZZ_slot: couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "BUZZ_slot: couldn't take semaphore %u times", failSemaphoreCounter );
   }
 
   return freeSlotIdx;
@@ -69,13 +70,13 @@ static int getFreeSlotIndex() {
 
 static void vTaskBuzzer( void * pvParameters ) {
   while( 1 ) {
-    buzzerHandle( millis() );
-    vTaskDelay( 10 / portTICK_PERIOD_MS );
+    BUZZ_Handle( HAL_millis() );
+    HAL_delay( 10 );
   }
 }
 
-static void buzzerHandle( unsigned long currentTime ) {
-  uint8_t activateBuzzing = LOW;
+void BUZZ_Handle( unsigned long currentTime ) {
+  bool activateBuzzing = false;
 
   if( false == initialized ) {
     return;
@@ -86,7 +87,7 @@ static void buzzerHandle( unsigned long currentTime ) {
     return;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 100/portTICK_PERIOD_MS ) ) ) {
+  if( LOCK_Take( &xLock, 100 ) ) {
     globalTime = currentTime;
 
     for( int x=0; x<BUZZ_BUZZERS_MAX; x++ ) {
@@ -95,7 +96,7 @@ static void buzzerHandle( unsigned long currentTime ) {
         && ( globalTime < ( buzzerList[ x ].start + buzzerList[ x ].period ) )
         && ( true == buzzerList[ x ].active )
       ) {
-        activateBuzzing = HIGH;
+        activateBuzzing = true;
       }
 
       // check against 'buzzing' deactivation
@@ -108,16 +109,16 @@ static void buzzerHandle( unsigned long currentTime ) {
         }
       }
     }
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "BUZZ_Handle: couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "BUZZ_Handle: couldn't take semaphore %u times", failSemaphoreCounter );
   }
 
   if( muted ) {
-    digitalWrite( BUZZ_OUTPUT_PIN, LOW );
+    HAL_pinWrite( BUZZ_OUTPUT_PIN, false );
   } else {
-    digitalWrite( BUZZ_OUTPUT_PIN, activateBuzzing );
+    HAL_pinWrite( BUZZ_OUTPUT_PIN, activateBuzzing );
   }
 }
 
@@ -126,14 +127,12 @@ void BUZZ_Init( void ) {
     return;
   }
 
-  pinMode( BUZZ_OUTPUT_PIN, OUTPUT );
-  digitalWrite( BUZZ_OUTPUT_PIN, LOW );
+  HAL_pinOutput( BUZZ_OUTPUT_PIN, false );
 
-  xSemaphore = xSemaphoreCreateMutexStatic( &xMutexBuffer );
-  assert( xSemaphore );
+  LOCK_Init( &xLock, "buzzer" );
 
-  taskHandle = xTaskCreateStaticPinnedToCore( vTaskBuzzer, "Buzzer", BUZZER_STACK_SIZE, NULL, BUZZER_TASK_PRIORITY, taskStack, &taskTCB, 0 );
-  assert( taskHandle );
+  bool created = HAL_taskCreate( &task, vTaskBuzzer, "Buzzer", taskStack, BUZZER_STACK_SIZE, BUZZER_TASK_PRIORITY, 0 );
+  assert( created );
 
   for( int x=0; x<BUZZ_BUZZERS_MAX; x++ ) {
     buzzerList[ x ].hash = 0;
@@ -144,7 +143,7 @@ void BUZZ_Init( void ) {
     buzzerList[ x ].active = false;
   }
 
-  globalTime = millis();
+  globalTime = HAL_millis();
   initialized = true;
 }
 
@@ -157,17 +156,17 @@ unsigned int BUZZ_Add( unsigned long startDelay, unsigned long period, unsigned
   unsigned int highestHash = getNextHash();
 
   if( 0 > freeSlotIdx ) {
-    // Serial.println( "BUZZ_Add: no free slot available." );
+    // LOG_Printf( LOG_DEBUG, "BUZZ_Add: no free slot available." );
     return 0;
   }
 
   if( UINT_MAX == highestHash ) {
-    Serial.println( "BUZZ_Add: max hash number riched. No implementation for such situation." );
+    LOG_Printf( LOG_ERROR, "BUZZ_Add: max hash number riched. No implementation for such situation." );
     // some garbage collector could be triggered here
     return 0;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 100/portTICK_PERIOD_MS ) ) ) {
+  if( LOCK_Take( &xLock, 100 ) ) {
     buzzerList[ freeSlotIdx ].hash = highestHash;
     buzzerList[ freeSlotIdx ].start = globalTime + startDelay;
     buzzerList[ freeSlotIdx ].period = period;
@@ -175,10 +174,10 @@ unsigned int BUZZ_Add( unsigned long startDelay, unsigned long period, unsigned
     buzzerList[ freeSlotIdx ].repeatCount = repeat ? repeat-1 : 0;   // repeat only repeat-1 times (one is by default thus -1)
     buzzerList[ freeSlotIdx ].active = true;
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "BUZZ_Add: couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "BUZZ_Add: couldn't take semaphore %u times", failSemaphoreCounter );
   }
 
   return highestHash;
@@ -199,7 +198,7 @@ bool BUZZ_Delete( int handle ) {
     return false;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 100/portTICK_PERIOD_MS ) ) ) {
+  if( LOCK_Take( &xLock, 100 ) ) {
     for( int x=0; x<BUZZ_BUZZERS_MAX; x++ ) {
       if( handle == buzzerList[ x ].hash ) {
         buzzerList[ x ].hash = 0;
@@ -209,10 +208,10 @@ bool BUZZ_Delete( int handle ) {
       }
     }
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "BUZZ_Delete: couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "BUZZ_Delete: couldn't take semaphore %u times", failSemaphoreCounter );
   }
 
   return retValue;
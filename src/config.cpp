@@ -1,30 +1,156 @@
 #include "config.h"
 #include "sdcard.h"
+#include "persist.h"
+#include "nameindex.h"
+#include "trace.h"
 #include "helper.h"
 #include "ArduinoJson.h"
+#include "hal.h"
+#ifdef ARDUINO
 #include "EEPROM.h"
 #include "esp_err.h"
 #include "esp_spiffs.h"
+#include "esp_partition.h"
+#endif
 #include <sys/stat.h>
 
-#define EEPROM_SIZE     1024  // 1kB from eeprom(flash) used
+#define EEPROM_SIZE           1024  // 1kB from eeprom(flash) used (legacy options storage)
+#define OPTIONS_NAMESPACE     "options"
+#define OPTIONS_VERSION       1           // increase when optionSchema changes incompatibly (stored values are dropped)
+#define OPTIONS_COMMIT_DELAY  2000        // options are written to NVS this time [ms] after the last change
+#define STORE_BUFFER_SIZE     256   // bake list is serialized through such buffer directly to the file
+#define FLASH_BASE_PATH       HAL_FLASH_ROOT
+#define BAKE_SNAPSHOT_PATH    FLASH_BASE_PATH "/bakes.txt"
+#define BAKE_SNAPSHOT_TMP     FLASH_BASE_PATH "/bakes.tmp"    // new snapshot is written here and renamed over the old one
+#define BAKE_JOURNAL_PATH     FLASH_BASE_PATH "/bakes.jnl"
+#define FLASH_BENCH_PATH      FLASH_BASE_PATH "/bench.bin"
+#define FLASH_BENCH_SIZE      ( 32 * 1024 )  // test file size for flash throughput benchmark [bytes]
+#define FLASH_BENCH_NAMESPACE "flashbench"  // SPIFFS throughput measured at migration is kept here for comparison
+#define FLASH_ERASED_CHECK    ( 8 * 1024 )  // partition start which has to be erased to be considered empty [bytes]
+#define BAKE_BENCH_PATH       FLASH_BASE_PATH "/bench.txt"    // snapshot written and parsed by bake list benchmark
+#define JOURNAL_MAGIC         0x4C4E4A42  // "BJNL"
+#define JOURNAL_COMPACT_SIZE  4096        // journal bigger than that is merged into snapshot [bytes]
+#define JOURNAL_RECORD_MAX    ( 4 + BAKE_NAME_LENGTH + BAKE_MAX_STEPS * sizeof( bakeStep_t ) )  // max payload of single journal record [bytes]
+#define ARENA_MIN_SIZE        1024        // initial size of bake arena [bytes]
+#define INDEX_MIN_SIZE        16          // initial number of bake index entries
+#define IMPORT_TABLE_MIN      64          // minimal number of slots in name table used by import
+#define ALIGN4(x)             ( ( (x) + 3 ) & ~3u )
+#define STEP_CACHE_SIZE       4           // lazy steps: bakes with steps read from flash kept in RAM (least recently used is dropped)
+#define RECORD_STORED         0x01        // record holds offset of the bake in snapshot file instead of steps
+#define RECORD_REMOVED        0x02        // record is not on the list anymore (waits for arena compaction)
+#define RECORD_NO_REF         UINT32_MAX  // bake steps are kept in RAM
+#define FNV_OFFSET_BASIS      2166136261u
+#define FNV_PRIME             16777619u
+
+#ifdef CONF_LAZY_STEPS
+#define LAZY_STEPS            true
+#else
+#define LAZY_STEPS            false
+#endif
+
+// operations recorded in bake list journal (values are stored in flash, don't change them)
+typedef enum journalOp {
+  JOURNAL_OP_REMOVE = 1,    // payload: uint16_t indexes[]
+  JOURNAL_OP_SWAP,          // payload: uint16_t indexes[2]
+  JOURNAL_OP_ADD,           // payload: packed bake (see packBake())
+  JOURNAL_OP_MOVE,          // payload: uint16_t indexes[2] (from, to)
+  JOURNAL_OP_REORDER,       // payload: uint16_t order[ bakesCount ]
+  JOURNAL_OP_REPLACE,       // payload: uint16_t index, packed bake (see packBake())
+} journalOp_t;
 
-typedef struct option
-{
-  int val;
-  String fileName;
-} option_t;
+/**
+ * One bake in arena (variable length record):
+ * header | name (NULL terminated, padded to 4 bytes) | bakeStep_t step[ stepCount ]
+ * header | name (NULL terminated, padded to 4 bytes) | uint32_t snapshot offset   (RECORD_STORED)
+ */
+typedef struct bakeRecord {
+  uint16_t  stepCount;
+  uint8_t   nameLength;     // without terminating NULL
+  uint8_t   flags;          // RECORD_x
+  uint32_t  hash;           // FNV-1a of name and steps (duplicates detection on import)
+} bakeRecord_t;
+
+typedef struct stepCacheEntry {
+  uint32_t      ref;        // bake offset in snapshot file
+  uint32_t      lastUse;
+  bakeStep_t *  steps;      // NULL: free entry
+} stepCacheEntry_t;
+
+#ifdef BENCH_ENABLE
+// everything what makes up the bake list (swapped with scratch list by benchmark)
+typedef struct bakeList {
+  uint8_t *   arena;
+  uint32_t    arenaSize;
+  uint32_t    arenaUsed;
+  uint32_t    arenaGarbage;
+  uint32_t *  index;
+  uint32_t    indexSize;
+  uint32_t    count;
+} bakeList_t;
+#endif
+
+typedef struct journalHeader {
+  uint32_t  magic;
+  uint32_t  generation;     // must match snapshot's "gen", otherwise journal is outdated
+} journalHeader_t;
+
+typedef enum optionValueType {
+  OPT_TYPE_BOOL = 1,
+  OPT_TYPE_INT,
+} optionValueType_t;
+
+typedef struct optionSchema {
+  const char *        key;          // NVS key (15 chars max)
+  optionValueType_t   type;
+  int32_t             defaultValue;
+} optionSchema_t;
+
+// preserve order according to confOption enum
+static const optionSchema_t optionSchema[ CONF_OPT_COUNT ] = {
+  { "buzzer",   OPT_TYPE_BOOL,  1 },
+  { "ota",      OPT_TYPE_BOOL,  0 },
+};
 
 static bool configAvailable = false;
-static bake_t * bakeList = NULL;          //dynamically allocated buffer
+static int32_t optionValue[ CONF_OPT_COUNT ];   // RAM copy of all options, guarded by optionsMutex
+static bool optionsDirty = false;               // guarded by optionsMutex
+static halMutex_t optionsMutex;
+#ifdef ARDUINO
+static TimerHandle_t optionsTimer = NULL;
+static StaticTimer_t optionsTimerBuffer;
+#endif
+static uint8_t * bakeArena = NULL;        // all bakes as variable length records (dynamically allocated)
+static uint32_t arenaSize = 0;            // allocated bytes
+static uint32_t arenaUsed = 0;            // bytes taken by records (including removed ones)
+static uint32_t arenaGarbage = 0;         // bytes taken by removed records
+static uint32_t * bakeIndex = NULL;       // offset in arena for every bake on the list (list order)
+static uint32_t indexSize = 0;            // allocated entries
 static uint32_t bakesCount = 0;
-static bool spiffsMounted = false;
-static esp_vfs_spiffs_conf_t conf = {
-  .base_path = "/spiffs",
-  .partition_label = NULL,
-  .max_files = 5,
-  .format_if_mount_failed = true
+static uint32_t listGeneration = 0;       // increased on every bake list modification (names/positions/arena moved)
+static uint32_t snapshotGeneration = 0;   // increased on every snapshot write (used by persistence worker only after init)
+static uint32_t journalSize = 0;          // bytes in journal file and waiting for the worker (decides when to rewrite snapshot)
+static bool journalStarted = false;       // journal file for current snapshot generation exists (worker only after init)
+static uint8_t journalPending[ 2 ][ JOURNAL_COMPACT_SIZE ];  // records waiting for the worker (double buffered), guarded by confMutex
+static uint32_t pendingIdx = 0;           // buffer being filled, guarded by confMutex
+static uint32_t pendingLen = 0;           // guarded by confMutex
+static bool snapshotPending = false;      // whole list has to be rewritten, guarded by confMutex
+static halMutex_t confMutex;              // bake list is modified from one task only, worker reads it under this mutex
+static bool flashMounted = false;         // LittleFS stays mounted all the time once mounted
+static bool snapshotWriting = false;      // worker writes snapshot from list copy, arena can't be compacted meanwhile (guarded by confMutex)
+static stepCacheEntry_t stepCache[ STEP_CACHE_SIZE ];   // lazy steps only, guarded by confMutex
+static uint32_t stepCacheClock = 0;       // guarded by confMutex
+#ifdef BENCH_ENABLE
+static bool benchActive = false;          // scratch list is swapped in, nothing is journaled or persisted (guarded by confMutex)
+static bakeList_t benchSaved;             // real bake list while benchmark runs
+#endif
+#ifdef ARDUINO
+static esp_vfs_spiffs_conf_t conf = {     // used only to migrate data stored by older firmware
+  .base_path = FLASH_BASE_PATH,           // same paths as LittleFS, so the same loading code can be used
+  .partition_label = HAL_FLASH_PARTITION,
+  .max_files = HAL_FLASH_MAX_FILES,
+  .format_if_mount_failed = false
 };
+#endif
 
 /**
  * Set few bake positions and save them to file on SDCARD
@@ -46,384 +172,2021 @@ static void setBakeExample() {
   doc["data"][1]["step"][1]["temp"] = 100;
   doc["data"][1]["step"][1]["time"] = MINUTES_TO_SECONDS( 20 );
 
-  String output;
-  serializeJson( doc, output );
-  Serial.println( output );
-  SDCARD_writeFile( "/bakes.txt", output.c_str() );
+  char output[ STORE_BUFFER_SIZE ];
+  serializeJson( doc, output, sizeof( output ) );
+  HAL_printf( "%s\n", output );
+  SDCARD_writeFile( "/bakes.txt", output );
 }
 
-static void loadBakesFromSDCard() {
-  uint8_t * buffer = NULL;
-  uint32_t rlen;
-  bake_t * tmpBakeList;
-  uint32_t tmpBakesCount;
-  JsonDocument doc;
+static void journalAppend( journalOp_t op, const uint8_t * payload, uint32_t len );
+static bool persistBakeList( void * arg );
+static void optionsCommitLater();
 
-  rlen = SDCARD_getFileContent( BAKE_FILE_NAME, &buffer );
-  if( NULL != buffer ) {
-    buffer[ rlen ] = '\0';
-    // Serial.printf( "buffer[%d]: %s\n", rlen, buffer );
+static void confLock() {
+  TRACE_BEGIN( TRACE_CONF_LOCK, 0 );
+  HAL_mutexTake( &confMutex, HAL_WAIT_FOREVER );
+  TRACE_END( TRACE_CONF_LOCK, 0 );
+}
 
-    deserializeJson( doc, buffer );
-    tmpBakesCount = doc["count"];
+static void confUnlock() {
+  HAL_mutexGive( &confMutex );
+}
 
-    if( 0 < tmpBakesCount ) {
-      Serial.printf( "%d new positions will be added to current bake list\n", tmpBakesCount );
-      tmpBakesCount += bakesCount;
-    } else {
-      Serial.println( "File doesn't contain proper data!" );
-      free( buffer );
-      return;
-    }
+static uint32_t recordSize( uint8_t nameLength, uint32_t stepCount ) {
+  return sizeof( bakeRecord_t ) + ALIGN4( nameLength + 1 ) + stepCount * sizeof( bakeStep_t );
+}
 
-    // allocate memory for tmpBakeList (including size of current bakeList)
-    tmpBakeList = (bake_t *)malloc( sizeof( bake_t ) * tmpBakesCount );
-    if( NULL == tmpBakeList ) {
-      Serial.println( "CONF(loadBakesFromSDCard): malloc failed!" );
-      free( buffer );
-      return;
-    }
+static inline bakeRecord_t * getRecord( uint32_t idx ) {
+  return (bakeRecord_t *)( bakeArena + bakeIndex[ idx ] );
+}
 
-    // copy old list positions to the newly created list
-    memcpy( tmpBakeList, bakeList, sizeof( bake_t ) * bakesCount );
+static inline char * getRecordName( bakeRecord_t * rec ) {
+  return (char *)( rec + 1 );
+}
 
-    // add new positions at the end of new list
-    for( int i = bakesCount, x = 0; i < tmpBakesCount; i++, x++ ) {
-      strlcpy( tmpBakeList[i].name, doc["data"][x]["name"], sizeof( tmpBakeList[i].name ) );
-      tmpBakeList[i].stepCount = doc["data"][x]["stepCount"];
-      for( int s = 0; s < tmpBakeList[i].stepCount; s++ ) {
-        tmpBakeList[i].step[s].temp = doc["data"][x]["step"][s]["temp"];
-        tmpBakeList[i].step[s].time = doc["data"][x]["step"][s]["time"];
-      }
-    }
+/**
+ * Name for name index, which is used with confMutex held only (or during init)
+ */
+static const char * indexName( uint32_t idx ) {
+  return ( bakesCount > idx ) ? getRecordName( getRecord( idx ) ) : NULL;
+}
 
-    free( buffer );
-    free( bakeList );       // delete old bake list
-    bakeList = tmpBakeList; // remember new list
-    bakesCount = tmpBakesCount;
-  }
+static inline bakeStep_t * getRecordSteps( bakeRecord_t * rec ) {
+  return (bakeStep_t *)( (uint8_t *)( rec + 1 ) + ALIGN4( rec->nameLength + 1 ) );
 }
 
-static void spiffsMount() {
-  if( spiffsMounted ) {
-    return;
+static inline uint32_t * getRecordRef( bakeRecord_t * rec ) {
+  return (uint32_t *)getRecordSteps( rec );
+}
+
+/**
+ * Bytes really taken by the record in arena
+ */
+static uint32_t recordBytes( bakeRecord_t * rec ) {
+  if( rec->flags & RECORD_STORED ) {
+    return recordSize( rec->nameLength, 0 ) + sizeof( uint32_t );
   }
+  return recordSize( rec->nameLength, rec->stepCount );
+}
 
-  // Initialize and mount SPIFFS filesystem
-  esp_err_t ret = esp_vfs_spiffs_register( &conf );
+/**
+ * Make sure arena has 'size' free bytes and index has 'count' free entries
+ */
+static bool reserveBakes( uint32_t size, uint32_t count ) {
+  if( arenaSize < arenaUsed + size ) {
+    uint32_t newSize = ( ARENA_MIN_SIZE > arenaSize ) ? ARENA_MIN_SIZE : arenaSize;
+    while( newSize < arenaUsed + size ) {
+      newSize *= 2;
+    }
 
-  if ( ESP_OK != ret ) {
-    if ( ESP_FAIL == ret ) {
-      Serial.printf( "CONF(spiffsMount): Failed to mount filesystem\n" );
-    } else if ( ESP_ERR_NOT_FOUND == ret ) {
-      Serial.printf( "CONF(spiffsMount): Failed to find SPIFFS partition\n" );
-    } else {
-      Serial.printf( "CONF(spiffsMount): Failed to initialize SPIFFS (%s)\n", esp_err_to_name(ret) );
+    uint8_t * tmpArena = (uint8_t *)realloc( bakeArena, newSize );
+    if( NULL == tmpArena ) {
+      HAL_printf( "CONF(reserveBakes): arena realloc failed!\n" );
+      return false;
     }
-    return;
+    bakeArena = tmpArena;
+    arenaSize = newSize;
   }
 
-  size_t total = 0, used = 0;
-  ret = esp_spiffs_info( conf.partition_label, &total, &used );
-  if ( ESP_OK != ret ) {
-    Serial.printf( "CONF(spiffsMount): Failed to get SPIFFS partition information (%s). Formatting...\n", esp_err_to_name(ret) );
-    esp_spiffs_format( conf.partition_label );
-    return;
-  } else {
-    Serial.printf( "Partition size: total: %d, used: %d\n", total, used );
-  }
+  if( indexSize < bakesCount + count ) {
+    uint32_t newSize = ( INDEX_MIN_SIZE > indexSize ) ? INDEX_MIN_SIZE : indexSize;
+    while( newSize < bakesCount + count ) {
+      newSize *= 2;
+    }
 
-  // Check consistency of reported partition size info
-  if ( used > total ) {
-    Serial.printf( "Number of used bytes cannot be larger than total. Performing SPIFFS_check()...\n" );
-    ret = esp_spiffs_check( conf.partition_label );
-    if ( ESP_OK != ret ) {
-      Serial.printf( "CONF(spiffsMount): SPIFFS_check() failed (%s)\n", esp_err_to_name(ret) );
-      return;
-    } else {
-      Serial.printf( "SPIFFS_check() successful\n" );
+    uint32_t * tmpIndex = (uint32_t *)realloc( bakeIndex, newSize * sizeof( uint32_t ) );
+    if( NULL == tmpIndex ) {
+      HAL_printf( "CONF(reserveBakes): index realloc failed!\n" );
+      return false;
     }
+    bakeIndex = tmpIndex;
+    indexSize = newSize;
   }
 
-  spiffsMounted = true;
+  return true;
 }
 
-static void spiffsUnmount() {
-  if( !spiffsMounted ) {
-    return;
+/**
+ * Put new record at the end of arena (it's not on the list yet), steps (or snapshot offset) are left for the caller to fill up
+ * Returned record is valid until next list modification (arena can be moved)
+ * stored   - steps stay in snapshot file, record keeps only its offset
+ */
+static bakeRecord_t * allocRecord( const char * name, uint32_t stepCount, bool stored ) {
+  uint8_t nameLength = (uint8_t)strnlen( name, BAKE_NAME_LENGTH - 1 );
+  uint32_t size;
+  bakeRecord_t * rec;
+
+  if( BAKE_MAX_STEPS < stepCount ) {
+    HAL_printf( "CONF(newBake): too much steps (%u) in '%s'\n", stepCount, name );
+    stepCount = BAKE_MAX_STEPS;
   }
 
-  // unmount partition and disable SPIFFS
-  esp_vfs_spiffs_unregister( conf.partition_label );
-  Serial.printf( "SPIFFS partition unmounted\n" );
+  stored = stored && 0 < stepCount;
+  size = stored ? recordSize( nameLength, 0 ) + sizeof( uint32_t ) : recordSize( nameLength, stepCount );
+  if( !reserveBakes( size, 1 ) ) {
+    return NULL;
+  }
 
-  spiffsMounted = false;
-}
+  rec = (bakeRecord_t *)( bakeArena + arenaUsed );
+  rec->stepCount = (uint16_t)stepCount;
+  rec->nameLength = nameLength;
+  rec->flags = stored ? RECORD_STORED : 0;
+  rec->hash = 0;
+  memset( getRecordName( rec ), 0, ALIGN4( nameLength + 1 ) );
+  memcpy( getRecordName( rec ), name, nameLength );
+  arenaUsed += size;
 
-static void loadBakesFromFlash() {
-  uint32_t fileSize = 0;
+  return rec;
+}
 
-  Serial.printf( "Loading bakes from file (flash)...\n" );
+/**
+ * Append new bake at the end of the list, steps (or snapshot offset) and hash are left for the caller to fill up
+ * Returned record is valid until next list modification (arena can be moved)
+ * stored   - steps stay in snapshot file, record keeps only its offset
+ */
+static bakeRecord_t * newBake( const char * name, uint32_t stepCount, bool stored ) {
+  bakeRecord_t * rec;
 
-  spiffsMount();
-  if( !spiffsMounted ) {
-    return;
+  if( UINT16_MAX <= bakesCount ) {   // journal keeps list positions as uint16_t
+    HAL_printf( "CONF(newBake): bake list full\n" );
+    return NULL;
   }
 
-  // Check destination file size
-  struct stat st;
-  if ( 0 != stat( "/spiffs/bakes.txt", &st ) ) {
-    Serial.printf( "File 'bakes.txt' doesn't exist\n" );
-    return;
+  rec = allocRecord( name, stepCount, stored );
+  if( NULL == rec ) {
+    return NULL;
   }
-  fileSize = (uint32_t)st.st_size;
 
-  char * buff;
-  buff = (char *)malloc( fileSize );
+  bakeIndex[ bakesCount++ ] = (uint8_t *)rec - bakeArena;
+  listGeneration++;
+  NIDX_Add( bakesCount - 1 );
 
-  if( NULL == buff ) {
-    Serial.printf( "CONF(loadBakesFromFlash) Malloc failed for buff\n" );
-    return;
+  return rec;
+}
+
+/**
+ * Give bake on the position new content under the same name, old record becomes garbage
+ * Steps (or snapshot offset) and hash are left for the caller to fill up
+ * Returned record is valid until next list modification (arena can be moved)
+ */
+static bakeRecord_t * replaceBake( uint32_t pos, uint32_t stepCount, bool stored ) {
+  char name[ BAKE_NAME_LENGTH ];
+  bakeRecord_t * rec;
+
+  if( bakesCount <= pos ) {
+    return NULL;
   }
 
-  FILE * f = fopen( "/spiffs/bakes.txt", "r" );
-  if ( NULL == f ) {
-    Serial.printf( "CONF(loadBakesFromFlash) Failed to open file for reading\n" );
-    free( buff );
-    return;
+  snprintf( name, sizeof( name ), "%s", getRecordName( getRecord( pos ) ) );  // arena can be moved by allocation
+  rec = allocRecord( name, stepCount, stored );
+  if( NULL == rec ) {
+    return NULL;
   }
 
-  uint32_t readSize;
-  readSize = (uint32_t)fread( buff, sizeof(char), fileSize, f );
-  Serial.printf( "fileSize:%d, readSize:%d\n", fileSize, readSize );
-  fclose( f );
+  bakeRecord_t * old = getRecord( pos );
+  arenaGarbage += recordBytes( old );
+  old->flags |= RECORD_REMOVED;
+  bakeIndex[ pos ] = (uint8_t *)rec - bakeArena;
+  listGeneration++;   // name index keeps positions only, name is the same
 
-  JsonDocument doc;
+  return rec;
+}
 
-  deserializeJson( doc, buff );
-  free( buff );
-  bakesCount = doc["count"];
+/**
+ * Rewrite arena without removed records (in list order)
+ */
+static void compactArena() {
+  uint32_t newSize = ALIGN4( arenaUsed - arenaGarbage );
+  uint32_t used = 0;
+  uint8_t * tmpArena;
 
-  // allocate memory for bakeList
-  bakeList = (bake_t *)calloc( bakesCount, sizeof( bake_t ) );
-  if( NULL == bakeList ) {
-    Serial.printf( "CONF(loadBakesFromFlash) Malloc failed for bakeList\n" );
-    return;
+  if( ARENA_MIN_SIZE > newSize ) {
+    newSize = ARENA_MIN_SIZE;
   }
 
-  for( int i = 0; i < bakesCount; i++ ) {
-    strlcpy( bakeList[i].name, doc["data"][i]["name"], sizeof( bakeList[i].name ) );
-    bakeList[i].stepCount = doc["data"][i]["stepCount"];
-    for( int s = 0; s < bakeList[i].stepCount; s++ ) {
-      bakeList[i].step[s].temp = doc["data"][i]["step"][s]["temp"];
-      bakeList[i].step[s].time = doc["data"][i]["step"][s]["time"];
-    }
+  tmpArena = (uint8_t *)malloc( newSize );
+  if( NULL == tmpArena ) {
+    return;   // try next time, arena is still consistent
   }
 
-  spiffsUnmount();
-}
-
-void CONF_Init( SPIClass * spi ) {
-  SDCARD_Setup( spi );
+  for( int x=0; x<bakesCount; x++ ) {
+    bakeRecord_t * rec = getRecord( x );
+    uint32_t size = recordBytes( rec );
 
-  configAvailable = true;
+    memcpy( tmpArena + used, rec, size );
+    bakeIndex[x] = used;
+    used += size;
+  }
 
-  // setBakeExample();
-  loadBakesFromFlash();
-  // loadBakesFromSDCard();
+  free( bakeArena );
+  bakeArena = tmpArena;
+  arenaSize = newSize;
+  arenaUsed = used;
+  arenaGarbage = 0;
 }
 
-int CONF_getOptionInt( int32_t option ) {
-  if( false == configAvailable ) {
-    return -1;
+static void compactArenaIfNeeded() {
+  if( arenaGarbage > arenaUsed / 2 && !snapshotWriting ) {   // records are looked up by offset when snapshot is done
+    compactArena();
   }
+}
 
-  int32_t retVal = 0;
+/**
+ * Remove any number of bakes at once, order of the remaining ones is preserved
+ * list[]   - positions to remove (any order, duplicates are ignored)
+ */
+static bool removeBakes( const uint16_t list[], uint32_t count ) {
+  uint8_t * removed = (uint8_t *)calloc( ( bakesCount + 7 ) / 8, 1 );   // for name index only
+  uint32_t kept = 0;
 
-  if( EEPROM.begin( EEPROM_SIZE ) ) {
-    retVal = EEPROM.readInt( option );
-    EEPROM.end();
+  for( int x=0; x<count; x++ ) {
+    if( bakesCount > list[x] && UINT32_MAX != bakeIndex[ list[x] ] ) {
+      bakeRecord_t * rec = getRecord( list[x] );
+      arenaGarbage += recordBytes( rec );
+      rec->flags |= RECORD_REMOVED;
+      bakeIndex[ list[x] ] = UINT32_MAX;    // mark this element as not active
+    }
   }
 
-  return retVal;
-}
+  // single pass: slide remaining entries over removed ones
+  for( int x=0; x<bakesCount; x++ ) {
+    if( UINT32_MAX != bakeIndex[x] ) {
+      bakeIndex[ kept++ ] = bakeIndex[x];
+    } else if( NULL != removed ) {
+      removed[ x / 8 ] |= 1 << ( x % 8 );
+    }
+  }
 
-bool CONF_getOptionBool( int32_t option ) {
-  if( false == configAvailable ) {
+  if( kept == bakesCount ) {
+    free( removed );
     return false;
   }
 
-  bool retVal = false;
-
-  if( EEPROM.begin( EEPROM_SIZE ) ) {
-    retVal = EEPROM.readBool( option );
-    EEPROM.end();
+  if( NULL != removed ) {
+    NIDX_Remove( removed, bakesCount );
+    free( removed );
+  } else {
+    NIDX_Invalidate();
   }
+  bakesCount = kept;
+  listGeneration++;
 
-  return retVal;
+  compactArenaIfNeeded();
+
+  return true;
 }
 
-void CONF_setOptionBool( int32_t option, bool value ) {
-  if( false == configAvailable ) {
-    return;
-  }
+static bool swapBakes( uint16_t first, uint16_t second ) {
+  uint32_t tmpOffset;
 
-  if( EEPROM.begin( EEPROM_SIZE ) ) {
-    EEPROM.writeInt( option, value );
-    EEPROM.commit();
-    EEPROM.end();
+  if( bakesCount <= first || bakesCount <= second ) {
+    return false;
   }
+
+  tmpOffset = bakeIndex[ first ];
+  bakeIndex[ first ] = bakeIndex[ second ];
+  bakeIndex[ second ] = tmpOffset;
+  listGeneration++;
+  NIDX_Swap( first, second );
+
+  return true;
 }
 
-void CONF_setOptionInt( int32_t option, int32_t value ) {
-  if( false == configAvailable ) {
-    return;
+/**
+ * Take bake out of its position and insert it at another one, bakes in between are shifted by one
+ */
+static bool moveBake( uint16_t from, uint16_t to ) {
+  uint32_t tmpOffset;
+
+  if( bakesCount <= from || bakesCount <= to ) {
+    return false;
   }
 
-  if( EEPROM.begin( EEPROM_SIZE ) ) {
-    EEPROM.writeBool( option, value );
-    EEPROM.commit();
-    EEPROM.end();
+  tmpOffset = bakeIndex[ from ];
+  if( from < to ) {
+    memmove( &bakeIndex[ from ], &bakeIndex[ from + 1 ], ( to - from ) * sizeof( uint32_t ) );
+  } else {
+    memmove( &bakeIndex[ to + 1 ], &bakeIndex[ to ], ( from - to ) * sizeof( uint32_t ) );
   }
+  bakeIndex[ to ] = tmpOffset;
+  listGeneration++;
+  NIDX_Move( from, to );
+
+  return true;
 }
 
-void CONF_getBakeNames( bakeName **bList, uint32_t *cnt ) {
-  bakeName * bakeNames;
+/**
+ * Arrange whole list at once
+ * order[]  - for every new position: old position of the bake (permutation of all bakes on the list)
+ */
+static bool reorderBakes( const uint16_t order[], uint32_t count ) {
+  uint32_t * tmpIndex;
+  uint8_t * taken;
+  bool retVal = true;
 
-  if( NULL == bakeList ) {
-    *bList = NULL;
-    *cnt = 0;
-    return;
+  if( bakesCount != count || 0 == count ) {
+    return false;
   }
 
-  bakeNames = (bakeName *)malloc( sizeof(bakeName) * bakesCount );
-  if( NULL == bakeNames ) {
-    *bList = NULL;
-    *cnt = 0;
-    Serial.println( "CONF(getBakeNames): malloc failed" );
-    return;
+  tmpIndex = (uint32_t *)malloc( count * sizeof( uint32_t ) );
+  taken = (uint8_t *)calloc( ( count + 7 ) / 8, 1 );
+  if( NULL == tmpIndex || NULL == taken ) {
+    HAL_printf( "CONF(reorderBakes): Malloc failed\n" );
+    free( tmpIndex );
+    free( taken );
+    return false;
   }
 
-  *cnt = bakesCount;
-  *bList = bakeNames;
-  for( int x=0; x<bakesCount; x++) {
-    snprintf( (char *)(*bList+x), sizeof(bakeName), "%s", bakeList[x].name );
+  for( int x=0; x<count; x++ ) {
+    uint16_t old = order[x];
+
+    if( count <= old || ( taken[ old / 8 ] & ( 1 << ( old % 8 ) ) ) ) {
+      retVal = false;   // not a permutation, leave the list untouched
+      break;
+    }
+    taken[ old / 8 ] |= 1 << ( old % 8 );
+    tmpIndex[x] = bakeIndex[ old ];
   }
-}
 
-uint32_t CONF_getBakeTemp( uint32_t idx, uint32_t step ) {
-  if( NULL == bakeList || bakesCount <= idx || BAKE_MAX_STEPS <= step ) {
-    return 0;
+  if( retVal ) {
+    memcpy( bakeIndex, tmpIndex, count * sizeof( uint32_t ) );
+    listGeneration++;
+    NIDX_Reorder( order, count );
   }
-  return bakeList[ idx ].step[ step ].temp;
+
+  free( tmpIndex );
+  free( taken );
+  return retVal;
 }
 
-int32_t CONF_getBakeTime( uint32_t idx, uint32_t step ) {
-  if( NULL == bakeList || bakesCount <= idx || BAKE_MAX_STEPS <= step ) {
-    return 0;
+/**
+ * FNV-1a hash, continue with previous result to hash more data
+ */
+static uint32_t fnv1a( uint32_t hash, const void * data, uint32_t len ) {
+  const uint8_t * bytes = (const uint8_t *)data;
+
+  for( uint32_t x=0; x<len; x++ ) {
+    hash = ( hash ^ bytes[x] ) * FNV_PRIME;
   }
-  return bakeList[ idx ].step[ step ].time;
+  return hash;
 }
 
-uint32_t CONF_getBakeStepCount( uint32_t idx ) {
-  if( NULL == bakeList || bakesCount <= idx ) {
-    return 0;
-  }
-  return bakeList[ idx ].stepCount;
+/**
+ * Hash of the name as stored on the list (start of bake's content hash)
+ * Longer name is truncated like in the record, its terminating NULL is hashed explicitly
+ */
+static uint32_t hashName( const char * name ) {
+  static const char terminator = '\0';
+
+  return fnv1a( fnv1a( FNV_OFFSET_BASIS, name, strnlen( name, BAKE_NAME_LENGTH - 1 ) ), &terminator, 1 );
 }
 
-char * CONF_getBakeName( uint32_t idx ) {
-  if( NULL == bakeList || bakesCount <= idx ) {
-    return 0;
+/**
+ * Content hash of bake described by JSON object, equal to the hash of its record
+ */
+static uint32_t hashJsonBake( JsonVariantConst bake ) {
+  uint32_t stepCount = bake["stepCount"] | 0;
+  uint32_t hash = hashName( bake["name"] | "" );
+
+  if( BAKE_MAX_STEPS < stepCount ) {
+    stepCount = BAKE_MAX_STEPS;
+  }
+  for( int s = 0; s < stepCount; s++ ) {
+    bakeStep_t step = { bake["step"][s]["temp"], bake["step"][s]["time"] };
+    hash = fnv1a( hash, &step, sizeof( step ) );
   }
-  return bakeList[ idx ].name;
+  return hash;
 }
 
-bool CONF_removeBakes( uint8_t list[], uint32_t count ) {
-  bool retVal = false;
+/**
+ * Serialize bake to journal payload: nameLen(1) name stepCount(1) {temp(4) time(4)}[stepCount]
+ * return   - payload length
+ */
+static uint16_t packBake( uint32_t idx, uint8_t * buf ) {
+  bakeRecord_t * rec = getRecord( idx );
+  uint16_t len = 0;
+
+  buf[ len++ ] = rec->nameLength;
+  memcpy( &buf[ len ], getRecordName( rec ), rec->nameLength );
+  len += rec->nameLength;
+  buf[ len++ ] = (uint8_t)rec->stepCount;
+  memcpy( &buf[ len ], getRecordSteps( rec ), rec->stepCount * sizeof( bakeStep_t ) );
+  len += rec->stepCount * sizeof( bakeStep_t );
+
+  return len;
+}
 
-  if( NULL == list || 0 == count ) {
+/**
+ * Deserialize bake from journal payload
+ * pos      - position to replace, bakesCount: append the bake
+ */
+static bool unpackBake( const uint8_t * buf, uint16_t len, uint32_t pos ) {
+  char name[ BAKE_NAME_LENGTH ];
+  uint8_t nameLen = buf[0];
+  uint8_t stepCount;
+  bakeRecord_t * rec;
+
+  if( BAKE_NAME_LENGTH <= nameLen || len < nameLen + 2 ) {
     return false;
   }
 
-  for( int x=0; x<count; x++ ) {
-    bakeList[ list[x] ].stepCount = 0;    // use stepCount as marker (mark this element as not active)
+  stepCount = buf[ nameLen + 1 ];
+  if( len != nameLen + 2 + stepCount * sizeof( bakeStep_t ) ) {
+    return false;
   }
 
-  // move last elements to previously removed places
-  for( int x=0; x<bakesCount; x++ ) {
-    if( 0 == bakeList[x].stepCount ) {  // found empty slot
-      for( int src=x, dst=x+1; dst<bakesCount; src++, dst++ ) {
-        memcpy( &bakeList[src], &bakeList[dst], sizeof( bake_t ) );
-      }
-      bakesCount--;
-      // mark last element as not active
-      bakeList[ bakesCount ].stepCount = 0;
-      retVal = true;
-      x--; // don't skip 'next first' element after movement of the rest
-    }
+  memcpy( name, &buf[1], nameLen );
+  name[ nameLen ] = '\0';
+
+  if( bakesCount == pos ) {
+    rec = newBake( name, stepCount, false );
+  } else {
+    rec = replaceBake( pos, stepCount, false );
+  }
+  if( NULL == rec ) {
+    return false;
   }
+  memcpy( getRecordSteps( rec ), &buf[ nameLen + 2 ], stepCount * sizeof( bakeStep_t ) );
+  rec->hash = fnv1a( hashName( name ), getRecordSteps( rec ), stepCount * sizeof( bakeStep_t ) );
 
-  return retVal;
+  return true;
 }
 
-bool CONF_swapBakes( uint8_t list[] ) {
-  bake_t tmpBake;
+/**
+ * Fill up new record with content of bake described by JSON object
+ * ref      - offset of the object in snapshot file (stored record) or RECORD_NO_REF
+ */
+static void fillBakeFromJson( bakeRecord_t * rec, JsonVariantConst bake, uint32_t ref ) {
+  rec->hash = hashJsonBake( bake );
 
-  if( NULL == list ) {
-    return false;
+  if( rec->flags & RECORD_STORED ) {
+    *getRecordRef( rec ) = ref;
+    return;
   }
 
-  memcpy( &tmpBake, &bakeList[ list[0] ], sizeof( bake_t ) );
-  memcpy( &bakeList[ list[0] ], &bakeList[ list[1] ], sizeof( bake_t ) );
-  memcpy( &bakeList[ list[1] ], &tmpBake, sizeof( bake_t ) );
-
-  return true;
+  bakeStep_t * steps = getRecordSteps( rec );
+  for( int s = 0; s < rec->stepCount; s++ ) {
+    steps[s].temp = bake["step"][s]["temp"];
+    steps[s].time = bake["step"][s]["time"];
+  }
 }
 
-void CONF_addBakesFromFile( void ) {
-  if( SDCARD_Reinit() ) {
-    loadBakesFromSDCard();
-    SDCARD_Eject();
-  } else {
-    Serial.println( "CONF(addBakesFromFile): SDCarc initialization failed" );
+/**
+ * Append bake described by JSON object to the list
+ * ref      - offset of the object in snapshot file (steps are read from there on demand) or RECORD_NO_REF
+ */
+static bool addBakeFromJson( JsonVariantConst bake, uint32_t ref ) {
+  bakeRecord_t * rec = newBake( bake["name"] | "", bake["stepCount"] | 0, RECORD_NO_REF != ref );
+
+  if( NULL == rec ) {
+    return false;
   }
+
+  fillBakeFromJson( rec, bake, ref );
+  return true;
 }
 
-void CONF_storeBakeList() {
-  spiffsMount();
+/**
+ * Put list position to import table (slot for it is always available)
+ */
+static void importTableInsert( uint16_t * table, uint32_t slots, uint32_t pos ) {
+  uint32_t slot = hashName( getRecordName( getRecord( pos ) ) ) & ( slots - 1 );
 
-  if( !spiffsMounted ) {
-    return;
+  while( UINT16_MAX != table[ slot ] ) {
+    slot = ( slot + 1 ) & ( slots - 1 );
   }
+  table[ slot ] = (uint16_t)pos;
+}
 
+/**
+ * Import bakes from SD card file
+ * Bake identical to one already on the list is skipped, bake with the same name but different steps replaces it
+ */
+static void loadBakesFromSDCard() {
+  uint8_t * buffer = NULL;
+  uint8_t * record;
+  uint16_t * table;
+  uint32_t slots;
+  uint32_t rlen;
+  uint32_t newBakesCount;
+  uint32_t added = 0, replaced = 0, skipped = 0;
   JsonDocument doc;
 
-  // prepare file content
-  doc["count"] = bakesCount;
-  for( int x=0; x<bakesCount; x++ ) {
-    doc["data"][x]["name"] = bakeList[x].name;
-    doc["data"][x]["stepCount"] = bakeList[x].stepCount;
-    for( int y=0; y<bakeList[x].stepCount; y++ ) {
-      doc["data"][x]["step"][y]["temp"] = bakeList[x].step[y].temp;
-      doc["data"][x]["step"][y]["time"] = bakeList[x].step[y].time;
+  rlen = SDCARD_getFileContent( BAKE_FILE_NAME, &buffer );
+  if( NULL != buffer ) {
+    buffer[ rlen ] = '\0';
+    // HAL_printf( "buffer[%d]: %s\n", rlen, buffer );
+
+    deserializeJson( doc, buffer );
+    free( buffer );
+    newBakesCount = doc["count"] | 0;
+    if( doc["data"].size() < newBakesCount ) {
+      newBakesCount = doc["data"].size();    // "count" is not trusted, table is sized from it
+    }
+    if( UINT16_MAX - bakesCount < newBakesCount ) {
+      newBakesCount = UINT16_MAX - bakesCount;    // positions are uint16_t, UINT16_MAX marks free slot
+    }
+
+    if( 0 < newBakesCount ) {
+      HAL_printf( "%d positions will be imported to current bake list\n", newBakesCount );
+    } else {
+      HAL_printf( "File doesn't contain proper data!\n" );
+      return;
+    }
+
+    // open addressing table of list positions hashed by name (at most half full)
+    slots = IMPORT_TABLE_MIN;
+    while( slots < 2 * ( bakesCount + newBakesCount ) ) {
+      slots *= 2;
+    }
+    record = (uint8_t *)malloc( JOURNAL_RECORD_MAX );
+    table = (uint16_t *)malloc( slots * sizeof( uint16_t ) );
+    if( NULL == record || NULL == table ) {
+      HAL_printf( "CONF(loadBakesFromSDCard): malloc failed!\n" );
+      free( record );
+      free( table );
+      return;
+    }
+    memset( table, 0xFF, slots * sizeof( uint16_t ) );   // UINT16_MAX: free slot
+    for( int x = 0; x < bakesCount; x++ ) {
+      importTableInsert( table, slots, x );
     }
+    NIDX_Invalidate();    // sorted insert of every imported name would make the import O(n^2)
+
+    uint32_t x = 0;
+    for( JsonVariantConst bake : doc["data"].as<JsonArrayConst>() ) {   // doc["data"][x] walks the array from its head every time
+      if( newBakesCount <= x++ ) {
+        break;    // import table is sized for "count" bakes
+      }
+
+      const char * name = bake["name"] | "";
+      uint32_t hash = hashJsonBake( bake );
+      uint32_t sameName = UINT32_MAX;
+      bool duplicate = false;
+
+      // look through all bakes with the same name
+      for( uint32_t slot = hashName( name ) & ( slots - 1 ); UINT16_MAX != table[ slot ]; slot = ( slot + 1 ) & ( slots - 1 ) ) {
+        bakeRecord_t * rec = getRecord( table[ slot ] );
+
+        if( 0 == strncmp( getRecordName( rec ), name, BAKE_NAME_LENGTH - 1 ) ) {
+          if( hash == rec->hash ) {
+            duplicate = true;
+            break;
+          }
+          if( UINT32_MAX == sameName ) {
+            sameName = table[ slot ];
+          }
+        }
+      }
+
+      if( duplicate ) {
+        skipped++;
+      } else if( UINT32_MAX != sameName ) {
+        // changed bake: new content at the old position
+        bakeRecord_t * rec = replaceBake( sameName, bake["stepCount"] | 0, false );
+        if( NULL != rec ) {
+          uint16_t pos = (uint16_t)sameName;
+
+          fillBakeFromJson( rec, bake, RECORD_NO_REF );
+          memcpy( record, &pos, sizeof( pos ) );
+          journalAppend( JOURNAL_OP_REPLACE, record, sizeof( pos ) + packBake( sameName, record + sizeof( pos ) ) );
+          replaced++;
+        }
+      } else if( addBakeFromJson( bake, RECORD_NO_REF ) ) {
+        journalAppend( JOURNAL_OP_ADD, record, packBake( bakesCount - 1, record ) );
+        importTableInsert( table, slots, bakesCount - 1 );
+        added++;
+      }
+    }
+
+    free( record );
+    free( table );
+    compactArenaIfNeeded();
+    NIDX_Rebuild();
+
+    HAL_printf( "Import: %u added, %u replaced, %u duplicates skipped\n", added, replaced, skipped );
+  }
+}
+
+static uint8_t journalChecksum( uint8_t sum, const uint8_t * data, uint32_t len ) {
+  for( uint32_t x=0; x<len; x++ ) {
+    sum += data[x];
   }
+  return sum;
+}
+
+/**
+ * Start new (empty) journal bound to current snapshot generation
+ */
+static bool journalReset() {
+  journalHeader_t header = { JOURNAL_MAGIC, snapshotGeneration };
 
-  String output;
-  serializeJson( doc, output );
-  Serial.printf( "Data to be saved: %s\n", output.c_str() );
+  journalStarted = false;
 
-  // save file to partition
-  Serial.printf( "Opening file...\n" );
-  FILE * f = fopen( "/spiffs/bakes.txt", "w" );
+  FILE * f = fopen( BAKE_JOURNAL_PATH, "w" );
   if ( NULL == f ) {
-    Serial.printf( "CONF(storeBakeList): Failed to open file for writing\n" );
-    return;
+    HAL_printf( "CONF(journalReset): Failed to open journal for writing\n" );
+    return false;
   }
-  fprintf( f, "%s", output.c_str() );
+
+  journalStarted = ( sizeof( header ) == fwrite( &header, 1, sizeof( header ), f ) );
   fclose( f );
-  Serial.printf( "File written\n" );
 
-  spiffsUnmount();
+  return journalStarted;
+}
+
+/**
+ * Record single bake list edit in journal, the record is written to flash by persistence worker
+ * Whole snapshot is rewritten instead when journal grows too big (caller holds confMutex)
+ * op       - edit operation
+ * payload  - operation's data
+ * len      - payload length
+ */
+static void journalAppend( journalOp_t op, const uint8_t * payload, uint32_t len ) {
+  uint8_t head[3];
+  uint8_t sum;
+
+#ifdef BENCH_ENABLE
+  if( benchActive ) {
+    return;   // scratch list edit
+  }
+#endif
+
+  if( !snapshotPending ) {
+    if( JOURNAL_RECORD_MAX < len
+     || JOURNAL_COMPACT_SIZE < journalSize + sizeof( head ) + len + 1 ) {
+      // edit is already applied to bake list so snapshot contains it, waiting records are not needed anymore
+      snapshotPending = true;
+      pendingLen = 0;
+      journalSize = sizeof( journalHeader_t );
+    } else {
+      uint8_t * record = &journalPending[ pendingIdx ][ pendingLen ];
+
+      head[0] = (uint8_t)op;
+      head[1] = (uint8_t)len;
+      head[2] = (uint8_t)( len >> 8 );
+      sum = journalChecksum( journalChecksum( 0, head, sizeof( head ) ), payload, len );
+
+      memcpy( record, head, sizeof( head ) );
+      memcpy( record + sizeof( head ), payload, len );
+      record[ sizeof( head ) + len ] = sum;
+      pendingLen += sizeof( head ) + len + 1;
+      journalSize += sizeof( head ) + len + 1;
+    }
+  }
+
+  PERSIST_Submit( persistBakeList, NULL, NULL );   // merged with already waiting request
+}
+
+/**
+ * Append waiting records to journal file (persistence worker)
+ */
+static bool journalWrite( const uint8_t * data, uint32_t len ) {
+  if( !flashMounted ) {
+    return false;
+  }
+
+  if( !journalStarted && !journalReset() ) {
+    return false;
+  }
+
+  FILE * f = fopen( BAKE_JOURNAL_PATH, "a" );
+  if ( NULL == f ) {
+    HAL_printf( "CONF(journalWrite): Failed to open journal\n" );
+    return false;
+  }
+
+  bool retVal = ( len == fwrite( data, 1, len, f ) );
+  fclose( f );
+
+  if( !retVal ) {
+    HAL_printf( "CONF(journalWrite): Write failed\n" );
+  }
+  return retVal;
+}
+
+/**
+ * Apply journal records on top of loaded snapshot (filesystem has to be mounted)
+ */
+static void journalReplay() {
+  journalHeader_t header;
+  uint8_t head[3];
+  uint8_t * payload;
+  uint8_t sum;
+  uint16_t len;
+  uint32_t applied = 0;
+  bool corrupted = false;
+
+  journalSize = 0;
+
+  FILE * f = fopen( BAKE_JOURNAL_PATH, "r" );
+  if ( NULL == f ) {
+    return;     // no journal, nothing to apply
+  }
+
+  payload = (uint8_t *)malloc( JOURNAL_RECORD_MAX );
+  if( NULL == payload ) {
+    HAL_printf( "CONF(journalReplay): Malloc failed for payload\n" );
+    fclose( f );
+    return;
+  }
+
+  if( sizeof( header ) != fread( &header, 1, sizeof( header ), f )
+   || JOURNAL_MAGIC != header.magic
+   || snapshotGeneration != header.generation ) {
+    HAL_printf( "Journal outdated, ignored\n" );
+    free( payload );
+    fclose( f );
+    return;
+  }
+  journalSize = sizeof( header );
+  journalStarted = true;
+
+  while( sizeof( head ) == fread( head, 1, sizeof( head ), f ) ) {
+    memcpy( &len, &head[1], sizeof( len ) );
+
+    if( JOURNAL_RECORD_MAX < len
+     || len != fread( payload, 1, len, f )
+     || 1 != fread( &sum, 1, 1, f )
+     || sum != journalChecksum( journalChecksum( 0, head, sizeof( head ) ), payload, len ) ) {
+      corrupted = true;     // most probably torn write at the end of journal
+      break;
+    }
+
+    switch( head[0] ) {
+      case JOURNAL_OP_REMOVE: {
+        uint16_t list[ len / sizeof( uint16_t ) + 1 ];
+        memcpy( list, payload, len );
+        removeBakes( list, len / sizeof( uint16_t ) );
+        break;
+      }
+      case JOURNAL_OP_SWAP: {
+        uint16_t list[2];
+        if( sizeof( list ) == len ) {
+          memcpy( list, payload, len );
+          swapBakes( list[0], list[1] );
+        }
+        break;
+      }
+      case JOURNAL_OP_ADD: {
+        unpackBake( payload, len, bakesCount );
+        break;
+      }
+      case JOURNAL_OP_REPLACE: {
+        uint16_t pos;
+        if( sizeof( pos ) < len ) {
+          memcpy( &pos, payload, sizeof( pos ) );
+          if( bakesCount > pos ) {
+            unpackBake( payload + sizeof( pos ), len - sizeof( pos ), pos );
+          }
+        }
+        break;
+      }
+      case JOURNAL_OP_MOVE: {
+        uint16_t list[2];
+        if( sizeof( list ) == len ) {
+          memcpy( list, payload, len );
+          moveBake( list[0], list[1] );
+        }
+        break;
+      }
+      case JOURNAL_OP_REORDER: {
+        uint16_t order[ len / sizeof( uint16_t ) + 1 ];
+        memcpy( order, payload, len );
+        reorderBakes( order, len / sizeof( uint16_t ) );
+        break;
+      }
+      default: {
+        HAL_printf( "CONF(journalReplay): Unknown operation %d\n", head[0] );
+        break;
+      }
+    }
+
+    journalSize += sizeof( head ) + len + 1;
+    applied++;
+  }
+  free( payload );
+  fclose( f );
+
+  HAL_printf( "Journal: %u edits applied (%u bytes)\n", applied, journalSize );
+
+  if( corrupted ) {
+    HAL_printf( "CONF(journalReplay): Journal corrupted, rewriting snapshot\n" );
+    journalSize = JOURNAL_COMPACT_SIZE;   // force snapshot on next edit (tail of journal is unusable)
+  }
+}
+
+/**
+ * Buffered writer used by ArduinoJson to serialize straight into opened file
+ * (no intermediate String with whole file content)
+ */
+class FileWriter {
+  public:
+    explicit FileWriter( FILE * f ) : file( f ), used( 0 ), total( 0 ), failed( false ) {}
+
+    size_t write( uint8_t c ) {
+      if( STORE_BUFFER_SIZE <= used && false == flush() ) {
+        return 0;
+      }
+      buffer[ used++ ] = c;
+      return 1;
+    }
+
+    size_t write( const uint8_t * s, size_t n ) {
+      for( size_t x=0; x<n; x++ ) {
+        if( 0 == write( s[x] ) ) {
+          return x;
+        }
+      }
+      return n;
+    }
+
+    size_t write( const char * s ) {
+      return write( (const uint8_t *)s, strlen( s ) );
+    }
+
+    bool flush() {
+      if( 0 < used ) {
+        if( used != fwrite( buffer, sizeof(uint8_t), used, file ) ) {
+          failed = true;
+        }
+        total += used;
+        used = 0;
+      }
+      return !failed;
+    }
+
+    uint32_t written() const { return total + used; }
+    bool error() const { return failed; }
+
+  private:
+    FILE *    file;
+    uint8_t   buffer[ STORE_BUFFER_SIZE ];
+    size_t    used;
+    uint32_t  total;
+    bool      failed;
+};
+
+/**
+ * Buffered reader used by ArduinoJson to deserialize straight from opened file
+ * Keeps track of file position, so offsets of JSON values can be remembered
+ */
+class FileReader {
+  public:
+    FileReader( FILE * f, uint32_t offset ) : file( f ), used( 0 ), filled( 0 ), pos( offset ) {}
+
+    int peek() {
+      if( used == filled ) {
+        filled = fread( buffer, sizeof(uint8_t), STORE_BUFFER_SIZE, file );
+        used = 0;
+        if( 0 == filled ) {
+          return -1;
+        }
+      }
+      return buffer[ used ];
+    }
+
+    int read() {
+      int c = peek();
+      if( 0 <= c ) {
+        used++;
+        pos++;
+      }
+      return c;
+    }
+
+    size_t readBytes( char * s, size_t n ) {
+      size_t x;
+      for( x=0; x<n; x++ ) {
+        int c = read();
+        if( 0 > c ) {
+          break;
+        }
+        s[x] = (char)c;
+      }
+      return x;
+    }
+
+    // skip white spaces and return next character (not consumed)
+    int skipSpaces() {
+      int c;
+      while( ' ' == ( c = peek() ) || '\n' == c || '\r' == c || '\t' == c ) {
+        read();
+      }
+      return c;
+    }
+
+    uint32_t position() const { return pos; }
+
+  private:
+    FILE *    file;
+    uint8_t   buffer[ STORE_BUFFER_SIZE ];
+    size_t    used;
+    size_t    filled;
+    uint32_t  pos;
+};
+
+/**
+ * Read steps of bake which stayed in snapshot file
+ * f        - opened snapshot
+ * ref      - offset of bake's object in snapshot
+ * steps    - buffer for 'stepCount' steps
+ */
+static bool readStoredSteps( FILE * f, uint32_t ref, bakeStep_t * steps, uint32_t stepCount ) {
+  JsonDocument doc;
+
+  if( 0 != fseek( f, ref, SEEK_SET ) ) {
+    return false;
+  }
+
+  FileReader reader( f, ref );
+  if( DeserializationError::Ok != deserializeJson( doc, reader )
+   || stepCount > ( doc["stepCount"] | 0 ) ) {
+    return false;   // offset doesn't point to this bake
+  }
+
+  for( int s = 0; s < stepCount; s++ ) {
+    steps[s].temp = doc["step"][s]["temp"];
+    steps[s].time = doc["step"][s]["time"];
+  }
+  return true;
+}
+
+static void stepCacheClear() {
+  for( int x=0; x<STEP_CACHE_SIZE; x++ ) {
+    free( stepCache[x].steps );
+    stepCache[x].steps = NULL;
+    stepCache[x].lastUse = 0;
+  }
+}
+
+/**
+ * Get steps of bake on given position (caller holds confMutex)
+ * Steps left in snapshot are read through LRU cache
+ *
+ * return   - pointer to steps valid until next list modification or CONF call, NULL on read error
+ */
+static const bakeStep_t * getBakeSteps( uint32_t idx ) {
+  bakeRecord_t * rec = getRecord( idx );
+  stepCacheEntry_t * entry = NULL;
+  bakeStep_t * steps;
+  uint32_t ref;
+  bool success = false;
+
+  if( 0 == ( rec->flags & RECORD_STORED ) ) {
+    return getRecordSteps( rec );
+  }
+
+  ref = *getRecordRef( rec );
+  stepCacheClock++;
+  for( int x=0; x<STEP_CACHE_SIZE; x++ ) {
+    if( NULL != stepCache[x].steps && ref == stepCache[x].ref ) {
+      stepCache[x].lastUse = stepCacheClock;
+      return stepCache[x].steps;
+    }
+    if( NULL == entry || stepCache[x].lastUse < entry->lastUse ) {
+      entry = &stepCache[x];  // free entries have lastUse == 0
+    }
+  }
+
+  // miss: least recently used entry is replaced
+  unsigned long start = HAL_micros();
+  free( entry->steps );
+  entry->steps = NULL;
+  entry->lastUse = 0;
+
+  steps = (bakeStep_t *)malloc( rec->stepCount * sizeof( bakeStep_t ) );
+  FILE * f = fopen( BAKE_SNAPSHOT_PATH, "r" );
+  if( NULL != steps && NULL != f ) {
+    success = readStoredSteps( f, ref, steps, rec->stepCount );
+  }
+  if( NULL != f ) {
+    fclose( f );
+  }
+
+  if( !success ) {
+    HAL_printf( "CONF(getBakeSteps): Failed to read steps of '%s'\n", getRecordName( rec ) );
+    free( steps );
+    return NULL;
+  }
+
+  entry->ref = ref;
+  entry->lastUse = stepCacheClock;
+  entry->steps = steps;
+  HAL_printf( "Steps of '%s' read in %lu[uS]\n", getRecordName( rec ), HAL_micros() - start );
+
+  return steps;
+}
+
+#ifdef ARDUINO
+/**
+ * Mount SPIFFS partition left by older firmware (read only usage, for migration)
+ */
+static bool spiffsMount() {
+  unsigned long start = HAL_micros();
+  esp_err_t ret = esp_vfs_spiffs_register( &conf );
+
+  if ( ESP_OK != ret ) {
+    if ( ESP_FAIL == ret ) {
+      HAL_printf( "CONF(spiffsMount): Failed to mount filesystem\n" );
+    } else if ( ESP_ERR_NOT_FOUND == ret ) {
+      HAL_printf( "CONF(spiffsMount): Failed to find SPIFFS partition\n" );
+    } else {
+      HAL_printf( "CONF(spiffsMount): Failed to initialize SPIFFS (%s)\n", esp_err_to_name(ret) );
+    }
+    return false;
+  }
+
+  size_t total = 0, used = 0;
+  if ( ESP_OK != esp_spiffs_info( conf.partition_label, &total, &used ) || used > total ) {
+    HAL_printf( "CONF(spiffsMount): SPIFFS partition inconsistent\n" );
+    esp_vfs_spiffs_unregister( conf.partition_label );
+    return false;
+  }
+
+  HAL_printf( "SPIFFS mounted in %lu[uS], total: %u, used: %u\n", HAL_micros() - start, (uint32_t)total, (uint32_t)used );
+  return true;
+}
+
+static void spiffsUnmount() {
+  esp_vfs_spiffs_unregister( conf.partition_label );
+  HAL_printf( "SPIFFS partition unmounted\n" );
+}
+#endif
+
+/**
+ * Mount LittleFS, it stays mounted (files are opened/closed on demand)
+ * format   - format partition if it can't be mounted
+ */
+static bool flashMount( bool format ) {
+  if( flashMounted ) {
+    return true;
+  }
+
+  uint32_t start = HAL_micros();
+  uint32_t total, used;
+
+  if( !HAL_fsMount( format ) ) {
+    return false;
+  }
+
+  HAL_fsUsage( &total, &used );
+  HAL_printf( "LittleFS mounted in %u[uS], total: %u, used: %u\n", HAL_micros() - start, total, used );
+  flashMounted = true;
+  return true;
+}
+
+#ifdef CONF_FLASH_BENCHMARK
+typedef struct flashBench {
+  uint32_t  write;    // [kB/s]
+  uint32_t  read;     // [kB/s]
+} flashBench_t;
+
+/**
+ * Measure write/read throughput of currently mounted filesystem (test file is removed afterwards)
+ * fsName   - filesystem name for the log
+ * result   - throughput (left untouched when the test fails)
+ */
+static bool flashBenchmark( const char * fsName, flashBench_t * result ) {
+  uint8_t buffer[ STORE_BUFFER_SIZE ];
+  unsigned long start;
+  uint32_t writeTime, readTime, done = 0;
+
+  memset( buffer, 0xA5, sizeof( buffer ) );
+
+  FILE * f = fopen( FLASH_BENCH_PATH, "w" );
+  if( NULL == f ) {
+    HAL_printf( "CONF(flashBenchmark): Failed to open test file\n" );
+    return false;
+  }
+  start = HAL_micros();
+  for( uint32_t x=0; x<FLASH_BENCH_SIZE; x+=sizeof( buffer ) ) {
+    done += fwrite( buffer, 1, sizeof( buffer ), f );
+  }
+  fclose( f );
+  writeTime = HAL_micros() - start;
+
+  f = fopen( FLASH_BENCH_PATH, "r" );
+  if( NULL == f ) {
+    HAL_printf( "CONF(flashBenchmark): Failed to open test file\n" );
+    remove( FLASH_BENCH_PATH );
+    return false;
+  }
+  start = HAL_micros();
+  while( sizeof( buffer ) == fread( buffer, 1, sizeof( buffer ), f ) );
+  fclose( f );
+  readTime = HAL_micros() - start;
+  remove( FLASH_BENCH_PATH );
+
+  result->write = (uint32_t)( (uint64_t)done * 1000 / ( writeTime + 1 ) );
+  result->read = (uint32_t)( (uint64_t)done * 1000 / ( readTime + 1 ) );
+  HAL_printf( "%s benchmark (%u bytes): write %u[kB/s], read %u[kB/s]\n", fsName, done, result->write, result->read );
+  return true;
+}
+
+/**
+ * SPIFFS can be measured only before migration (same partition), its result is kept in NVS
+ * so LittleFS can be compared with it on every boot
+ */
+static void flashBenchmarkStore( const flashBench_t * spiffs ) {
+  HAL_nvsSetInt( FLASH_BENCH_NAMESPACE, "write", (int32_t)spiffs->write );
+  HAL_nvsSetInt( FLASH_BENCH_NAMESPACE, "read", (int32_t)spiffs->read );
+}
+
+static void flashBenchmarkCompare() {
+  flashBench_t littlefs;
+  int32_t spiffsWrite = 0, spiffsRead = 0;
+
+  if( !flashBenchmark( "LittleFS", &littlefs ) ) {
+    return;
+  }
+  HAL_nvsGetInt( FLASH_BENCH_NAMESPACE, "write", &spiffsWrite );
+  HAL_nvsGetInt( FLASH_BENCH_NAMESPACE, "read", &spiffsRead );
+  flashBench_t spiffs = { (uint32_t)spiffsWrite, (uint32_t)spiffsRead };
+
+  if( 0 == spiffs.write || 0 == spiffs.read ) {
+    HAL_printf( "Flash benchmark: no SPIFFS result (measured only during migration from SPIFFS)\n" );
+    return;
+  }
+  HAL_printf( "Flash benchmark [kB/s]   %8s %8s\n", "write", "read" );
+  HAL_printf( "  SPIFFS (at migration)  %8u %8u\n", spiffs.write, spiffs.read );
+  HAL_printf( "  LittleFS               %8u %8u\n", littlefs.write, littlefs.read );
+  HAL_printf( "  LittleFS/SPIFFS        %7u%% %7u%%\n", littlefs.write * 100 / spiffs.write, littlefs.read * 100 / spiffs.read );
+}
+#endif
+
+#ifdef ARDUINO
+/**
+ * Partition holds no data at all (new device), nothing can be lost by formatting it
+ */
+static bool flashErased() {
+  const esp_partition_t * part = esp_partition_find_first( ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, HAL_FLASH_PARTITION );
+  uint32_t buffer[ 64 ];
+
+  if( NULL == part ) {
+    return false;
+  }
+  for( uint32_t offset = 0; offset < FLASH_ERASED_CHECK && offset < part->size; offset += sizeof( buffer ) ) {
+    if( ESP_OK != esp_partition_read( part, offset, buffer, sizeof( buffer ) ) ) {
+      return false;
+    }
+    for( int x=0; x<sizeof( buffer ) / sizeof( uint32_t ); x++ ) {
+      if( UINT32_MAX != buffer[x] ) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+#endif
+
+/**
+ * Parse snapshot: {"count":N,"gen":G,"data":[{bake},{bake},...]}
+ * Bakes are deserialized one by one, whole file is never held in RAM
+ * lazy     - leave steps in file, bakes keep offsets of their objects
+ *
+ * return   - false when file is corrupted (bakes parsed so far stay on the list)
+ */
+static bool parseSnapshot( FILE * f, bool lazy ) {
+  FileReader reader( f, 0 );
+  JsonDocument doc;   // holds only one bake at a time
+  char key[ 8 ];
+  int c;
+
+  if( '{' != reader.skipSpaces() ) {
+    return false;
+  }
+  reader.read();
+
+  do {
+    uint32_t len = 0;
+
+    if( '"' != reader.skipSpaces() ) {
+      return false;
+    }
+    reader.read();
+    while( '"' != ( c = reader.read() ) ) {
+      if( 0 > c ) {
+        return false;
+      }
+      if( sizeof( key ) - 1 > len ) {
+        key[ len++ ] = (char)c;
+      }
+    }
+    key[ len ] = '\0';
+
+    if( ':' != reader.skipSpaces() ) {
+      return false;
+    }
+    reader.read();
+
+    if( 0 == strcmp( key, "data" ) ) {
+      if( '[' != reader.skipSpaces() ) {
+        return false;
+      }
+      reader.read();
+
+      c = reader.skipSpaces();
+      while( ']' != c ) {
+        uint32_t ref = reader.position();
+
+        if( DeserializationError::Ok != deserializeJson( doc, reader ) ) {
+          return false;
+        }
+        if( !addBakeFromJson( doc.as<JsonVariantConst>(), lazy ? ref : RECORD_NO_REF ) ) {
+          HAL_printf( "CONF(parseSnapshot) Malloc failed for bake list\n" );
+          return true;  // file is fine, keep what fits in RAM
+        }
+
+        c = reader.skipSpaces();
+        if( ',' == c ) {
+          reader.read();
+          reader.skipSpaces();
+        } else if( ']' != c ) {
+          return false;
+        }
+      }
+      reader.read();
+    } else {
+      // other values are plain numbers
+      int32_t value = 0;
+
+      if( !isdigit( reader.skipSpaces() ) ) {
+        return false;
+      }
+      while( isdigit( reader.peek() ) ) {
+        value = value * 10 + ( reader.read() - '0' );
+      }
+      if( 0 == strcmp( key, "gen" ) ) {
+        snapshotGeneration = value;
+      }
+    }
+
+    c = reader.skipSpaces();
+    reader.read();
+  } while( ',' == c );
+
+  return ( '}' == c );
+}
+
+/**
+ * Load snapshot and apply journal on top of it (filesystem has to be mounted)
+ * lazy     - steps of bakes from snapshot are not loaded to RAM (read on demand)
+ *
+ * return   - false when snapshot is corrupted (bakes read up to that point are kept)
+ */
+static bool loadBakesFromFiles( bool lazy ) {
+  unsigned long start = HAL_micros();
+  bool retVal = true;
+
+  FILE * f = fopen( BAKE_SNAPSHOT_PATH, "r" );
+  if ( NULL == f ) {
+    HAL_printf( "File 'bakes.txt' doesn't exist\n" );
+    journalReplay();
+    return true;
+  }
+
+  if( !parseSnapshot( f, lazy ) ) {
+    HAL_printf( "CONF(loadBakesFromFiles) Snapshot corrupted at bake %u\n", bakesCount );
+    retVal = false;
+  }
+  fclose( f );
+  HAL_printf( "Snapshot: %u bakes read in %lu[uS]%s\n", bakesCount, HAL_micros() - start, lazy ? " (lazy steps)" : "" );
+
+  journalReplay();
+  return retVal;
+}
+
+#ifdef ARDUINO
+/**
+ * Partition still holds SPIFFS written by older firmware: read bake list from it,
+ * format partition as LittleFS and write the list there again before anything else runs
+ * Partition is formatted only when the list was read completely or the partition is empty
+ */
+static void migrateFromSpiffs() {
+  bool migrated = false;
+
+  if( spiffsMount() ) {
+    bool loaded = loadBakesFromFiles( false );  // SPIFFS is formatted, steps can't stay there
+#ifdef CONF_FLASH_BENCHMARK
+    flashBench_t spiffs;
+    if( loaded && flashBenchmark( "SPIFFS", &spiffs ) ) {
+      flashBenchmarkStore( &spiffs );
+    }
+#endif
+    spiffsUnmount();
+
+    if( !loaded ) {
+      HAL_printf( "CONF(migrateFromSpiffs): SPIFFS data can't be read completely, partition not formatted (bake list kept in RAM only)\n" );
+      return;
+    }
+    migrated = true;
+  } else if( !flashErased() ) {
+    HAL_printf( "CONF(migrateFromSpiffs): Partition holds unknown data, not formatted (bake list kept in RAM only)\n" );
+    return;
+  }
+
+  HAL_printf( "Formatting partition as LittleFS...\n" );
+  if( !flashMount( true ) ) {
+    HAL_printf( "CONF(migrateFromSpiffs): LittleFS format failed, bake list kept in RAM only\n" );
+    return;
+  }
+
+  if( migrated ) {
+    // the list exists in RAM only from now on, write it synchronously (journal, if any, is already applied)
+    snapshotPending = true;
+    journalSize = sizeof( journalHeader_t );
+    if( persistBakeList( NULL ) ) {
+      HAL_printf( "Bake list migrated from SPIFFS\n" );
+    } else {
+      HAL_printf( "CONF(migrateFromSpiffs): Bake list write failed, retried by persistence worker\n" );
+      PERSIST_Submit( persistBakeList, NULL, NULL );
+    }
+  }
+}
+#endif
+
+static void loadBakesFromFlash() {
+  HAL_printf( "Loading bakes from file (flash)...\n" );
+
+  if( flashMount( false ) ) {
+    loadBakesFromFiles( LAZY_STEPS );
+  } else {
+#ifdef ARDUINO
+    migrateFromSpiffs();
+#else
+    HAL_printf( "CONF(loadBakesFromFlash): Flash directory can't be created, bake list kept in RAM only\n" );
+#endif
+  }
+
+#ifdef CONF_FLASH_BENCHMARK
+  if( flashMounted ) {
+    flashBenchmarkCompare();
+  }
+#endif
+
+  HAL_printf( "Bakes: %u, arena: %u/%u bytes, index: %u bytes\n", bakesCount, arenaUsed, arenaSize, (uint32_t)( indexSize * sizeof( uint32_t ) ) );
+}
+
+/**
+ * Options stored by older firmware: EEPROM.readBool( option ) with option as address
+ */
+static bool loadLegacyOptions() {
+#ifdef ARDUINO
+  if( !EEPROM.begin( EEPROM_SIZE ) ) {
+    return false;
+  }
+
+  for( int x=0; x<CONF_OPT_COUNT; x++ ) {
+    optionValue[x] = EEPROM.readBool( x ) ? 1 : 0;
+  }
+  EEPROM.end();
+
+  return true;
+#else
+  return false;   // host never ran older firmware
+#endif
+}
+
+static void loadOptions() {
+  int32_t version = 0;
+  bool loaded = false;
+
+  for( int x=0; x<CONF_OPT_COUNT; x++ ) {
+    optionValue[x] = optionSchema[x].defaultValue;
+  }
+
+  if( HAL_nvsGetInt( OPTIONS_NAMESPACE, "ver", &version ) && OPTIONS_VERSION == version ) {
+    for( int x=0; x<CONF_OPT_COUNT; x++ ) {
+      HAL_nvsGetInt( OPTIONS_NAMESPACE, optionSchema[x].key, &optionValue[x] );   // missing key keeps default
+    }
+    loaded = true;
+  }
+
+  if( !loaded ) {
+    HAL_printf( "Options: no valid set in NVS, %s\n", loadLegacyOptions() ? "EEPROM values taken" : "defaults taken" );
+    optionsDirty = true;
+    optionsCommitLater();
+  }
+}
+
+/**
+ * Write all options to NVS at once (persistence worker)
+ */
+static bool commitOptions( void * arg ) {
+  int32_t values[ CONF_OPT_COUNT ];
+  unsigned long start = HAL_micros();
+  bool written = true;
+
+  HAL_mutexTake( &optionsMutex, HAL_WAIT_FOREVER );
+  memcpy( values, optionValue, sizeof( values ) );
+  optionsDirty = false;
+  HAL_mutexGive( &optionsMutex );
+
+  for( int x=0; x<CONF_OPT_COUNT; x++ ) {
+    written = HAL_nvsSetInt( OPTIONS_NAMESPACE, optionSchema[x].key, values[x] ) && written;   // unchanged options aren't written (flash wear)
+  }
+  written = written && HAL_nvsSetInt( OPTIONS_NAMESPACE, "ver", OPTIONS_VERSION );
+
+  if( !written ) {
+    HAL_printf( "CONF(commitOptions): NVS write failed\n" );
+    HAL_mutexTake( &optionsMutex, HAL_WAIT_FOREVER );
+    optionsDirty = true;    // try again with next commit
+    HAL_mutexGive( &optionsMutex );
+    return false;
+  }
+
+  HAL_printf( "Options committed in %lu[uS]\n", HAL_micros() - start );
+  return true;
+}
+
+#ifdef ARDUINO
+/**
+ * Countdown after last option change elapsed (timer service task), hand the write over to the worker
+ */
+static void optionsTimerCb( TimerHandle_t timer ) {
+  PERSIST_Submit( commitOptions, NULL, NULL );
+}
+#endif
+
+/**
+ * (Re)start countdown, all option changes in that time are committed at once
+ * Host has no timer service, options are committed right away there
+ */
+static void optionsCommitLater() {
+#ifdef ARDUINO
+  xTimerReset( optionsTimer, 0 );
+#else
+  PERSIST_Submit( commitOptions, NULL, NULL );
+#endif
+}
+
+/**
+ * Write everything waiting: options and bake list edits (persistence worker)
+ */
+static bool flushAll( void * arg ) {
+  bool retVal = true;
+  bool dirty;
+
+  HAL_mutexTake( &optionsMutex, HAL_WAIT_FOREVER );
+  dirty = optionsDirty;
+  HAL_mutexGive( &optionsMutex );
+
+  if( dirty ) {
+    retVal = commitOptions( NULL );
+  }
+
+  return persistBakeList( NULL ) && retVal;
+}
+
+static void setOption( confOption_t option, optionValueType_t type, int32_t value ) {
+  if( false == configAvailable || CONF_OPT_COUNT <= option ) {
+    return;
+  }
+
+  if( type != optionSchema[ option ].type ) {
+    HAL_printf( "CONF(setOption): option '%s' has different type\n", optionSchema[ option ].key );
+    return;
+  }
+
+  HAL_mutexTake( &optionsMutex, HAL_WAIT_FOREVER );
+  bool changed = ( optionValue[ option ] != value );
+  optionValue[ option ] = value;
+  optionsDirty = optionsDirty || changed;
+  HAL_mutexGive( &optionsMutex );
+
+  if( changed ) {
+    optionsCommitLater();
+  }
+}
+
+static int32_t getOption( confOption_t option, optionValueType_t type ) {
+  if( CONF_OPT_COUNT <= option ) {
+    return 0;
+  }
+
+  if( type != optionSchema[ option ].type ) {
+    HAL_printf( "CONF(getOption): option '%s' has different type\n", optionSchema[ option ].key );
+    return optionSchema[ option ].defaultValue;
+  }
+
+  return optionValue[ option ];
+}
+
+void CONF_Init( halSpi_t * spi ) {
+  SDCARD_Setup( spi );
+
+  HAL_mutexInit( &confMutex );
+  HAL_mutexInit( &optionsMutex );
+  NIDX_Init( indexName, CONF_getBakeCount );   // index is built on first search
+
+#ifdef ARDUINO
+  optionsTimer = xTimerCreateStatic( "Options", pdMS_TO_TICKS( OPTIONS_COMMIT_DELAY ), pdFALSE, NULL, optionsTimerCb, &optionsTimerBuffer );
+  assert( optionsTimer );
+#endif
+  loadOptions();
+
+  configAvailable = true;
+
+  // setBakeExample();
+  loadBakesFromFlash();
+  // loadBakesFromSDCard();
+}
+
+int CONF_getOptionInt( confOption_t option ) {
+  if( false == configAvailable ) {
+    return -1;
+  }
+
+  return getOption( option, OPT_TYPE_INT );
+}
+
+bool CONF_getOptionBool( confOption_t option ) {
+  if( false == configAvailable ) {
+    return false;
+  }
+
+  return 0 != getOption( option, OPT_TYPE_BOOL );
+}
+
+void CONF_setOptionBool( confOption_t option, bool value ) {
+  setOption( option, OPT_TYPE_BOOL, value ? 1 : 0 );
+}
+
+void CONF_setOptionInt( confOption_t option, int32_t value ) {
+  setOption( option, OPT_TYPE_INT, value );
+}
+
+uint32_t CONF_getBakeCount( void ) {
+  return bakesCount;
+}
+
+uint32_t CONF_getBakeListGeneration( void ) {
+  return listGeneration;
+}
+
+uint32_t CONF_getBakeTemp( uint32_t idx, uint32_t step ) {
+  uint32_t temp = 0;
+
+  confLock();
+  if( bakesCount > idx && getRecord( idx )->stepCount > step ) {
+    const bakeStep_t * steps = getBakeSteps( idx );
+    if( NULL != steps ) {
+      temp = steps[ step ].temp;
+    }
+  }
+  confUnlock();
+
+  return temp;
+}
+
+int32_t CONF_getBakeTime( uint32_t idx, uint32_t step ) {
+  int32_t time = 0;
+
+  confLock();
+  if( bakesCount > idx && getRecord( idx )->stepCount > step ) {
+    const bakeStep_t * steps = getBakeSteps( idx );
+    if( NULL != steps ) {
+      time = steps[ step ].time;
+    }
+  }
+  confUnlock();
+
+  return time;
+}
+
+uint32_t CONF_copyBake( uint32_t idx, char * name, uint32_t nameSize, bakeStep_t steps[], uint32_t max ) {
+  uint32_t count = 0;
+
+  confLock();
+  if( bakesCount > idx ) {
+    bakeRecord_t * rec = getRecord( idx );
+    const bakeStep_t * recSteps = getBakeSteps( idx );
+
+    if( NULL != recSteps ) {
+      count = ( rec->stepCount < max ) ? rec->stepCount : max;
+      memcpy( steps, recSteps, count * sizeof( bakeStep_t ) );
+    }
+    if( NULL != name && 0 < nameSize ) {
+      snprintf( name, nameSize, "%s", getRecordName( rec ) );
+    }
+  }
+  confUnlock();
+
+  return count;
+}
+
+uint32_t CONF_getBakeStepCount( uint32_t idx ) {
+  uint32_t count = 0;
+
+  confLock();
+  if( bakesCount > idx ) {
+    count = getRecord( idx )->stepCount;
+  }
+  confUnlock();
+
+  return count;
+}
+
+bool CONF_getBakeName( uint32_t idx, char * name, uint32_t size ) {
+  bool retVal = false;
+
+  if( NULL == name || 0 == size ) {
+    return false;
+  }
+
+  confLock();
+  if( bakesCount > idx ) {
+    snprintf( name, size, "%s", getRecordName( getRecord( idx ) ) );
+    retVal = true;
+  }
+  confUnlock();
+
+  return retVal;
+}
+
+bool CONF_removeBakes( const uint16_t list[], uint32_t count ) {
+  if( NULL == list || 0 == count ) {
+    return false;
+  }
+
+  confLock();
+  bool retVal = removeBakes( list, count );
+  if( retVal ) {
+    journalAppend( JOURNAL_OP_REMOVE, (const uint8_t *)list, count * sizeof( uint16_t ) );
+  }
+  confUnlock();
+
+  return retVal;
+}
+
+bool CONF_swapBakes( uint32_t first, uint32_t second ) {
+  uint16_t idx[2] = { (uint16_t)first, (uint16_t)second };
+
+  if( bakesCount <= first || bakesCount <= second ) {
+    return false;
+  }
+
+  confLock();
+  swapBakes( idx[0], idx[1] );
+  journalAppend( JOURNAL_OP_SWAP, (const uint8_t *)idx, sizeof( idx ) );
+  confUnlock();
+
+  return true;
+}
+
+bool CONF_moveBake( uint32_t from, uint32_t to ) {
+  uint16_t idx[2] = { (uint16_t)from, (uint16_t)to };
+
+  if( bakesCount <= from || bakesCount <= to ) {
+    return false;
+  }
+
+  if( from != to ) {
+    confLock();
+    moveBake( idx[0], idx[1] );
+    journalAppend( JOURNAL_OP_MOVE, (const uint8_t *)idx, sizeof( idx ) );
+    confUnlock();
+  }
+  return true;
+}
+
+bool CONF_reorderBakes( const uint16_t order[], uint32_t count ) {
+  if( NULL == order ) {
+    return false;
+  }
+
+  confLock();
+  bool retVal = reorderBakes( order, count );
+  if( retVal ) {
+    journalAppend( JOURNAL_OP_REORDER, (const uint8_t *)order, count * sizeof( uint16_t ) );
+  }
+  confUnlock();
+
+  return retVal;
+}
+
+uint32_t CONF_findBakes( const char * query, uint16_t results[], uint32_t max ) {
+  uint32_t found;
+
+  confLock();
+  found = NIDX_Find( query, results, max );
+  confUnlock();
+
+  return found;
+}
+
+void CONF_addBakesFromFile( void ) {
+  if( SDCARD_isAvailable() ) {   // card stays mounted, no need to reinitialize it for every import
+    confLock();
+    loadBakesFromSDCard();
+    confUnlock();
+  } else {
+    HAL_printf( "CONF(addBakesFromFile): No SDCard\n" );
+  }
+}
+
+/**
+ * Write bake list copy as new snapshot file (persistence worker)
+ * path                 - file to write (BAKE_SNAPSHOT_TMP, renamed by commitSnapshot())
+ * arena, index, count  - copy of the bake list taken under confMutex
+ * generation           - generation of new snapshot
+ */
+static bool writeSnapshot( const char * path, const uint8_t * arena, const uint32_t * index, uint32_t count, uint32_t generation, uint32_t refs[] ) {
+  FILE * src = NULL;              // current snapshot (source of steps not kept in RAM)
+  bakeStep_t * storedSteps = NULL;
+  bool retVal = true;
+
+  if( !flashMounted ) {
+    return false;
+  }
+
+  unsigned long start = HAL_micros();
+
+  // old snapshot stays untouched until the new one is completely written
+  FILE * f = fopen( path, "w" );
+  if ( NULL == f ) {
+    HAL_printf( "CONF(writeSnapshot): Failed to open file for writing\n" );
+    return false;
+  }
+
+  FileWriter writer( f );
+  JsonDocument doc;   // holds only one bake at a time
+  char header[ 48 ];
+
+  snprintf( header, sizeof(header), "{\"count\":%u,\"gen\":%u,\"data\":[", count, generation );
+  writer.write( header );
+
+  for( int x=0; x<count && retVal; x++ ) {
+    bakeRecord_t * rec = (bakeRecord_t *)( arena + index[x] );
+    bakeStep_t * steps = getRecordSteps( rec );
+
+    if( rec->flags & RECORD_STORED ) {
+      if( NULL == src ) {
+        src = fopen( BAKE_SNAPSHOT_PATH, "r" );
+        storedSteps = (bakeStep_t *)malloc( BAKE_MAX_STEPS * sizeof( bakeStep_t ) );
+      }
+      retVal = ( NULL != src && NULL != storedSteps && readStoredSteps( src, *getRecordRef( rec ), storedSteps, rec->stepCount ) );
+      steps = storedSteps;
+    }
+
+    doc.clear();
+    doc["name"] = (const char *)getRecordName( rec );
+    doc["stepCount"] = rec->stepCount;
+    for( int y=0; y<rec->stepCount; y++ ) {
+      doc["step"][y]["temp"] = steps[y].temp;
+      doc["step"][y]["time"] = steps[y].time;
+    }
+
+    if( 0 < x ) {
+      writer.write( "," );
+    }
+    if( NULL != refs ) {
+      refs[x] = writer.written();
+    }
+    serializeJson( doc, writer );
+  }
+  writer.write( "]}" );
+  writer.flush();
+  fclose( f );
+  if( NULL != src ) {
+    fclose( src );
+  }
+  free( storedSteps );
+
+  if( !retVal || writer.error() ) {
+    HAL_printf( "CONF(writeSnapshot): %s failed\n", retVal ? "Write" : "Steps read" );
+    remove( path );
+    return false;
+  }
+
+  HAL_printf( "Bake list written: %u bytes in %lu[uS]\n", writer.written(), HAL_micros() - start );
+  return true;
+}
+
+/**
+ * Replace snapshot with the new one (caller holds confMutex)
+ * Bakes which were written to it refer to it from now on (lazy steps)
+ * index    - arena offsets of written bakes (arena is not compacted during the write)
+ * refs     - offsets of written bakes in the new snapshot (NULL: steps stay in RAM)
+ * count    - number of written bakes
+ */
+static bool commitSnapshot( const uint32_t * index, const uint32_t * refs, uint32_t count ) {
+  // LittleFS rename replaces destination atomically: either old or new snapshot survives power loss
+  if( 0 != rename( BAKE_SNAPSHOT_TMP, BAKE_SNAPSHOT_PATH ) ) {
+    HAL_printf( "CONF(commitSnapshot): Rename failed\n" );
+    remove( BAKE_SNAPSHOT_TMP );
+    return false;
+  }
+
+  if( NULL != refs ) {
+    stepCacheClear();   // cached by old offsets
+
+    for( int x=0; x<count; x++ ) {
+      bakeRecord_t * rec = (bakeRecord_t *)( bakeArena + index[x] );
+
+      if( ( rec->flags & RECORD_REMOVED ) || 0 == rec->stepCount ) {
+        continue;
+      }
+      if( 0 == ( rec->flags & RECORD_STORED ) ) {
+        // steps are dropped from RAM, the record keeps its size until compaction
+        arenaGarbage += recordBytes( rec );
+        rec->flags |= RECORD_STORED;
+        arenaGarbage -= recordBytes( rec );
+      }
+      *getRecordRef( rec ) = refs[x];
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Bring flash up to date with bake list in RAM (persistence worker)
+ * List is locked only for copying, files are written without holding confMutex
+ */
+static bool persistBakeList( void * arg ) {
+  bool retVal = true;
+
+  confLock();
+
+#ifdef BENCH_ENABLE
+  if( benchActive ) {
+    confUnlock();
+    return true;    // work stays pending, CONF_benchEnd() submits it again
+  }
+#endif
+
+  if( snapshotPending ) {
+    uint8_t * arenaCopy = (uint8_t *)malloc( arenaUsed + 1 );
+    uint32_t * indexCopy = (uint32_t *)malloc( bakesCount * sizeof( uint32_t ) + 1 );
+    uint32_t * refs = LAZY_STEPS ? (uint32_t *)malloc( bakesCount * sizeof( uint32_t ) + 1 ) : NULL;
+    uint32_t count = bakesCount;
+
+    if( NULL == arenaCopy || NULL == indexCopy || ( LAZY_STEPS && NULL == refs ) ) {
+      HAL_printf( "CONF(persistBakeList): Malloc failed for list copy\n" );
+      free( arenaCopy );
+      free( indexCopy );
+      free( refs );
+      confUnlock();
+      return false;   // snapshot stays pending, next edit retries
+    }
+
+    memcpy( arenaCopy, bakeArena, arenaUsed );
+    memcpy( indexCopy, bakeIndex, count * sizeof( uint32_t ) );
+    snapshotPending = false;
+    snapshotWriting = true;
+    pendingLen = 0;   // already in the copy
+    confUnlock();
+
+    retVal = writeSnapshot( BAKE_SNAPSHOT_TMP, arenaCopy, indexCopy, count, snapshotGeneration + 1, refs );
+    free( arenaCopy );
+
+    confLock();
+    if( retVal ) {
+      // renamed under the lock, steps are never read from the old snapshot by new offsets
+      retVal = commitSnapshot( indexCopy, refs, count );
+    }
+    snapshotWriting = false;
+    free( indexCopy );
+    free( refs );
+
+    if( retVal ) {
+      // journal of previous generation becomes outdated from now on
+      snapshotGeneration++;
+      journalReset();
+    } else {
+      snapshotPending = true;
+    }
+  }
+
+  if( !snapshotPending && 0 < pendingLen ) {
+    // take filled buffer, edits made during the write go to the other one
+    const uint8_t * data = journalPending[ pendingIdx ];
+    uint32_t len = pendingLen;
+
+    pendingIdx ^= 1;
+    pendingLen = 0;
+    confUnlock();
+
+    retVal = journalWrite( data, len );
+
+    confLock();
+    if( !retVal ) {
+      // records are lost for the journal, only full snapshot keeps flash consistent now
+      snapshotPending = true;
+      pendingLen = 0;
+      journalSize = sizeof( journalHeader_t );
+    }
+  }
+
+  confUnlock();
+  return retVal;
+}
+
+void CONF_storeBakeList() {
+  confLock();
+  snapshotPending = true;
+  pendingLen = 0;
+  journalSize = sizeof( journalHeader_t );
+  confUnlock();
+
+  PERSIST_Submit( persistBakeList, NULL, NULL );
+}
+
+void CONF_flush( persistDoneCb done ) {
+#ifdef ARDUINO
+  xTimerStop( optionsTimer, 0 );    // options are written now, no need to wait for countdown
+#endif
+  PERSIST_Submit( flushAll, NULL, done );
+}
+
+#ifdef BENCH_ENABLE
+static void benchSwap( bakeList_t * list ) {
+  bakeList_t tmp = { bakeArena, arenaSize, arenaUsed, arenaGarbage, bakeIndex, indexSize, bakesCount };
+
+  bakeArena = list->arena;
+  arenaSize = list->arenaSize;
+  arenaUsed = list->arenaUsed;
+  arenaGarbage = list->arenaGarbage;
+  bakeIndex = list->index;
+  indexSize = list->indexSize;
+  bakesCount = list->count;
+  *list = tmp;
+
+  NIDX_Invalidate();
+  listGeneration++;
+}
+
+bool CONF_benchStore( void ) {
+  bool retVal;
+
+  confLock();
+  retVal = writeSnapshot( BAKE_BENCH_PATH, bakeArena, bakeIndex, bakesCount, snapshotGeneration, NULL );
+  confUnlock();
+
+  return retVal;
+}
+
+bool CONF_benchBegin( void ) {
+  bool retVal = false;
+
+  confLock();
+  if( !benchActive && !snapshotWriting ) {    // written snapshot is committed to the list which is in RAM
+    memset( &benchSaved, 0, sizeof( benchSaved ) );
+    benchSwap( &benchSaved );
+    benchActive = true;
+    retVal = true;
+  }
+  confUnlock();
+
+  return retVal;
+}
+
+bool CONF_benchLoad( void ) {
+  bool retVal = false;
+
+  if( !benchActive ) {
+    return false;
+  }
+
+  confLock();
+  arenaUsed = 0;
+  arenaGarbage = 0;
+  bakesCount = 0;
+  NIDX_Invalidate();
+  listGeneration++;
+
+  uint32_t generation = snapshotGeneration;   // parser takes it from the file
+  FILE * f = fopen( BAKE_BENCH_PATH, "r" );
+  if( NULL != f ) {
+    retVal = parseSnapshot( f, false );
+    fclose( f );
+  }
+  snapshotGeneration = generation;
+  confUnlock();
+
+  return retVal;
+}
+
+void CONF_benchEnd( void ) {
+  bool pending;
+
+  confLock();
+  if( !benchActive ) {
+    confUnlock();
+    return;
+  }
+  free( bakeArena );
+  free( bakeIndex );
+  benchSwap( &benchSaved );
+  benchActive = false;
+  pending = snapshotPending || 0 < pendingLen;
+  confUnlock();
+
+  remove( BAKE_BENCH_PATH );
+  if( pending ) {
+    PERSIST_Submit( persistBakeList, NULL, NULL );
+  }
 }
+#endif
@@ -0,0 +1,714 @@
+#include <assert.h>
+#include <string.h>
+#include "controller.h"
+#include "hal.h"
+#include "heater.h"
+#include "buzzer.h"
+#include "config.h"
+#include "recorder.h"
+#include "recipe.h"
+#include "logger.h"
+
+// bake state is owned by the controller task, other tasks pass requests as commands
+static heater_state heaterState = STATE_IDLE;
+static heater_state heaterStateRequested = STATE_IDLE;
+static event_state specialEventState = EVENT_STATE_IDLE;
+static uint32_t eventHandlingStart;
+static uint32_t targetHeatingTime;    // in miliseconds
+static uint16_t targetHeatingTemp;
+static int32_t specialEventCode;
+static uint32_t eventBuzzing;
+static uint32_t bakeIdx;
+static heater_state reportedState = STATE_IDLE;  // last state sent as state change event
+static recipe_t recipe;               // selected bake compiled into timeline (recipe.current - running step)
+static char bakeName[ BAKE_NAME_LENGTH ];         // bake being compiled
+static bakeStep_t bakeSteps[ BAKE_MAX_STEPS ];    // its steps (too big for the stack)
+static bool manualOperation = true;
+static bool specialEvent = false;
+// what the screen shows, rendered by the GUI owner from the published status
+static buttonsGroup_t buttons = BUTTONS_START;
+static bool changeAllowed = true;
+static bool blinkFrame = false;
+static bool blinkTime = false;
+static uint32_t targetUpdates = 0;
+static uint32_t mainTabRequests = 0;
+static ctrlStatus_t status;               // published copy of controller state, see CTRL_getStatus()
+static uint32_t statusSequence = 0;       // odd while status is being written
+static ctrlEventCb eventCallback = NULL;
+static ctrlEvent_t queue[ CONTROLLER_QUEUE_LENGTH ];   // ring buffer of commands, guarded by queueMutex
+static uint32_t queueHead = 0;            // next command to handle
+static uint32_t queueCount = 0;
+static uint32_t queueWaits = 0;           // commands waiting for free slot, debug purpose only
+static halMutex_t queueMutex;
+static halTask_t task;
+static halStack_t taskStack[ CONTROLLER_STACK_SIZE ];
+static bool initialized = false;
+
+static void viewSet( buttonsGroup_t operationButtons, bool timeTempChangeAllowed, bool screenFrameBlinking, bool timeCurrentBlinking ) {
+  buttons = operationButtons;
+  changeAllowed = timeTempChangeAllowed;
+  blinkFrame = screenFrameBlinking;
+  blinkTime = timeCurrentBlinking;
+}
+
+// targets are shown again even when they are the same (user could type a value which was limited)
+static void targetsShow() {
+  targetUpdates++;
+}
+
+static void eventReport( const char * name, int32_t value ) {
+  if( NULL != eventCallback ) {
+    eventCallback( name, value );
+  }
+}
+
+// controller task only (single writer)
+static void statusPublish() {
+  uint32_t sequence = statusSequence;
+
+  __atomic_store_n( &statusSequence, sequence + 1, __ATOMIC_RELAXED );
+  __atomic_thread_fence( __ATOMIC_RELEASE );
+  status.state = heaterState;
+  status.targetTemp = targetHeatingTemp;
+  status.targetTime = targetHeatingTime;
+  status.manual = manualOperation;
+  status.bakeIdx = bakeIdx;
+  memcpy( status.bakeName, recipe.name, sizeof( status.bakeName ) );
+  status.step = recipe.current;
+  status.steps = recipe.count;
+  status.totalTime = recipe.totalTime;
+  const recipeSegment_t * segment = RECIPE_Current( &recipe );
+  status.event = ( NULL != segment ) ? segment->event : 0;
+  status.remainingAfter = ( NULL != segment ) ? segment->remainingAfter : 0;
+  status.segmentTimed = ( NULL != segment && 0 < segment->time );   // segments waiting for user count as 0
+  status.targetUpdates = targetUpdates;
+  status.buttons = buttons;
+  status.changeAllowed = changeAllowed;
+  status.blinkFrame = blinkFrame;
+  status.blinkTime = blinkTime;
+  status.mainTabRequests = mainTabRequests;
+  __atomic_store_n( &statusSequence, sequence + 2, __ATOMIC_RELEASE );
+}
+
+static void updateTimeHandle( uint32_t time ) {
+  targetHeatingTime = time;
+  manualOperation = true;
+
+  if( MAX_ALLOWED_TIME < targetHeatingTime ) {
+    targetHeatingTime = MAX_ALLOWED_TIME;
+  }
+
+  targetsShow();
+}
+
+static void updateTempHandle( uint16_t temp ) {
+  targetHeatingTemp = temp;
+  manualOperation = true;
+
+  if( MAX_ALLOWED_TEMP < targetHeatingTemp ) {
+    targetHeatingTemp = MAX_ALLOWED_TEMP;
+  }
+  if( MIN_ALLOWED_TEMP > targetHeatingTemp ) {
+    targetHeatingTemp = MIN_ALLOWED_TEMP;
+  }
+
+  targetsShow();
+}
+
+// set targets from the running segment of compiled bake
+static void segmentLoad( const recipeSegment_t * segment ) {
+  specialEvent = ( 0 != segment->event );
+  specialEventCode = segment->event;
+  targetHeatingTemp = specialEvent ? 0 : segment->temp;
+  targetHeatingTime = specialEvent ? 0 : segment->time;
+}
+
+static void bakeShow( bool longPress ) {
+  segmentLoad( RECIPE_Current( &recipe ) );
+
+  targetsShow();
+
+  if( longPress ) {
+    heaterStateRequested = STATE_START_REQUESTED;
+  }
+
+  mainTabRequests++;
+}
+
+static void bakePickupHandle( uint32_t idx, bool longPress ) {
+  if( STATE_IDLE == heaterState ) {
+    manualOperation = false;
+
+    targetHeatingTime = 0;
+    specialEvent = false;
+    specialEventCode = 0;
+
+    uint32_t count = CONF_copyBake( idx, bakeName, sizeof( bakeName ), bakeSteps, BAKE_MAX_STEPS );
+
+    if( !RECIPE_Compile( bakeName, bakeSteps, count, &recipe ) ) {   // steps are read and checked once here
+      targetHeatingTemp = 0;
+      HAL_printf( "CONTROLLER(bakePickup): Bake item incorrect!\n" );
+      BUZZ_Add( 0, 80, 100, 10 );
+      targetsShow();
+      return;
+    }
+    bakeIdx = idx;
+
+    HAL_printf( "Bake pickup[%d]:\"%s\"; Steps:%d; Total time:%u[s]\n", bakeIdx + 1, recipe.name, recipe.count, recipe.totalTime / 1000 );
+    bakeShow( longPress );
+  } else {
+    BUZZ_Add( 0, 80, 100, 3 );
+    mainTabRequests++;
+  }
+}
+
+// prepare the same bake for next round (compiled timeline is kept even when the list was changed meanwhile)
+static void bakeRestart() {
+  RECIPE_Rewind( &recipe );
+  bakeShow( false );
+}
+
+static void adjustTimeHandle( int32_t time ) {
+  int32_t newTime = targetHeatingTime + MINUTE_TO_MILLIS( time );
+  HAL_printf( "Adjust Time: %d[min]\n", time );
+
+  if( 0 < newTime && MAX_ALLOWED_TIME > newTime ) {
+    targetHeatingTime = newTime;
+    targetsShow();
+
+    if( STATE_HEATING == heaterState
+    || STATE_HEATING_PAUSE == heaterState ) {
+      HEATER_setTime( targetHeatingTime );
+    }
+  }
+}
+
+static void heatingDoneHandle() {
+  const recipeSegment_t * segment = NULL;   // force end of heating in manual operation
+
+  if( !manualOperation ) {
+    segment = RECIPE_Next( &recipe );      // handle next step in bake curve (if exist)
+    HAL_printf( "Handling next step %u/%u\n", recipe.current + 1, recipe.count );
+  }
+  specialEvent = false;
+  specialEventCode = 0;
+
+  if( NULL == segment ) {  // no next step, finish heating process
+    BUZZ_Add( 0, 1000, 200, 5 );
+    HAL_printf( "Heating done!\n" );
+    heaterStateRequested = STATE_STOP_REQUESTED;
+  } else {
+    segmentLoad( segment );
+    if( !specialEvent ) {   // there is next step, handle it (event is started by state machine)
+      heaterStateRequested = STATE_NEXTSTEP_REQUESTED;
+    }
+  }
+}
+
+// bake state machine, called after each event until the state settles
+// now      - HAL_millis() when the event handling started
+static void controllerStep( uint32_t now ) {
+  switch( heaterState ) {
+    case STATE_IDLE: {
+      // check against started heating
+      if( STATE_START_REQUESTED == heaterStateRequested ) { // in STATE_IDLE only STATE_START_REQUESTED allowed
+        // HAL_printf("START: specialEvent=%d, specialEventCode=%d\n", (int)specialEvent, specialEventCode );
+        REC_Start( manualOperation ? "Manual operation" : recipe.name );
+        eventReport( "bake", manualOperation ? 0 : bakeIdx + 1 );   // 0 - manual operation
+        if( specialEvent ) {      // special case: first step is an event
+          specialEvent = false;
+          REC_Event( REC_EVENT_SPECIAL );
+          specialEventState = EVENT_STATE_BEGIN;
+          heaterState = STATE_SPECIAL_EVENT;
+          eventHandlingStart = now;
+        }
+        else {
+          if( MAX_ALLOWED_TIME < targetHeatingTime ) {
+            targetHeatingTime = MAX_ALLOWED_TIME;
+          }
+          if( MAX_ALLOWED_TEMP < targetHeatingTemp ) {
+            targetHeatingTemp = MAX_ALLOWED_TEMP;
+          }
+          if( MIN_ALLOWED_TEMP > targetHeatingTemp ) {
+            targetHeatingTemp = MIN_ALLOWED_TEMP;
+          }
+
+          targetsShow();
+
+          HEATER_setTime( targetHeatingTime );
+          HEATER_setTemperature( (uint16_t)targetHeatingTemp );
+          HEATER_start();
+
+          BUZZ_Add( 400 );
+          heaterState = STATE_HEATING;
+        }
+
+        // hide "Start" button, show "Pause" and "Stop" buttons
+        viewSet( BUTTONS_PAUSE_STOP, false, true, false );
+
+        heaterStateRequested = STATE_IDLE;
+      }
+      break;
+    }
+    case STATE_HEATING: {
+      if( STATE_STOP_REQUESTED == heaterStateRequested ) {
+        HEATER_stop();
+        viewSet( BUTTONS_START, true, false, false );
+
+        heaterStateRequested = STATE_IDLE;
+        heaterState = STATE_IDLE;
+        REC_Stop();
+        if( false == manualOperation ) {
+          bakeRestart();   // prepare for next round
+        }
+      }
+      else if( STATE_NEXTSTEP_REQUESTED == heaterStateRequested ) {
+        if( MAX_ALLOWED_TIME < targetHeatingTime ) {
+          targetHeatingTime = MAX_ALLOWED_TIME;
+        }
+        if( MAX_ALLOWED_TEMP < targetHeatingTemp ) {
+          targetHeatingTemp = MAX_ALLOWED_TEMP;
+        }
+        if( MIN_ALLOWED_TEMP > targetHeatingTemp ) {
+          targetHeatingTemp = MIN_ALLOWED_TEMP;
+        }
+
+        targetsShow();
+
+        HEATER_setTime( targetHeatingTime );
+        HEATER_setTemperature( (uint16_t)targetHeatingTemp );
+        HEATER_start();
+        REC_Event( REC_EVENT_STEP );
+
+        heaterStateRequested = STATE_IDLE;
+      }
+      else if( STATE_PAUSE_REQUESTED == heaterStateRequested ) {
+        HEATER_pause();
+        viewSet( BUTTONS_CONTINUE_STOP, false, false, true );   // blinking current time indicates PAUSE
+
+        heaterStateRequested = STATE_IDLE;
+        heaterState = STATE_HEATING_PAUSE;
+      }
+      else if( specialEvent ) {
+        specialEvent = false;
+        REC_Event( REC_EVENT_SPECIAL );
+        specialEventState = EVENT_STATE_BEGIN;
+        heaterState = STATE_SPECIAL_EVENT;
+        eventHandlingStart = now;
+      }
+      break;
+    }
+    case STATE_HEATING_PAUSE: {
+      static bool buzzerActive = false;
+      if( !buzzerActive ) {
+        BUZZ_Delete( eventBuzzing );  // just in case it exist
+        eventBuzzing = BUZZ_Add( BUZZ_EVENT_PAUSE );
+        buzzerActive = true;
+      }
+
+      if( STATE_STOP_REQUESTED == heaterStateRequested ) {
+        HEATER_stop();
+        viewSet( BUTTONS_START, true, false, false );   // stop blinking (stop heating)
+
+        buzzerActive = false;
+        BUZZ_Delete( eventBuzzing );
+        heaterStateRequested = STATE_IDLE;
+        heaterState = STATE_IDLE;
+        REC_Stop();
+        if( false == manualOperation ) {
+          bakeRestart();   // prepare for next round
+        }
+      }
+      else if( STATE_PAUSE_REQUESTED == heaterStateRequested ) {
+        HEATER_pause(); // continue processing (same API function for 'unpause')
+        viewSet( BUTTONS_PAUSE_STOP, false, true, false );    // stop blinking (continue heating)
+
+        buzzerActive = false;
+        BUZZ_Delete( eventBuzzing );
+        heaterStateRequested = STATE_IDLE;
+        heaterState = STATE_HEATING;
+      }
+      break;
+    }
+    case STATE_SPECIAL_EVENT: {
+      switch( specialEventCode ) {
+        case EVENT_PREHEATING: {
+          static bool targetTempReached;
+
+          switch( specialEventState ) {
+            case EVENT_STATE_BEGIN: {
+              HAL_printf( "Handle EVENT_PREHEATING...\n" );
+
+              targetHeatingTemp = RECIPE_Current( &recipe )->temp;   // limited when compiled
+
+              targetsShow();
+
+              HEATER_setTime( RECIPE_Current( &recipe )->deadline );   // EVENT_PREHEATING_MAX_TIME
+              HEATER_setTemperature( (uint16_t)targetHeatingTemp );
+              HEATER_start();
+
+              viewSet( BUTTONS_STOP, false, true, true );   // blinking time: indicate we're in preheating mode
+
+              targetTempReached = false;
+              eventBuzzing = BUZZ_Add( BUZZ_EVENT_PREHEATING );
+              specialEventState = EVENT_STATE_HANDLING;
+
+              break;
+            }
+            case EVENT_STATE_HANDLING: {
+              if( STATE_STOP_REQUESTED == heaterStateRequested ) {
+                HAL_printf( "...and go to STOP immediately\n" );
+                BUZZ_Delete( eventBuzzing );
+                heaterState = STATE_HEATING;    // preheating will be stopped in next cycle
+                specialEventState = EVENT_STATE_IDLE;
+              }
+              else if( STATE_PAUSE_REQUESTED == heaterStateRequested ) {  // CONTINUE was pressed
+                specialEventState = EVENT_STATE_END;
+              }
+
+              // target temp reached
+              if( !targetTempReached && HEATER_getCurrentTemperature() >= targetHeatingTemp ) {
+                HAL_printf( "Target temp reached.\n" );
+                targetTempReached = true;
+
+                buttons = BUTTONS_CONTINUE_STOP;
+                BUZZ_Delete( eventBuzzing );
+                eventBuzzing = BUZZ_Add( BUZZ_EVENT_TEMP_REACHED );
+              }
+
+              break;
+            }
+            case EVENT_STATE_END: {
+              HAL_printf( "...go to PAUSE event and wait for user action\n" );
+              buttons = BUTTONS_PAUSE_STOP;
+              BUZZ_Delete( eventBuzzing );
+              HEATER_stop();
+
+              heaterStateRequested = STATE_IDLE;
+              heaterState = STATE_HEATING;
+              specialEventState = EVENT_STATE_IDLE;
+              heatingDoneHandle();        // go to next step
+
+              break;
+            }
+          }
+          break;
+        }
+        case EVENT_PAUSE: {
+          switch( specialEventState ) {
+            case EVENT_STATE_BEGIN: {
+              HAL_printf( "Handle EVENT_PAUSE...\n" );
+
+              targetHeatingTemp = RECIPE_Current( &recipe )->temp;   // limited when compiled
+
+              targetsShow();
+
+              HEATER_setTime( RECIPE_Current( &recipe )->deadline );   // EVENT_PAUSE_MAX_TIME
+              HEATER_setTemperature( (uint16_t)targetHeatingTemp );
+              HEATER_start();
+
+              viewSet( BUTTONS_CONTINUE_STOP, false, true, true );   // blinking time: indicate we're in pause mode
+
+              eventBuzzing = BUZZ_Add( BUZZ_EVENT_PAUSE );
+              specialEventState = EVENT_STATE_HANDLING;
+
+              break;
+            }
+            case EVENT_STATE_HANDLING: {
+              if( STATE_PAUSE_REQUESTED == heaterStateRequested ) {
+                specialEventState = EVENT_STATE_END;
+              }
+              else if( STATE_STOP_REQUESTED == heaterStateRequested ) {
+                HAL_printf( "...and go to STOP immediately\n" );
+                BUZZ_Delete( eventBuzzing );
+                heaterState = STATE_HEATING;
+                specialEventState = EVENT_STATE_IDLE;
+              }
+
+              break;
+            }
+            case EVENT_STATE_END: {
+              HAL_printf( "...and go to next step\n" );
+              BUZZ_Delete( eventBuzzing );
+              HEATER_stop();
+
+              viewSet( BUTTONS_PAUSE_STOP, false, true, false );
+
+              heaterStateRequested = STATE_IDLE;
+              heaterState = STATE_HEATING;
+              specialEventState = EVENT_STATE_IDLE;
+              heatingDoneHandle();        // go to next step
+
+              break;
+            }
+          }
+          break;
+        }
+        case EVENT_SOUND: {
+          HAL_printf( "Handle EVENT_SOUND and go to next step\n" );
+          BUZZ_Add( BUZZ_EVENT_SOUND );
+          heaterState = STATE_HEATING;
+          heatingDoneHandle();
+          break;
+        }
+        case EVENT_END: {
+          switch( specialEventState ) {
+            case EVENT_STATE_BEGIN: {
+              HAL_printf( "Handle EVENT_END...\n" );
+
+              buttons = BUTTONS_STOP;
+              HEATER_stop();
+              eventBuzzing = BUZZ_Add( BUZZ_EVENT_END );
+              eventHandlingStart = now;
+              specialEventState = EVENT_STATE_HANDLING;
+
+              break;
+            }
+            case EVENT_STATE_HANDLING: {
+              // 1 minute passed, activate new buzzing
+              if( (eventHandlingStart + BUZZ_EVENT_END_PERIOD) < now ) {
+                eventBuzzing = BUZZ_Add( BUZZ_EVENT_END );
+                eventHandlingStart += BUZZ_EVENT_END_PERIOD;
+
+                if( BUZZ_EVENT_END_PERIOD > eventHandlingStart ) {    // just in case of time overflow (after ca. 50 days)
+                  heaterStateRequested = STATE_STOP_REQUESTED;
+                }
+              }
+
+              if( STATE_STOP_REQUESTED == heaterStateRequested ) {
+                specialEventState = EVENT_STATE_END;
+              }
+
+              break;
+            }
+            case EVENT_STATE_END: {
+              HAL_printf( "...and go to STATE_IDLE\n" );
+              BUZZ_Delete( eventBuzzing );
+
+              viewSet( BUTTONS_START, true, false, false );
+
+              heaterStateRequested = STATE_IDLE;
+              heaterState = STATE_IDLE;
+              specialEventState = EVENT_STATE_IDLE;
+              REC_Stop();
+              bakeRestart();   // prepare for next round
+
+              break;
+            }
+          }
+          break;
+        }
+        case EVENT_TIMER: {
+          HAL_printf( "Handle EVENT_TIMER...\n" );
+
+          targetHeatingTime = RECIPE_Current( &recipe )->time;   // limited when compiled
+
+          targetsShow();
+
+          HEATER_setTime( targetHeatingTime );
+          HEATER_setTemperature( 0 );
+          HEATER_start();
+
+          viewSet( BUTTONS_PAUSE_STOP, false, true, false );
+
+          heaterState = STATE_HEATING;
+          heaterStateRequested = STATE_IDLE;
+
+          break;
+        }
+        default: {
+          HAL_printf( "Invalid event code: %d\n", specialEventCode );
+          BUZZ_Add( 5000 );
+          break;
+        }
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+
+  if( reportedState != heaterState ) {
+    eventReport( "state", heaterState );
+    reportedState = heaterState;
+  }
+}
+
+// heater reported time is up
+static void heatingTimeUp() {
+  // special case: time's up for EVENT_PAUSE/EVENT_PREHEATING >> go to stop process
+  if( STATE_SPECIAL_EVENT == heaterState
+  && ( EVENT_PREHEATING == specialEventCode || EVENT_PAUSE == specialEventCode ) ) {
+    HAL_printf( "Time's up for PAUSE/PREHEATING event! Go to STOP.\n" );
+    BUZZ_Delete( eventBuzzing );
+    BUZZ_Add( 500, 500, 200, 10 );
+    heaterState = STATE_HEATING;
+    heaterStateRequested = STATE_STOP_REQUESTED;
+  }
+  else {
+    heatingDoneHandle();
+  }
+}
+
+static void controllerEventHandle( const ctrlEvent_t * event ) {
+  switch( event->type ) {
+    case CTRL_EVT_START: {
+      if( STATE_IDLE == heaterState ) {
+        heaterStateRequested = STATE_START_REQUESTED;
+      }
+      break;
+    }
+    case CTRL_EVT_STOP: {
+      if( STATE_IDLE != heaterState ) {
+        heaterStateRequested = STATE_STOP_REQUESTED;
+      }
+      break;
+    }
+    case CTRL_EVT_PAUSE: {
+      if( STATE_IDLE != heaterState ) {
+        heaterStateRequested = STATE_PAUSE_REQUESTED;
+      }
+      break;
+    }
+    case CTRL_EVT_SET_TEMP: {
+      if( STATE_IDLE == heaterState ) {
+        updateTempHandle( (uint16_t)event->value );
+      }
+      break;
+    }
+    case CTRL_EVT_SET_TIME: {
+      if( STATE_IDLE == heaterState ) {
+        updateTimeHandle( (uint32_t)event->value );
+      }
+      break;
+    }
+    case CTRL_EVT_ADJUST_TIME: {
+      adjustTimeHandle( event->value );
+      break;
+    }
+    case CTRL_EVT_BAKE_PICKUP: {
+      bakePickupHandle( (uint32_t)event->value, 0 != event->arg );
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+// one request can go through several states (e.g. START >> SPECIAL_EVENT >> BEGIN >> HANDLING)
+static void controllerSettle( uint32_t now ) {
+  for( int x=0; x<CONTROLLER_STEPS_MAX; x++ ) {
+    heater_state state = heaterState;
+    heater_state requested = heaterStateRequested;
+    event_state eventState = specialEventState;
+    bool special = specialEvent;
+
+    controllerStep( now );
+    if( state == heaterState && requested == heaterStateRequested && eventState == specialEventState && special == specialEvent ) {
+      break;
+    }
+  }
+}
+
+// called by heater task with heater lock held, must not wait
+static void heatingDone() {
+  HAL_taskNotify( &task, CTRL_NOTIFY_HEATER_DONE );
+}
+
+static bool queuePush( const ctrlEvent_t * event ) {
+  bool retVal = false;
+
+  HAL_mutexTake( &queueMutex, HAL_WAIT_FOREVER );
+  if( CONTROLLER_QUEUE_LENGTH > queueCount ) {
+    queue[ ( queueHead + queueCount ) % CONTROLLER_QUEUE_LENGTH ] = *event;
+    queueCount++;
+    retVal = true;
+  }
+  HAL_mutexGive( &queueMutex );
+
+  return retVal;
+}
+
+static bool queuePop( ctrlEvent_t * event ) {
+  bool retVal = false;
+
+  HAL_mutexTake( &queueMutex, HAL_WAIT_FOREVER );
+  if( 0 < queueCount ) {
+    *event = queue[ queueHead ];
+    queueHead = ( queueHead + 1 ) % CONTROLLER_QUEUE_LENGTH;
+    queueCount--;
+    retVal = true;
+  }
+  HAL_mutexGive( &queueMutex );
+
+  return retVal;
+}
+
+static void vTaskController( void * pvParameters ) {
+  ctrlEvent_t event;
+
+  while( 1 ) {
+    uint32_t notified = HAL_taskWait( CONTROLLER_TICK );   // timeout is the tick, nothing to wait for
+    uint32_t now = HAL_millis();
+
+    if( notified & CTRL_NOTIFY_HEATER_DONE ) {
+      heatingTimeUp();
+      controllerSettle( now );
+    }
+    while( queuePop( &event ) ) {   // all commands, also those queued before the bit was set
+      controllerEventHandle( &event );
+      controllerSettle( now );
+    }
+    controllerSettle( now );    // temperature and time watched by special events
+    statusPublish();
+  }
+}
+
+void CTRL_Init( void ) {
+  if( initialized ) {
+    return;
+  }
+
+  HAL_mutexInit( &queueMutex );
+  statusPublish();    // status may be read before the first command
+  HEATER_setCallback( heatingDone );
+
+  bool created = HAL_taskCreate( &task, vTaskController, "Controller", taskStack, CONTROLLER_STACK_SIZE, CONTROLLER_TASK_PRIORITY, 1 );
+  assert( created );
+
+  initialized = true;
+}
+
+void CTRL_setEventCallback( ctrlEventCb callback ) {
+  eventCallback = callback;
+}
+
+void CTRL_Post( ctrl_event_type type, int32_t value, uint32_t arg ) {
+  ctrlEvent_t event = { type, value, arg };
+
+  if( !initialized ) {
+    LOG_Printf( LOG_ERROR, "CONTROLLER: command %u before init", type );
+    return;
+  }
+
+  if( !queuePush( &event ) ) {
+    queueWaits++;
+    LOG_Printf( LOG_WARNING, "CONTROLLER: queue full, command %u waits (%u times)", type, queueWaits );
+    while( !queuePush( &event ) ) {
+      HAL_delay( CONTROLLER_POST_RETRY );
+    }
+  }
+  HAL_taskNotify( &task, CTRL_NOTIFY_COMMAND );
+}
+
+void CTRL_getStatus( ctrlStatus_t * copy ) {
+  uint32_t sequence;
+
+  do {
+    sequence = __atomic_load_n( &statusSequence, __ATOMIC_ACQUIRE );
+    memcpy( copy, &status, sizeof( ctrlStatus_t ) );
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+  } while( ( sequence & 1 ) || sequence != __atomic_load_n( &statusSequence, __ATOMIC_RELAXED ) );
+}
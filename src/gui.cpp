@@ -3,12 +3,17 @@
 #include "lvgl.h"
 #include "buzzer.h"
 #include "myOTA.h"
+#include "trace.h"
+#include "lockprof.h"
 
 #define TERMOMETER_BAR_MIN    -30
 #define TERMOMETER_BAR_MAX    115
+#define BAKE_LABEL_LENGTH     ( BAKE_NAME_LENGTH + 7 )  // bake name + 5 digits number and 2 static chars ": "
+#define SEARCH_FIELD_HEIGHT   44          // bake search field on top of the bake list
+#define BAKE_ROWS_MAX         999         // rows created on bake list screen, search shows the rest
 
 typedef enum rollerType { ROLLER_TIME = 1, ROLLER_TEMP } roller_t;
-typedef enum bakeOperationType { BAKE_NONE = 0, BAKE_REMOVE, BAKE_SWAP } bakeOperation_t;
+typedef enum bakeOperationType { BAKE_NONE = 0, BAKE_REMOVE, BAKE_SWAP, BAKE_MOVE } bakeOperation_t;
 
 static lv_obj_t * tabView;    // main container for 3 tabs
 static lv_style_t styleTabs;  // has impact on tabs icons size
@@ -22,6 +27,7 @@ static lv_obj_t * tempBar;
 static lv_obj_t * labelBakeName;
 static lv_obj_t * labelSoundIcon;
 static lv_obj_t * labelWiFiIcon;
+static lv_obj_t * labelTotalTime;
 static lv_obj_t * powerBar;
 static lv_obj_t * labelPowerBar;
 static lv_style_t styleScreenFrame;
@@ -38,8 +44,14 @@ static lv_obj_t * roller2;
 static lv_obj_t * roller3;
 static lv_obj_t * roller4;
 static lv_obj_t * bakeList;
+static bakeNameCb bakeNameGet = NULL;   // bake list rows are created from it (GUI_populateBakeListNames())
+static uint32_t bakeNameCount = 0;
+static lv_obj_t * searchField;
+static lv_obj_t * searchKeyboard;
 static lv_obj_t * optionList;
 static lv_obj_t * msgBox;
+static lv_obj_t * diagPage;     // hidden diagnostics page (on top layer)
+static lv_obj_t * diagLabel;
 static updateTimeCb timeChangedCB = NULL;
 static updateTempCb tempChangedCB = NULL;
 static operationCb heatingStartCB = NULL;
@@ -49,19 +61,26 @@ static bakePickupCb bakePickupCB = NULL;
 static adjustTimeCb adjustTimeCB = NULL;
 static removeBakesCb removeBakesCB = NULL;
 static swapBakesCb swapBakesCB = NULL;
+static moveBakeCb moveBakeCB = NULL;
+static bakeFilterCb bakeFilterCB = NULL;
 static buttonsGroup_t buttonsGroup;
 static uint16_t rollerTemp;
 static uint32_t rollerTime;
 static lv_timer_t * timer_blinkTimeCurrent;
 static lv_timer_t * timer_blinkScreenFrame;
 static lv_timer_t * timer_setDefaultTab;
-uint8_t bakesToRemoveList[ BAKES_TO_REMOVE_MAX ];   // used for swaping two bakes also
+static uint32_t bakesPicked[ 2 ];   // swap/move: bake positions in order of checking (count from 1, 0: free slot)
 const char defaultBakeName[] = "Manual operation";
 static bakeOperationType bakeOperation;
 
-static SemaphoreHandle_t  xSemaphore = NULL;
-static StaticSemaphore_t  xMutexBuffer;
-static uint32_t inEventHandling = 0;
+static profLock_t xLock;    // mutex with contention statistics
+static uint32_t eventHandlingDepth = 0;      // callbacks being executed from GUI_Handle()
+static TaskHandle_t guiTask = NULL;           // task calling GUI_Handle()
+
+// setters called from callbacks already run under GUI_Handle() lock, calls from other tasks have to take it
+static bool inEventHandling() {
+  return 0 < eventHandlingDepth && xTaskGetCurrentTaskHandle() == guiTask;
+}
 
 TFT_eSPI tft = TFT_eSPI();
 static lv_color_t buf[LV_HOR_RES_MAX * LV_VER_RES_MAX / 10]; // Declare a buffer for 1/10 screen size
@@ -84,18 +103,23 @@ static void btnOptionAdjustTimeEventCb( lv_event_t * event );
 static void btnOptionRemoveBakesEventCb( lv_event_t * event );
 static void btnBakesRemovalCancelEventCb( lv_event_t * event );
 static void btnBakesRemovalDeleteEventCb( lv_event_t * event );
-static void btnBakesSwapEventCb( lv_event_t * event );
+static void btnBakesPairEventCb( lv_event_t * event );
 static void checkboxChangedEventCb( lv_event_t * event );
+static void searchFieldEventCb( lv_event_t * event );
 static void msgBoxOkEventCb( lv_event_t * event );
+static void diagOpenEventCb( lv_event_t * event );
+static void diagCloseEventCb( lv_event_t * event );
 static void rollerCreate( roller_t rType );
 static void createOperatingButtons();
 static void setContentHome();
-static void setContentList( char *nameList, uint32_t nameLength, uint32_t nameCount );
+static void setContentList( void );
+static void bakeRowsCreate( const uint16_t positions[], uint32_t count );
 static void setContentOptions();
 static void setScreenMain();
 static void blinkTimeCurrent( lv_timer_t * timer );
 static void blinkScreenFrame( lv_timer_t * timer );
 static void setDefaultTab( lv_timer_t * timer );
+static void searchKeyboardHide();
 
 /* Display flushing */
 static void customDisplayFlush( lv_display_t * disp, const lv_area_t * area, uint8_t * color_p )
@@ -103,10 +127,12 @@ static void customDisplayFlush( lv_display_t * disp, const lv_area_t * area, uin
   uint32_t w = ( area->x2 - area->x1 + 1 );
   uint32_t h = ( area->y2 - area->y1 + 1 );
 
+  TRACE_BEGIN( TRACE_GUI_FLUSH, w * h );
   tft.startWrite();
   tft.setAddrWindow( area->x1, area->y1, w, h );
   tft.myPushColors( color_p, w * h * 3, false );
   tft.endWrite();
+  TRACE_END( TRACE_GUI_FLUSH, w * h );
 
   lv_disp_flush_ready( disp );
 }
@@ -136,6 +162,7 @@ static void tabEventCb( lv_event_t * event ) {
   }
 
   OTA_LogWrite( "TAB_EVENT\n" );
+  searchKeyboardHide();
 }
 
 static void touchEventCb( lv_event_t * event ) {
@@ -186,9 +213,9 @@ static void btnOkEventCb( lv_event_t * event ) {
     rollerTemp = (uint16_t)(t1 * 100 + t2 * 10 + t3);
 
     if( NULL != tempChangedCB ) {
-      inEventHandling++;
+      eventHandlingDepth++;
       tempChangedCB( rollerTemp );
-      inEventHandling--;
+      eventHandlingDepth--;
     }
   }
   else if( ROLLER_TIME == *rType ) {
@@ -200,9 +227,9 @@ static void btnOkEventCb( lv_event_t * event ) {
     rollerTime = HOUR_TO_MILLIS(h1 * 10 + h2) + MINUTE_TO_MILLIS(m1 * 10 + m2);
 
     if( NULL != timeChangedCB ) {
-      inEventHandling++;
+      eventHandlingDepth++;
       timeChangedCB( rollerTime );
-      inEventHandling--;
+      eventHandlingDepth--;
     }
   }
 
@@ -233,9 +260,9 @@ static void btnStartEventCb( lv_event_t * event ) {
   OTA_LogWrite( "START_EVENT\n" );
 
   if( NULL != heatingStartCB ) {
-    inEventHandling++;
+    eventHandlingDepth++;
     heatingStartCB();
-    inEventHandling--;
+    eventHandlingDepth--;
   }
 }
 
@@ -248,9 +275,9 @@ static void btnStopEventCb( lv_event_t * event ) {
   OTA_LogWrite( "STOP_EVENT\n" );
 
   if( NULL != heatingStopCB ) {
-    inEventHandling++;
+    eventHandlingDepth++;
     heatingStopCB();
-    inEventHandling--;
+    eventHandlingDepth--;
   }
 }
 
@@ -263,9 +290,9 @@ static void btnPauseEventCb( lv_event_t * event ) {
   OTA_LogWrite( "PAUSE_EVENT\n" );
 
   if( NULL != heatingPauseCB ) {
-    inEventHandling++;
+    eventHandlingDepth++;
     heatingPauseCB();
-    inEventHandling--;
+    eventHandlingDepth--;
   }
 }
 
@@ -280,9 +307,31 @@ static void btnBakeSelectEventCb( lv_event_t * event ) {
   OTA_LogWrite( "BAKE_PICKUP_EVENT\n" );
 
   if( NULL != bakePickupCB ) {
-    inEventHandling++;
+    eventHandlingDepth++;
     bakePickupCB( (int32_t)lv_event_get_user_data( event ), ( LV_EVENT_LONG_PRESSED == code ) );
-    inEventHandling--;
+    eventHandlingDepth--;
+  }
+}
+
+static void searchFieldEventCb( lv_event_t * event ) {
+  lv_event_code_t code = lv_event_get_code( event );
+
+  if( LV_EVENT_FOCUSED == code ) {
+    lv_keyboard_set_textarea( searchKeyboard, searchField );
+    lv_obj_remove_flag( searchKeyboard, LV_OBJ_FLAG_HIDDEN );
+  }
+  else if( LV_EVENT_READY == code || LV_EVENT_CANCEL == code ) {  // keyboard's OK/close buttons
+    searchKeyboardHide();
+  }
+  else if( LV_EVENT_VALUE_CHANGED == code ) {
+    lv_timer_reset( timer_setDefaultTab );  // typing is not idling
+    OTA_LogWrite( "BAKE_FILTER_EVENT\n" );
+
+    if( NULL != bakeFilterCB ) {
+      eventHandlingDepth++;
+      bakeFilterCB( lv_textarea_get_text( searchField ) );
+      eventHandlingDepth--;
+    }
   }
 }
 
@@ -297,9 +346,9 @@ static void btnOptionEventCb( lv_event_t * event ) {
   
   if( NULL != data ) {
     if( data->optionCallback ) {
-      inEventHandling++;
+      eventHandlingDepth++;
       data->optionCallback();
-      inEventHandling--;
+      eventHandlingDepth--;
     }
   }
 }
@@ -311,9 +360,9 @@ static void btnOptionAdjustTimeEventCb( lv_event_t * event ) {
   }
   
   if( NULL != adjustTimeCB ) {
-    inEventHandling++;
+    eventHandlingDepth++;
     adjustTimeCB( (int32_t)lv_event_get_user_data( event ) );
-    inEventHandling--;
+    eventHandlingDepth--;
   }
 }
 
@@ -328,10 +377,7 @@ static void btnOptionRemoveBakesEventCb( lv_event_t * event ) {
     touchEvent = false;
   }
 
-  // clear list with bakes indexes
-  for( int x=0; x<BAKES_TO_REMOVE_MAX; x++ ) {
-    bakesToRemoveList[ x ] = 0;
-  }
+  bakesPicked[0] = bakesPicked[1] = 0;
 
   // create container for bake list
   containerBakesRemoval = lv_obj_create( tabOptions );
@@ -360,10 +406,15 @@ static void btnOptionRemoveBakesEventCb( lv_event_t * event ) {
   lv_obj_remove_flag( containerBakesList, LV_OBJ_FLAG_SCROLL_MOMENTUM );
   lv_obj_set_scroll_dir( containerBakesList, LV_DIR_VER );
 
-  // populate container with bake names
+  // populate container with bake names (rows shown on bake list)
   lv_obj_t * btn;
-  uint32_t idx = 0;
-  while( btn = lv_obj_get_child( bakeList, idx ) ) {
+  uint32_t row = 0;
+  for( uint32_t idx = 0; NULL != ( btn = lv_obj_get_child( bakeList, idx ) ); idx++ ) {
+    uint32_t pos = (uint32_t)lv_obj_get_user_data( btn );   // counts elements from 1, 0: not a bake row
+    if( 0 == pos ) {
+      continue;
+    }
+
     lv_obj_t * cb = lv_checkbox_create( containerBakesList );
     lv_obj_t * label = lv_obj_get_child( btn, 1 );  // index 0: ICON, index 1: LABEL of the button
 
@@ -372,11 +423,12 @@ static void btnOptionRemoveBakesEventCb( lv_event_t * event ) {
     } else {
       lv_checkbox_set_text( cb, "..." );
     }
+    lv_obj_set_user_data( cb, (void *)pos );
     lv_obj_set_style_text_color( cb, {0xE0, 0xE0, 0xE0}, LV_PART_MAIN );
-    lv_obj_add_event_cb( cb, checkboxChangedEventCb, LV_EVENT_VALUE_CHANGED, (void *)(idx+1) ); // counts elements from 1
-    lv_obj_align( cb, LV_ALIGN_TOP_LEFT, 0, idx*35 );
+    lv_obj_add_event_cb( cb, checkboxChangedEventCb, LV_EVENT_VALUE_CHANGED, (void *)pos );
+    lv_obj_align( cb, LV_ALIGN_TOP_LEFT, 0, row*35 );
 
-    idx++;
+    row++;
   }
 
   // QUIRK: treat pointer as value
@@ -406,9 +458,9 @@ static void btnOptionRemoveBakesEventCb( lv_event_t * event ) {
   if( BAKE_REMOVE == bo ) {
     bakeOperation = BAKE_REMOVE;
     lv_obj_add_event_cb( btnOk, btnBakesRemovalDeleteEventCb, LV_EVENT_CLICKED, NULL );
-  } else if( BAKE_SWAP == bo ) {
-    bakeOperation = BAKE_SWAP;
-    lv_obj_add_event_cb( btnOk, btnBakesSwapEventCb, LV_EVENT_CLICKED, NULL );
+  } else if( BAKE_SWAP == bo || BAKE_MOVE == bo ) {
+    bakeOperation = bo;
+    lv_obj_add_event_cb( btnOk, btnBakesPairEventCb, LV_EVENT_CLICKED, NULL );
   } else {
     bakeOperation = BAKE_NONE;
   }
@@ -418,6 +470,8 @@ static void btnOptionRemoveBakesEventCb( lv_event_t * event ) {
     lv_label_set_text( labelBtn, "DELETE" );
   } else if( BAKE_SWAP == bo ) {
     lv_label_set_text( labelBtn, "SWAP" );
+  } else if( BAKE_MOVE == bo ) {
+    lv_label_set_text( labelBtn, "MOVE" );
   }
   lv_obj_center( labelBtn );
   labelBtn = lv_label_create( btnCancel );
@@ -440,31 +494,49 @@ static void btnBakesRemovalCancelEventCb( lv_event_t * event ) {
 }
 
 static void btnBakesRemovalDeleteEventCb( lv_event_t * event ) {
+  uint16_t * list = NULL;
+  uint32_t count = 0;
+
   if( touchEvent ) {  // buzz only on user events (exclude SW triggered events)
     BUZZ_Add( 80 );
     touchEvent = false;
   }
   
   if( containerBakesRemoval ) {
+    // collect checked positions straight from checkboxes (no limit for number of bakes)
+    lv_obj_t * containerBakesList = lv_obj_get_child( containerBakesRemoval, 0 );
+    uint32_t total = lv_obj_get_child_count( containerBakesList );
+
+    list = (uint16_t *)malloc( total * sizeof( uint16_t ) + 1 );
+    if( list ) {
+      for( uint32_t x=0; x<total; x++ ) {
+        lv_obj_t * cb = lv_obj_get_child( containerBakesList, x );
+
+        if( lv_obj_has_state( cb, LV_STATE_CHECKED ) ) {
+          list[ count++ ] = (uint16_t)( (uint32_t)lv_obj_get_user_data( cb ) - 1 );   // bake position + 1
+        }
+      }
+    }
+
     lv_event_stop_processing( event );
     lv_obj_delete( containerBakesRemoval );
     containerBakesRemoval = NULL;   // LVGL bug? pointer is not NULL here
     msgBox = NULL;                  // LVGL bug? pointer is not NULL here
   }
   
-  if( NULL != removeBakesCB ) {
-    inEventHandling++;
-    removeBakesCB( &bakesToRemoveList[0] );
-    inEventHandling--;
+  if( NULL != removeBakesCB && 0 < count ) {
+    eventHandlingDepth++;
+    removeBakesCB( list, count );
+    eventHandlingDepth--;
   }
 
-  // clear list with bakes indexes
-  for( int x=0; x<BAKES_TO_REMOVE_MAX; x++ ) {
-    bakesToRemoveList[ x ] = 0;
-  }
+  free( list );
 }
 
-static void btnBakesSwapEventCb( lv_event_t * event ) {
+/**
+ * one function for handling swaping and moving (both need exactly two positions)
+ */
+static void btnBakesPairEventCb( lv_event_t * event ) {
   if( touchEvent ) {  // buzz only on user events (exclude SW triggered events)
     BUZZ_Add( 80 );
     touchEvent = false;
@@ -476,21 +548,22 @@ static void btnBakesSwapEventCb( lv_event_t * event ) {
     containerBakesRemoval = NULL;   // LVGL bug? pointer is not NULL here
     msgBox = NULL;                  // LVGL bug? pointer is not NULL here
   }
-  
-  if( NULL != swapBakesCB ) {
-    inEventHandling++;
-    swapBakesCB( &bakesToRemoveList[0] );
-    inEventHandling--;
-  }
 
-  // clear list with bakes indexes
-  for( int x=0; x<BAKES_TO_REMOVE_MAX; x++ ) {
-    bakesToRemoveList[ x ] = 0;
+  if( 0 < bakesPicked[0] && 0 < bakesPicked[1] ) {
+    eventHandlingDepth++;
+    if( BAKE_SWAP == bakeOperation && NULL != swapBakesCB ) {
+      swapBakesCB( bakesPicked[0] - 1, bakesPicked[1] - 1 );
+    } else if( BAKE_MOVE == bakeOperation && NULL != moveBakeCB ) {
+      moveBakeCB( bakesPicked[0] - 1, bakesPicked[1] - 1 );   // first checked bake goes to the place of second one
+    }
+    eventHandlingDepth--;
   }
+
+  bakesPicked[0] = bakesPicked[1] = 0;
 }
 
 /**
- * one function for handling removal and swaping
+ * one function for handling removal, swaping and moving
  */
 static void checkboxChangedEventCb( lv_event_t * event ) {
   if( touchEvent ) {  // buzz only on user events (exclude SW triggered events)
@@ -498,51 +571,43 @@ static void checkboxChangedEventCb( lv_event_t * event ) {
     touchEvent = false;
   }
   
+  if( BAKE_REMOVE == bakeOperation ) {
+    return;   // checked positions are collected when DELETE is clicked
+  }
+
   lv_obj_t * obj = lv_event_get_target_obj( event );
   // QUIRK: treat pointer as value
-  uint8_t newIdx = (uint8_t)(uint32_t)lv_event_get_user_data( event );
-  uint8_t maxCheckedBakes = BAKES_TO_REMOVE_MAX;
-  
-  if( BAKE_SWAP == bakeOperation ) {
-    maxCheckedBakes = 2;
-  }
+  uint32_t newIdx = (uint32_t)lv_event_get_user_data( event );
   
   if( LV_STATE_CHECKED & lv_obj_get_state(obj) ) {
     // checkbox is checked, add idx to list
-    bool found = false;
     Serial.printf( "Element to be added to list:%d\n", newIdx );
     
-    for( int x=0; x<maxCheckedBakes; x++ ) {
-      if( 0 == bakesToRemoveList[x] ) {
-        bakesToRemoveList[x] = newIdx;
-        found = true;
-        break;
-      }
-    }
-    if( false == found ) {  // full list, can't add more
+    if( 0 == bakesPicked[0] ) {
+      bakesPicked[0] = newIdx;
+    } else if( 0 == bakesPicked[1] ) {
+      bakesPicked[1] = newIdx;
+    } else {  // full list, can't add more
       Serial.println( "Too much elements checked." );
       lv_obj_remove_state( obj, LV_STATE_CHECKED );
       // display GUI messageBox about max checked positions
       if( NULL == msgBox ) {
-        char msg[50];
-        sprintf( msg, " You can check\n %d positions max.", maxCheckedBakes );
-
         msgBox = lv_msgbox_create( containerBakesRemoval );
         lv_msgbox_add_title( msgBox, "Information:" );
-        lv_msgbox_add_text( msgBox, msg );
+        lv_msgbox_add_text( msgBox, " You can check\n 2 positions max." );
         lv_obj_t * btn = lv_msgbox_add_footer_button( msgBox, "Ok" );
         lv_obj_add_event_cb( btn, msgBoxOkEventCb, LV_EVENT_CLICKED, NULL );
       }
     }
   } else {
-    // checkbox is unchecked, remove idx from list
+    // checkbox is unchecked, remove idx from list (keep order of checking)
     Serial.printf( "Element to be removed from list:%d\n", newIdx );
     
-    for( int x=0; x<maxCheckedBakes; x++ ) {
-      if( newIdx == bakesToRemoveList[x] ) {
-        bakesToRemoveList[x] = 0;
-        break;
-      }
+    if( newIdx == bakesPicked[0] ) {
+      bakesPicked[0] = bakesPicked[1];
+      bakesPicked[1] = 0;
+    } else if( newIdx == bakesPicked[1] ) {
+      bakesPicked[1] = 0;
     }
   }
 }
@@ -963,12 +1028,19 @@ static void setContentHome() {
   lv_obj_set_style_text_font( labelWiFiIcon, &lv_font_montserrat_custom_16, LV_PART_MAIN );
   lv_obj_align( labelWiFiIcon, LV_ALIGN_CENTER, 180, -134 );
 
+  // whole bake remaining time (hidden for manual operation)
+  labelTotalTime = lv_label_create( tabHome );
+  lv_label_set_text( labelTotalTime, "" );
+  lv_obj_set_style_text_color( labelTotalTime, {0x00, 0x00, 0x00}, LV_PART_MAIN );
+  lv_obj_set_style_text_font( labelTotalTime, &lv_font_montserrat_custom_16, LV_PART_MAIN );
+  lv_obj_align( labelTotalTime, LV_ALIGN_CENTER, 80, -134 );
+
   buttonsGroup = BUTTONS_START; // show Start button by default
   createOperatingButtons();
   GUI_setTimeTempChangeAllowed( true );
 }
 
-static void setContentList( char *nameList, uint32_t nameLength, uint32_t nameCount ) {
+static void setContentList() {
   static lv_style_t styleTabList;
 
   lv_obj_set_style_bg_color( tabList, {0x00, 0x00, 0x00}, 0 );
@@ -981,10 +1053,28 @@ static void setContentList( char *nameList, uint32_t nameLength, uint32_t nameCo
   lv_style_set_text_font( &styleTabList, &lv_font_montserrat_custom_24 );
   lv_obj_add_style( tabList, &styleTabList, 0 );
 
+  // search field stays when the list is repopulated (keeps the text being typed)
+  if( NULL == searchField ) {
+    searchField = lv_textarea_create( tabList );
+    lv_textarea_set_one_line( searchField, true );
+    lv_textarea_set_placeholder_text( searchField, "Search..." );
+    lv_textarea_set_max_length( searchField, BAKE_FILTER_LENGTH - 1 );
+    lv_obj_set_size( searchField, lv_pct( 100 ), SEARCH_FIELD_HEIGHT );
+    lv_obj_align( searchField, LV_ALIGN_TOP_MID, 0, 0 );
+    lv_obj_set_style_radius( searchField, 0, LV_PART_MAIN );
+    lv_obj_set_style_pad_ver( searchField, 6, LV_PART_MAIN );
+    lv_obj_add_event_cb( searchField, searchFieldEventCb, LV_EVENT_ALL, NULL );
+
+    searchKeyboard = lv_keyboard_create( lv_layer_top() );
+    lv_obj_set_size( searchKeyboard, LV_HOR_RES_MAX, LV_VER_RES_MAX / 2 );
+    lv_obj_align( searchKeyboard, LV_ALIGN_BOTTOM_MID, 0, 0 );
+    lv_obj_add_flag( searchKeyboard, LV_OBJ_FLAG_HIDDEN );
+  }
+
   /*Create a list*/
   bakeList = lv_list_create( tabList );
-  lv_obj_set_size( bakeList, lv_obj_get_style_width( tabList, LV_PART_MAIN ), lv_obj_get_style_height( tabList, LV_PART_MAIN ) );
-  lv_obj_center( bakeList );
+  lv_obj_set_size( bakeList, lv_obj_get_style_width( tabList, LV_PART_MAIN ), LV_VER_RES_MAX - SEARCH_FIELD_HEIGHT );
+  lv_obj_align( bakeList, LV_ALIGN_BOTTOM_MID, 0, 0 );
   lv_obj_set_style_radius( bakeList, 0, LV_PART_MAIN );
   lv_obj_set_style_bg_color( bakeList, lv_palette_darken(LV_PALETTE_GREY, 3), LV_PART_SCROLLBAR );
   lv_obj_set_style_width( bakeList, 15, LV_PART_SCROLLBAR );
@@ -992,18 +1082,40 @@ static void setContentList( char *nameList, uint32_t nameLength, uint32_t nameCo
   lv_obj_remove_flag( bakeList, LV_OBJ_FLAG_SCROLL_MOMENTUM );
   lv_obj_add_event_cb( bakeList, pressingEventCb, LV_EVENT_PRESSING, NULL );
 
-  if( NULL != nameList && 1000 > nameCount ) {  // max 999 positions on the list allowed
-    for( int x=0; x<nameCount; x++ ) {
-      lv_obj_t * btn;
-      char buffer[ nameLength+5 ];  // additional 5 bytes for 3 digits number and 2 static chars ": "
+  bakeRowsCreate( NULL, bakeNameCount );
+}
+
+/**
+ * Fill bake list with rows (button user data: bake position + 1)
+ * positions[]  - bake positions to show, NULL: first 'count' positions
+ */
+static void bakeRowsCreate( const uint16_t positions[], uint32_t count ) {
+  uint32_t rows = ( BAKE_ROWS_MAX < count ) ? BAKE_ROWS_MAX : count;
 
-      /*Add buttons to the list*/
-      snprintf( buffer, nameLength+5, "%d: %s", (x+1), (nameList + nameLength * x) );
-      btn = lv_list_add_button( bakeList, LV_SYMBOL_RIGHT, buffer );
-      lv_obj_remove_flag( btn, LV_OBJ_FLAG_PRESS_LOCK );
-      lv_obj_add_event_cb( btn, btnBakeSelectEventCb, LV_EVENT_SHORT_CLICKED, (void *)x );  // use pointer as ordinary value
-      lv_obj_add_event_cb( btn, btnBakeSelectEventCb, LV_EVENT_LONG_PRESSED, (void *)x );   // use pointer as ordinary value
-    }
+  if( NULL == bakeNameGet ) {
+    return;
+  }
+
+  for( uint32_t x=0; x<rows; x++ ) {
+    lv_obj_t * btn;
+    uint32_t pos = ( NULL != positions ) ? positions[x] : x;
+    char name[ BAKE_NAME_LENGTH ];
+    char buffer[ BAKE_LABEL_LENGTH ];
+
+    /*Add buttons to the list*/
+    snprintf( buffer, sizeof( buffer ), "%u: %s", (pos+1), ( bakeNameGet( pos, name, sizeof( name ) ) ? name : "..." ) );
+    btn = lv_list_add_button( bakeList, LV_SYMBOL_RIGHT, buffer );
+    lv_obj_set_user_data( btn, (void *)(pos+1) );   // use pointer as ordinary value
+    lv_obj_remove_flag( btn, LV_OBJ_FLAG_PRESS_LOCK );
+    lv_obj_add_event_cb( btn, btnBakeSelectEventCb, LV_EVENT_SHORT_CLICKED, (void *)pos );  // use pointer as ordinary value
+    lv_obj_add_event_cb( btn, btnBakeSelectEventCb, LV_EVENT_LONG_PRESSED, (void *)pos );   // use pointer as ordinary value
+  }
+
+  if( rows < count ) {
+    char buffer[ 48 ];
+
+    snprintf( buffer, sizeof( buffer ), "%u more, use search", count - rows );
+    lv_list_add_text( bakeList, buffer );   // no user data: not a bake
   }
 }
 
@@ -1049,9 +1161,11 @@ static void setScreenMain() {
   lv_obj_remove_flag( tabHome, LV_OBJ_FLAG_SCROLLABLE );
   // set callback for clicking on TABs
   lv_obj_add_event_cb( tabView, tabEventCb, LV_EVENT_VALUE_CHANGED, NULL );
+  // long press on options TAB button opens hidden diagnostics page
+  lv_obj_add_event_cb( lv_obj_get_child( lv_tabview_get_tab_bar( tabView ), 2 ), diagOpenEventCb, LV_EVENT_LONG_PRESSED, NULL );
 
   setContentHome();
-  setContentList( NULL, 0, 0 );
+  setContentList();
   setContentOptions();
 
   // create frame around the whole screen
@@ -1127,12 +1241,40 @@ static void blinkScreenFrame( lv_timer_t * timer ) {
 }
 
 static void setDefaultTab( lv_timer_t * timer ) {
+  searchKeyboardHide();
   lv_tabview_set_active( tabView, 0, LV_ANIM_OFF );
 }
 
+static void diagOpenEventCb( lv_event_t * event ) {
+  if( NULL == diagPage ) {
+    diagPage = lv_obj_create( lv_layer_top() );
+    lv_obj_set_size( diagPage, LV_HOR_RES, LV_VER_RES );
+    lv_obj_set_style_radius( diagPage, 0, 0 );
+    lv_obj_add_event_cb( diagPage, diagCloseEventCb, LV_EVENT_SHORT_CLICKED, NULL );
+
+    diagLabel = lv_label_create( diagPage );
+    lv_obj_set_width( diagLabel, lv_pct( 100 ) );
+    lv_label_set_text( diagLabel, "Collecting..." );
+  }
+
+  lv_obj_remove_flag( diagPage, LV_OBJ_FLAG_HIDDEN );
+  lv_obj_scroll_to_y( diagPage, 0, LV_ANIM_OFF );
+  OTA_LogWrite( "DIAG_OPEN_EVENT\n" );
+}
+
+static void diagCloseEventCb( lv_event_t * event ) {
+  lv_obj_add_flag( diagPage, LV_OBJ_FLAG_HIDDEN );
+}
+
+static void searchKeyboardHide() {
+  if( NULL != searchKeyboard ) {
+    lv_obj_add_flag( searchKeyboard, LV_OBJ_FLAG_HIDDEN );
+    lv_obj_remove_state( searchField, LV_STATE_FOCUSED );
+  }
+}
+
 void GUI_Init() {
-  xSemaphore = xSemaphoreCreateMutexStatic( &xMutexBuffer );
-  assert( xSemaphore );
+  LOCK_Init( &xLock, "gui" );
 
   uint16_t calData[5] = { 265, 3677, 261, 3552, 1 };  // check branch TouchscreenCalibration for those values
   tft.init();
@@ -1166,34 +1308,39 @@ void GUI_Init() {
 }
 
 void GUI_Handle( uint32_t tick_period ) {
-  if( pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  TRACE_BEGIN( TRACE_GUI_LOCK, 0 );
+  bool taken = LOCK_Take( &xLock, 1000 );
+  TRACE_END( TRACE_GUI_LOCK, 0 );
+
+  if( taken ) {
+    guiTask = xTaskGetCurrentTaskHandle();
     lv_timer_handler();
     lv_tick_inc( tick_period );
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   }
 }
 
 void GUI_SetTabActive( uint32_t tabNr )
 {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( (0 > tabNr) || (3 <= tabNr) ) {
-      if( 0 == inEventHandling ) {
-        xSemaphoreGive( xSemaphore );
+      if( !inEventHandling() ) {
+        LOCK_Give( &xLock );
       }
       return;
     }
 
     lv_tabview_set_active( tabView, tabNr, LV_ANIM_OFF );
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_SetTargetTemp( uint16_t temp ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     char buff[4];
     uint16_t t = temp;
     uint16_t t1, t2, t3;
@@ -1212,15 +1359,15 @@ void GUI_SetTargetTemp( uint16_t temp ) {
     buff[3] = '\0';
 
     lv_label_set_text( labelTargetTempVal, buff );
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_SetCurrentTemp( uint16_t temp ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     char buff[4];
     ///TODO: double code!, duplication in GUI_SetTargetTemp(), can be reduced to one function call. The same regarding time
     uint16_t t = temp;
@@ -1243,15 +1390,15 @@ void GUI_SetCurrentTemp( uint16_t temp ) {
 
     lv_label_set_text( labelCurrentTempVal, buff );
     // lv_label_set_text( labelCurrentTempVal, "123" );  // used for adjusting label position
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_SetTargetTime( uint32_t time ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     char buff[8];
     uint32_t t = time;
     uint32_t h1, h2, m1, m2;
@@ -1280,15 +1427,15 @@ void GUI_SetTargetTime( uint32_t time ) {
     buff[7] = '\0';
 
     lv_label_set_text( labelTargetTimeVal, buff );
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_SetCurrentTime( uint32_t time ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     char buff[6];
     uint32_t t = time;
     uint32_t h1, h2, m1, m2;
@@ -1316,8 +1463,8 @@ void GUI_SetCurrentTime( uint32_t time ) {
       lv_label_set_text( labelCurrentTimeVal, buff );
       // lv_label_set_text( labelCurrentTimeVal, "00:00" );  // used for adjusting label position
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
@@ -1376,9 +1523,21 @@ void GUI_setSwapBakesOnListCallback( swapBakesCb func ) {
   }
 }
 
+void GUI_setMoveBakeOnListCallback( moveBakeCb func ) {
+  if( NULL != func ) {
+    moveBakeCB = func;
+  }
+}
+
+void GUI_setBakeFilterCallback( bakeFilterCb func ) {
+  if( NULL != func ) {
+    bakeFilterCB = func;
+  }
+}
+
 void GUI_setOperationButtons( enum operationButton btnGroup ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( BUTTONS_MAX_COUNT > btnGroup ) {
       buttonsGroup = btnGroup;
       createOperatingButtons();
@@ -1386,15 +1545,15 @@ void GUI_setOperationButtons( enum operationButton btnGroup ) {
     else {
       buttonsGroup = (buttonsGroup_t)0; // wrong enum received
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setTimeTempChangeAllowed( bool active ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( active ) {
       lv_obj_add_event_cb( widgetTime, timeEventCb, LV_EVENT_CLICKED, NULL );
       lv_obj_add_event_cb( widgetTemp, tempEventCb, LV_EVENT_CLICKED, NULL );
@@ -1403,18 +1562,18 @@ void GUI_setTimeTempChangeAllowed( bool active ) {
       lv_obj_remove_event_cb( widgetTime, timeEventCb );
       lv_obj_remove_event_cb( widgetTemp, tempEventCb );
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setBlinkTimeCurrent( bool active ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( NULL == timer_blinkTimeCurrent ) {
-      if( 0 == inEventHandling ) {
-        xSemaphoreGive( xSemaphore );
+      if( !inEventHandling() ) {
+        LOCK_Give( &xLock );
       }
       return;
     }
@@ -1431,18 +1590,18 @@ void GUI_setBlinkTimeCurrent( bool active ) {
         Serial.println("BLINK_TIME_STOP");
       }
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setBlinkScreenFrame( bool active ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( NULL == timer_blinkScreenFrame ) {
-      if( 0 == inEventHandling ) {
-        xSemaphoreGive( xSemaphore );
+      if( !inEventHandling() ) {
+        LOCK_Give( &xLock );
       }
       return;
     }
@@ -1457,8 +1616,8 @@ void GUI_setBlinkScreenFrame( bool active ) {
       lv_obj_report_style_change( &styleScreenFrame );
       Serial.println("BLINK_FRAME_STOP");
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
@@ -1467,33 +1626,53 @@ SPIClass * GUI_getSPIinstance() {
   return &(tft.getSPIinstance());
 }
 
-void GUI_populateBakeListNames( char *nameList, uint32_t nameLength, uint32_t nameCount ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+void GUI_populateBakeListNames( bakeNameCb getName, uint32_t nameCount ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     lv_obj_delete( bakeList );
     bakeList = NULL;  // LVGL bug? pointer is not NULL here
-    setContentList( nameList, nameLength, nameCount );
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    bakeNameGet = getName;
+    bakeNameCount = nameCount;
+    setContentList();
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
+    }
+  }
+}
+
+void GUI_filterBakeList( const uint16_t positions[], uint32_t count ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
+    // rows of found bakes only, whole list can have much more bakes than rows
+    lv_obj_clean( bakeList );
+    if( NULL != positions ) {
+      bakeRowsCreate( positions, count );
+    } else {
+      bakeRowsCreate( NULL, bakeNameCount );
+    }
+    lv_obj_scroll_to_y( bakeList, 0, LV_ANIM_OFF );
+
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setTimeBar( uint32_t time ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( NULL != progressCircle ) {
       lv_arc_set_value( progressCircle, time );
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setTempBar( int32_t temp ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     int32_t t = temp;
 
     if( TERMOMETER_BAR_MAX < t ) {
@@ -1506,27 +1685,27 @@ void GUI_setTempBar( int32_t temp ) {
     if( NULL != tempBar ) {
       lv_bar_set_value( tempBar, t, LV_ANIM_OFF );
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setBakeName( const char * bakeName ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( NULL != labelBakeName ) {
       lv_label_set_text( labelBakeName, bakeName );
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setPowerBar( uint32_t power ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( 100 < power ) {
       power = 100;
     }
@@ -1540,15 +1719,15 @@ void GUI_setPowerBar( uint32_t power ) {
     if( NULL != powerBar ) {
       lv_bar_set_value( powerBar, power, LV_ANIM_OFF );
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setPowerIndicator( bool active ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( NULL != powerBar ) {
       if( active ) {
         lv_obj_set_style_bg_opa( powerBar, LV_OPA_COVER, LV_PART_INDICATOR );
@@ -1556,15 +1735,15 @@ void GUI_setPowerIndicator( bool active ) {
         lv_obj_set_style_bg_opa( powerBar, LV_OPA_40, LV_PART_INDICATOR );
       }
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setSoundIcon( bool active ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( NULL != labelSoundIcon ) {
       if( active ) {
         lv_obj_set_style_text_opa( labelSoundIcon, LV_OPA_COVER, LV_PART_MAIN );
@@ -1572,15 +1751,39 @@ void GUI_setSoundIcon( bool active ) {
         lv_obj_set_style_text_opa( labelSoundIcon, LV_OPA_30, LV_PART_MAIN );
       }
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
+    }
+  }
+}
+
+void GUI_setTotalTime( uint32_t time ) {
+  static uint32_t shownMinutes = 0;
+  uint32_t minutes = ( 0 < time ) ? ( time + MINUTE_TO_MILLIS(1) - 1 ) / MINUTE_TO_MILLIS(1) : 0;   // round up, 0 only when done
+
+  if( minutes == shownMinutes ) {
+    return;   // called every 100ms, redraw only on change
+  }
+
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
+    if( NULL != labelTotalTime ) {
+      if( 0 < minutes ) {
+        lv_label_set_text_fmt( labelTotalTime, "Total %u:%02u", minutes / 60, minutes % 60 );
+      } else {
+        lv_label_set_text( labelTotalTime, "" );
+      }
+      shownMinutes = minutes;
+    }
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_setWiFiIcon( bool active ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     if( NULL != labelWiFiIcon ) {
       if( active ) {
         lv_obj_set_style_text_opa( labelWiFiIcon, LV_OPA_COVER, LV_PART_MAIN );
@@ -1588,15 +1791,15 @@ void GUI_setWiFiIcon( bool active ) {
         lv_obj_set_style_text_opa( labelWiFiIcon, LV_OPA_30, LV_PART_MAIN );
       }
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_optionsPopulate( setting_t options[], uint32_t cnt ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     #define OPTION_HEIGHT 60
     uint32_t i = 1;
     lv_obj_t * label;
@@ -1778,15 +1981,47 @@ void GUI_optionsPopulate( setting_t options[], uint32_t cnt ) {
     lv_obj_center( labelBtn );
     lv_obj_align( btnSwapBakes, LV_ALIGN_RIGHT_MID, 0, 0 );
 
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    // static option: moving bake to another position (bakes in between are shifted)
+    widgetOption = lv_button_create( tabOptions );
+    lv_obj_set_size( widgetOption, lv_obj_get_style_width( tabOptions, LV_PART_MAIN ), OPTION_HEIGHT );
+    lv_obj_set_style_bg_color( widgetOption, lv_palette_darken(LV_PALETTE_GREY, 3), LV_PART_MAIN );
+    lv_obj_set_style_bg_opa( widgetOption, LV_OPA_20, LV_PART_MAIN );
+    lv_obj_set_style_radius( widgetOption, 0, LV_PART_MAIN );
+    lv_obj_set_style_pad_ver( widgetOption, 5, LV_PART_MAIN );
+    lv_obj_set_style_pad_hor( widgetOption, 25, LV_PART_MAIN );
+    lv_obj_set_style_border_width( widgetOption, 1, LV_PART_MAIN );
+    lv_obj_set_style_border_color( widgetOption, lv_palette_darken(LV_PALETTE_GREY, 3), LV_PART_MAIN );
+    lv_obj_set_style_border_opa( widgetOption, LV_OPA_40, LV_PART_MAIN );
+    lv_obj_set_style_shadow_width( widgetOption, 0, LV_PART_MAIN );
+    lv_obj_align( widgetOption, LV_ALIGN_TOP_MID, 0, i++ * OPTION_HEIGHT );
+    lv_obj_remove_flag( widgetOption, LV_OBJ_FLAG_PRESS_LOCK );
+    lv_obj_remove_flag( widgetOption, LV_OBJ_FLAG_CLICKABLE );
+
+    label = lv_label_create( widgetOption );
+    lv_label_set_text( label, "Move bake to position" );
+    lv_obj_set_style_text_color( label, lv_palette_darken(LV_PALETTE_BROWN, 3), LV_PART_MAIN );
+    lv_obj_align( label, LV_ALIGN_LEFT_MID, 0, 0 );
+    lv_obj_t * btnMoveBake = lv_button_create( widgetOption );
+    lv_obj_set_style_shadow_width( btnMoveBake, 0, LV_PART_MAIN );
+    lv_obj_set_style_pad_all( btnMoveBake, 10, LV_PART_MAIN );
+    lv_obj_remove_flag( btnMoveBake, LV_OBJ_FLAG_PRESS_LOCK );
+    lv_obj_remove_flag( btnMoveBake, LV_OBJ_FLAG_SCROLL_ON_FOCUS );
+    lv_obj_add_event_cb( btnMoveBake, btnOptionRemoveBakesEventCb, LV_EVENT_CLICKED, (void *)BAKE_MOVE );   // use same callback as for removal
+    labelBtn = lv_label_create( btnMoveBake );
+    lv_obj_set_style_text_color( labelBtn, lv_palette_darken(LV_PALETTE_BROWN, 3), LV_PART_MAIN );
+    lv_label_set_text( labelBtn, "DoIt" );
+    lv_obj_center( labelBtn );
+    lv_obj_align( btnMoveBake, LV_ALIGN_RIGHT_MID, 0, 0 );
+
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
 }
 
 void GUI_updateOption( setting_t &option ) {
-  if( inEventHandling
-  || pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) ) ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
     switch( option.valuetype ) {
       case OPT_VAL_BOOL:
         if( option.btn ) {
@@ -1808,8 +2043,40 @@ void GUI_updateOption( setting_t &option ) {
         // nothing to do (button is the same)
         break;
     }
-    if( 0 == inEventHandling ) {
-      xSemaphoreGive( xSemaphore );
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
+    }
+  }
+}
+
+bool GUI_isDiagnosticsVisible( void ) {
+  return ( NULL != diagPage && !lv_obj_has_flag( diagPage, LV_OBJ_FLAG_HIDDEN ) );
+}
+
+void GUI_setDiagnosticsText( const char * text ) {
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
+    if( NULL != diagLabel ) {
+      lv_label_set_text( diagLabel, text );
+    }
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
+    }
+  }
+}
+
+bool GUI_getMemoryUsage( uint32_t * used, uint32_t * total ) {
+  lv_mem_monitor_t monitor;
+
+  memset( &monitor, 0, sizeof( monitor ) );
+  if( inEventHandling()
+  || LOCK_Take( &xLock, 1000 ) ) {
+    lv_mem_monitor( &monitor );   // zeroed when LVGL uses system heap
+    if( !inEventHandling() ) {
+      LOCK_Give( &xLock );
     }
   }
+  *used = monitor.total_size - monitor.free_size;
+  *total = monitor.total_size;
+  return ( 0 < monitor.total_size );
 }
@@ -0,0 +1,168 @@
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "LittleFS.h"
+#include "Preferences.h"
+#include "hal.h"
+
+uint32_t HAL_millis( void ) {
+  return millis();
+}
+
+uint32_t HAL_IRAM HAL_micros( void ) {
+  return (uint32_t)esp_timer_get_time();   // same for both cores
+}
+
+void HAL_delay( uint32_t ms ) {
+  vTaskDelay( ms / portTICK_PERIOD_MS );
+}
+
+uint32_t HAL_IRAM HAL_cycles( void ) {
+  return ESP.getCycleCount();
+}
+
+uint32_t HAL_cpuMhz( void ) {
+  return getCpuFrequencyMhz();
+}
+
+uint8_t HAL_IRAM HAL_coreId( void ) {
+  return xPortGetCoreID();
+}
+
+void HAL_pinOutput( uint8_t pin, bool level ) {
+  pinMode( pin, OUTPUT );
+  digitalWrite( pin, level ? HIGH : LOW );
+}
+
+void HAL_pinWrite( uint8_t pin, bool level ) {
+  digitalWrite( pin, level ? HIGH : LOW );
+}
+
+bool HAL_pinRead( uint8_t pin ) {
+  return HIGH == digitalRead( pin );
+}
+
+void HAL_spiBegin( halSpi_t * spi ) {
+  spi->begin();
+}
+
+uint16_t HAL_spiRead16( halSpi_t * spi, uint8_t cs, uint32_t frequency ) {
+  uint16_t v;
+
+  spi->beginTransaction( SPISettings( frequency, MSBFIRST, SPI_MODE0 ) );
+  digitalWrite( cs, LOW );
+  v = spi->transfer16( 0x00 );
+  digitalWrite( cs, HIGH );
+  spi->endTransaction();
+
+  return v;
+}
+
+void HAL_mutexInit( halMutex_t * mutex ) {
+  mutex->handle = xSemaphoreCreateMutexStatic( &mutex->buffer );
+  assert( mutex->handle );
+}
+
+bool HAL_mutexTake( halMutex_t * mutex, uint32_t timeout ) {
+  TickType_t ticks = ( HAL_WAIT_FOREVER == timeout ) ? portMAX_DELAY : (TickType_t)( timeout / portTICK_PERIOD_MS );
+
+  return pdTRUE == xSemaphoreTake( mutex->handle, ticks );
+}
+
+void HAL_mutexGive( halMutex_t * mutex ) {
+  xSemaphoreGive( mutex->handle );
+}
+
+bool HAL_taskCreate( halTask_t * task, void (* func)( void * ), const char * name, halStack_t * stack, uint32_t stackSize, uint32_t priority, int32_t core ) {
+  if( HAL_CORE_ANY == core ) {
+    task->handle = xTaskCreateStatic( func, name, stackSize, NULL, priority, stack, &task->tcb );
+  } else {
+    task->handle = xTaskCreateStaticPinnedToCore( func, name, stackSize, NULL, priority, stack, &task->tcb, core );
+  }
+
+  return NULL != task->handle;
+}
+
+const char * HAL_taskName( void ) {
+  return pcTaskGetName( NULL );
+}
+
+void HAL_taskNotify( halTask_t * task, uint32_t bits ) {
+  xTaskNotify( task->handle, bits, eSetBits );
+}
+
+uint32_t HAL_taskWait( uint32_t timeout ) {
+  TickType_t ticks = ( HAL_WAIT_FOREVER == timeout ) ? portMAX_DELAY : (TickType_t)( timeout / portTICK_PERIOD_MS );
+  uint32_t bits = 0;
+
+  if( pdTRUE != xTaskNotifyWait( 0, UINT32_MAX, &bits, ticks ) ) {
+    return 0;   // bits set right after the timeout stay for the next call
+  }
+  return bits;
+}
+
+bool HAL_fsMount( bool format ) {
+  return LittleFS.begin( format, HAL_FLASH_ROOT, HAL_FLASH_MAX_FILES, HAL_FLASH_PARTITION );
+}
+
+void HAL_fsUsage( uint32_t * total, uint32_t * used ) {
+  *total = LittleFS.totalBytes();
+  *used = LittleFS.usedBytes();
+}
+
+bool HAL_nvsGetInt( const char * space, const char * key, int32_t * value ) {
+  Preferences prefs;
+  bool retVal = true;
+
+  if( !prefs.begin( space, true ) ) {
+    return false;
+  }
+  switch( prefs.getType( key ) ) {    // keys written by older firmware keep their type
+    case PT_U8: { *value = prefs.getUChar( key ); break; }
+    case PT_U32: { *value = (int32_t)prefs.getUInt( key ); break; }
+    case PT_I32: { *value = prefs.getInt( key ); break; }
+    default: { retVal = false; break; }
+  }
+  prefs.end();
+
+  return retVal;
+}
+
+bool HAL_nvsSetInt( const char * space, const char * key, int32_t value ) {
+  Preferences prefs;
+  int32_t stored;
+  bool retVal;
+
+  if( HAL_nvsGetInt( space, key, &stored ) && stored == value ) {
+    return true;
+  }
+  if( !prefs.begin( space, false ) ) {
+    return false;
+  }
+  if( prefs.isKey( key ) && PT_I32 != prefs.getType( key ) ) {
+    prefs.remove( key );    // NVS keeps one type per key
+  }
+  retVal = ( sizeof( int32_t ) == prefs.putInt( key, value ) );
+  prefs.end();
+
+  return retVal;
+}
+
+void HAL_print( const char * text ) {
+  Serial.print( text );
+}
+
+int HAL_printf( const char * format, ... ) {
+  char buf[ 256 ];
+  va_list args;
+
+  va_start( args, format );
+  int len = vsnprintf( buf, sizeof( buf ), format, args );
+  va_end( args );
+
+  Serial.print( buf );
+  return len;
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,363 @@
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <ucontext.h>
+#include "hal.h"
+
+#define HAL_PINS_MAX          64
+#define HAL_POSIX_CPU_MHZ     1000      // HAL_cycles() counts nanoseconds
+#define HAL_SIM_TASKS_MAX     8
+#define HAL_SIM_STACK_SIZE    ( 256 * 1024 )    // coroutine stack [B] (host code needs more than the module's stack)
+#define HAL_SIM_NEVER         UINT64_MAX        // wake time of task which isn't scheduled anymore
+#define HAL_NVS_PATH_LENGTH   64
+
+// task running as coroutine under simulated clock
+typedef struct {
+  halTask_t         * task;
+  ucontext_t          context;
+  uint64_t            wake;     // simulated time to resume at [us]
+  bool                waiting;  // in HAL_taskWait(), notification resumes it at once
+} simTask_t;
+
+static volatile uint8_t       pinLevel[ HAL_PINS_MAX ];
+static thread_local const char * taskName = "main";
+static thread_local halTask_t * currentTask = NULL;   // NULL - main thread
+static bool                   simEnabled = false;
+static uint64_t               simNow = 0;         // [us]
+static simTask_t              simTasks[ HAL_SIM_TASKS_MAX ];
+static uint32_t               simTaskCount = 0;
+static int32_t                simRunning = -1;    // coroutine being run, -1 - scheduler (main thread)
+static ucontext_t             simScheduler;
+
+static uint64_t monotonicNs( void ) {
+  struct timespec now;
+
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static uint64_t elapsedNs( void ) {
+  static const uint64_t startNs = monotonicNs();   // first call, may come from static constructors (PID)
+
+  if( simEnabled ) {
+    return simNow * 1000ULL;
+  }
+  return monotonicNs() - startNs;
+}
+
+uint32_t HAL_millis( void ) {
+  return (uint32_t)( elapsedNs() / 1000000ULL );
+}
+
+uint32_t HAL_micros( void ) {
+  return (uint32_t)( elapsedNs() / 1000ULL );
+}
+
+void HAL_delay( uint32_t ms ) {
+  if( simEnabled ) {
+    if( 0 > simRunning ) {
+      HAL_simRun( simNow + ms * 1000ULL );
+    } else {
+      simTask_t * sim = &simTasks[ simRunning ];
+
+      sim->wake = simNow + ms * 1000ULL;
+      swapcontext( &sim->context, &simScheduler );   // back to HAL_simRun()
+    }
+    return;
+  }
+
+  struct timespec delay = { (time_t)( ms / 1000 ), (long)( ms % 1000 ) * 1000000L };
+
+  while( 0 != nanosleep( &delay, &delay ) && EINTR == errno ) {
+  }
+}
+
+uint32_t HAL_cycles( void ) {
+  return (uint32_t)monotonicNs();   // host time even under simulated clock, code is profiled as it runs
+}
+
+uint32_t HAL_cpuMhz( void ) {
+  return HAL_POSIX_CPU_MHZ;
+}
+
+uint8_t HAL_coreId( void ) {
+  return 0;
+}
+
+void HAL_pinOutput( uint8_t pin, bool level ) {
+  HAL_pinWrite( pin, level );
+}
+
+void HAL_pinWrite( uint8_t pin, bool level ) {
+  if( HAL_PINS_MAX > pin ) {
+    pinLevel[ pin ] = level;
+  }
+}
+
+bool HAL_pinRead( uint8_t pin ) {
+  return ( HAL_PINS_MAX > pin ) ? pinLevel[ pin ] : false;
+}
+
+void HAL_spiBegin( halSpi_t * spi ) {
+}
+
+uint16_t HAL_spiRead16( halSpi_t * spi, uint8_t cs, uint32_t frequency ) {
+  return ( NULL != spi->transfer16 ) ? spi->transfer16( cs ) : 0xFFFF;
+}
+
+static void deadlineAfter( struct timespec * deadline, uint32_t timeout ) {
+  clock_gettime( CLOCK_REALTIME, deadline );
+  deadline->tv_sec += timeout / 1000;
+  deadline->tv_nsec += (long)( timeout % 1000 ) * 1000000L;
+  if( 1000000000L <= deadline->tv_nsec ) {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000L;
+  }
+}
+
+void HAL_mutexInit( halMutex_t * mutex ) {
+  pthread_mutex_init( &mutex->handle, NULL );
+}
+
+bool HAL_mutexTake( halMutex_t * mutex, uint32_t timeout ) {
+  struct timespec deadline;
+
+  if( HAL_WAIT_FOREVER == timeout ) {
+    return 0 == pthread_mutex_lock( &mutex->handle );
+  }
+  if( 0 == timeout ) {
+    return 0 == pthread_mutex_trylock( &mutex->handle );
+  }
+
+  deadlineAfter( &deadline, timeout );
+  return 0 == pthread_mutex_timedlock( &mutex->handle, &deadline );
+}
+
+void HAL_mutexGive( halMutex_t * mutex ) {
+  pthread_mutex_unlock( &mutex->handle );
+}
+
+static void * taskEntry( void * arg ) {
+  halTask_t * task = (halTask_t *)arg;
+
+  taskName = task->name;
+  currentTask = task;
+  task->func( task->param );
+  return NULL;
+}
+
+static void simTaskEntry( int idx ) {
+  halTask_t * task = simTasks[ idx ].task;
+
+  task->func( task->param );
+  simTasks[ idx ].wake = HAL_SIM_NEVER;  // returned, never scheduled again
+  swapcontext( &simTasks[ idx ].context, &simScheduler );
+}
+
+static bool simTaskCreate( halTask_t * task ) {
+  simTask_t * sim = &simTasks[ simTaskCount ];
+  void * simStack;
+
+  if( HAL_SIM_TASKS_MAX <= simTaskCount || NULL == ( simStack = malloc( HAL_SIM_STACK_SIZE ) ) ) {
+    return false;
+  }
+
+  getcontext( &sim->context );
+  sim->context.uc_stack.ss_sp = simStack;
+  sim->context.uc_stack.ss_size = HAL_SIM_STACK_SIZE;
+  sim->context.uc_link = NULL;
+  makecontext( &sim->context, (void (*)( void ))simTaskEntry, 1, (int)simTaskCount );
+  sim->task = task;
+  sim->wake = simNow;   // starts in the next HAL_simRun()
+  sim->waiting = false;
+  simTaskCount++;
+  return true;
+}
+
+bool HAL_taskCreate( halTask_t * task, void (* func)( void * ), const char * name, halStack_t * stack, uint32_t stackSize, uint32_t priority, int32_t core ) {
+  task->func = func;
+  task->param = NULL;
+  task->name = name;
+  task->notified = 0;
+  pthread_mutex_init( &task->notifyLock, NULL );
+  pthread_cond_init( &task->notifyCond, NULL );
+
+  if( simEnabled ) {
+    return simTaskCreate( task );
+  }
+
+  if( 0 != pthread_create( &task->handle, NULL, taskEntry, task ) ) {
+    return false;
+  }
+  pthread_detach( task->handle );
+  return true;
+}
+
+const char * HAL_taskName( void ) {
+  return taskName;
+}
+
+void HAL_taskNotify( halTask_t * task, uint32_t bits ) {
+  pthread_mutex_lock( &task->notifyLock );
+  task->notified |= bits;
+  pthread_cond_signal( &task->notifyCond );
+  pthread_mutex_unlock( &task->notifyLock );
+
+  for( uint32_t x=0; x<simTaskCount; x++ ) {
+    if( task == simTasks[x].task && simTasks[x].waiting ) {
+      simTasks[x].wake = simNow;    // runs next, after the caller yields
+    }
+  }
+}
+
+uint32_t HAL_taskWait( uint32_t timeout ) {
+  struct timespec deadline;
+  uint32_t bits;
+
+  if( simEnabled && 0 <= simRunning ) {
+    simTask_t * sim = &simTasks[ simRunning ];
+
+    if( 0 == sim->task->notified ) {    // coroutines share one thread, no locking needed
+      sim->wake = ( HAL_WAIT_FOREVER == timeout ) ? HAL_SIM_NEVER : simNow + timeout * 1000ULL;
+      sim->waiting = true;
+      swapcontext( &sim->context, &simScheduler );
+      sim->waiting = false;
+    }
+    bits = sim->task->notified;
+    sim->task->notified = 0;
+    return bits;
+  }
+
+  halTask_t * task = currentTask;
+  if( NULL == task ) {
+    HAL_delay( timeout );   // not a task, nobody can notify it
+    return 0;
+  }
+
+  pthread_mutex_lock( &task->notifyLock );
+  if( HAL_WAIT_FOREVER == timeout ) {
+    while( 0 == task->notified ) {
+      pthread_cond_wait( &task->notifyCond, &task->notifyLock );
+    }
+  } else {
+    deadlineAfter( &deadline, timeout );
+    while( 0 == task->notified && 0 == pthread_cond_timedwait( &task->notifyCond, &task->notifyLock, &deadline ) ) {
+    }
+  }
+  bits = task->notified;
+  task->notified = 0;
+  pthread_mutex_unlock( &task->notifyLock );
+
+  return bits;
+}
+
+bool HAL_fsMount( bool format ) {
+  return 0 == mkdir( HAL_FLASH_ROOT, 0755 ) || EEXIST == errno;
+}
+
+void HAL_fsUsage( uint32_t * total, uint32_t * used ) {
+  *total = 0;   // host filesystem, not limited by a partition
+  *used = 0;
+}
+
+static void nvsPath( char * path, const char * space, const char * key ) {
+  snprintf( path, HAL_NVS_PATH_LENGTH, HAL_FLASH_ROOT "/%s.%s.nvs", space, key );
+}
+
+bool HAL_nvsGetInt( const char * space, const char * key, int32_t * value ) {
+  char path[ HAL_NVS_PATH_LENGTH ];
+  int32_t stored;
+  bool retVal;
+
+  nvsPath( path, space, key );
+  FILE * f = fopen( path, "r" );
+  if( NULL == f ) {
+    return false;
+  }
+  retVal = ( 1 == fscanf( f, "%d", &stored ) );
+  fclose( f );
+
+  if( retVal ) {
+    *value = stored;
+  }
+  return retVal;
+}
+
+bool HAL_nvsSetInt( const char * space, const char * key, int32_t value ) {
+  char path[ HAL_NVS_PATH_LENGTH ];
+  int32_t stored;
+
+  if( HAL_nvsGetInt( space, key, &stored ) && stored == value ) {
+    return true;
+  }
+  if( !HAL_fsMount( false ) ) {
+    return false;
+  }
+
+  nvsPath( path, space, key );
+  FILE * f = fopen( path, "w" );
+  if( NULL == f ) {
+    return false;
+  }
+  bool retVal = ( 0 < fprintf( f, "%d\n", value ) );
+  return ( 0 == fclose( f ) ) && retVal;
+}
+
+void HAL_print( const char * text ) {
+  fputs( text, stdout );
+  fflush( stdout );
+}
+
+int HAL_printf( const char * format, ... ) {
+  va_list args;
+
+  va_start( args, format );
+  int len = vprintf( format, args );
+  va_end( args );
+
+  fflush( stdout );
+  return len;
+}
+
+void HAL_simEnable( void ) {
+  simEnabled = true;
+}
+
+void HAL_simRun( uint64_t until ) {
+  while( 1 ) {
+    int32_t next = -1;
+
+    for( uint32_t x=0; x<simTaskCount; x++ ) {   // earliest first, creation order for the same time
+      if( until >= simTasks[x].wake && ( 0 > next || simTasks[x].wake < simTasks[ next ].wake ) ) {
+        next = x;
+      }
+    }
+    if( 0 > next ) {
+      break;
+    }
+
+    if( simTasks[ next ].wake > simNow ) {
+      simNow = simTasks[ next ].wake;
+    }
+    simRunning = next;
+    taskName = simTasks[ next ].task->name;
+    swapcontext( &simScheduler, &simTasks[ next ].context );
+    taskName = "main";
+    simRunning = -1;
+  }
+
+  if( until > simNow ) {
+    simNow = until;
+  }
+}
+
+uint64_t HAL_simTime( void ) {
+  return simNow;
+}
+
+#endif  // ARDUINO
@@ -1,9 +1,12 @@
-#include <Arduino.h>
+#include <assert.h>
 #include "heater.h"
 #include "PID.h"
 #include "max6675.h"
 #include "buzzer.h"
-#include "myOTA.h"
+#include "recorder.h"
+#include "logger.h"
+#include "trace.h"
+#include "lockprof.h"
 
 #define BAD_TEMP_CNT_RISE_ERROR 100
 
@@ -25,20 +28,18 @@ static uint32_t           heatingTimePauseStart;
 static volatile float     currentTemperature = 0.0f;
 static heaterDoneCb       funcDoneCB = NULL;
 static uint32_t           failSemaphoreCounter = 0;       // debug purpose only
-static SemaphoreHandle_t  xSemaphore = NULL;
-static StaticSemaphore_t  xMutexBuffer;
-static TaskHandle_t       taskHandle = NULL;
-static StaticTask_t       taskTCB;
-static StackType_t        taskStack[ HEATER_STACK_SIZE ];
+static profLock_t         xLock;                          // mutex with contention statistics
+static halTask_t          task;
+static halStack_t         taskStack[ HEATER_STACK_SIZE ];
 
 static void vTaskHeater( void * pvParameters );
-static void heaterHandle( void );
 
 static void vTaskHeater( void * pvParameters ) {
   static uint8_t badTemparatureCount = 0;
   static uint32_t buzzId;
 
   while( 1 ) {
+    TRACE_POINT( TRACE_HEATER_CYCLE, 0 );
     float currTemp = MAX6675_readCelsius();
 
     if( MIN_ALLOWED_TEMP <= currTemp
@@ -57,17 +58,22 @@ static void vTaskHeater( void * pvParameters ) {
         if( 0 == buzzId ) {
           buzzId = BUZZ_Add( 0, 200, 100, UINT32_MAX );   // buzzing continuously
         }
-        Serial.println( "HEATER(task): max6675 temp read fail\n" );
+        REC_Event( REC_EVENT_TEMP_ERROR );
+        LOG_Printf( LOG_ERROR, "HEATER(task): max6675 temp read fail" );
       }
     }
-    heaterHandle();
+    HEATER_Handle();
 
-    vTaskDelay( PID_INTERVAL_COMPUTE / portTICK_PERIOD_MS );
+    HAL_delay( PID_INTERVAL_COMPUTE );
   }
 }
 
-static void heaterHandle() {
-  if( pdTRUE == xSemaphoreTake( xSemaphore, portMAX_DELAY ) ) {
+void HEATER_Handle( void ) {
+  TRACE_BEGIN( TRACE_HEATER_LOCK, 0 );
+  bool taken = LOCK_Take( &xLock, HAL_WAIT_FOREVER );
+  TRACE_END( TRACE_HEATER_LOCK, 0 );
+
+  if( taken ) {
     switch( heaterState ) {
       case HEATING_STOP: {
         // nothing to do
@@ -75,9 +81,10 @@ static void heaterHandle() {
       }
 
       case HEATING_PROCESSING: {
-        if( millis() >= ( heatingTimeStart + heatingTimeRequested + heatingTimePauseTotal ) ) {  // time is up
+        if( HAL_millis() >= ( heatingTimeStart + heatingTimeRequested + heatingTimePauseTotal ) ) {  // time is up
           PID_Off();
           heaterState = HEATING_STOP;
+          REC_Event( REC_EVENT_DONE );
 
           if( NULL != funcDoneCB ) {
             funcDoneCB();
@@ -86,8 +93,10 @@ static void heaterHandle() {
           break;
         }
 
+        TRACE_BEGIN( TRACE_PID_COMPUTE, 0 );
         PID_updateTemp( (double)currentTemperature );
         PID_Compute();
+        TRACE_END( TRACE_PID_COMPUTE, 0 );
         break;
       }
 
@@ -97,23 +106,28 @@ static void heaterHandle() {
       }
     }
 
-    xSemaphoreGive( xSemaphore );
+    float sampleTemp = currentTemperature;
+    uint16_t sampleSetpoint = heatingTempRequested;
+    uint8_t samplePower = PID_getOutputPercentage();
+    uint8_t sampleState = heaterState;
+    LOCK_Give( &xLock );
+
+    REC_Sample( sampleTemp, sampleSetpoint, samplePower, sampleState );   // only during the run, heater task is the only producer
   } else {
     failSemaphoreCounter++;
-    Serial.println( "HEATER(Handle): couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "HEATER(Handle): couldn't take semaphore %u times", failSemaphoreCounter );
   }
 }
 
-void HEATER_Init( SPIClass * spi ) {
+void HEATER_Init( halSpi_t * spi ) {
   if( true == initialized ) {
     return;
   }
 
-  xSemaphore = xSemaphoreCreateMutexStatic( &xMutexBuffer );
-  assert( xSemaphore );
+  LOCK_Init( &xLock, "heater" );
 
-  taskHandle = xTaskCreateStatic( vTaskHeater, "Heater", HEATER_STACK_SIZE, NULL, HEATER_TASK_PRIORITY, taskStack, &taskTCB );
-  assert( taskHandle );
+  bool created = HAL_taskCreate( &task, vTaskHeater, "Heater", taskStack, HEATER_STACK_SIZE, HEATER_TASK_PRIORITY, HAL_CORE_ANY );
+  assert( created );
 
   PID_Init();
   MAX6675_Init( spi, HEATER_MAX6675_CS );
@@ -126,13 +140,13 @@ void HEATER_setTemperature( uint16_t temp ) {
     return;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, portMAX_DELAY ) ) {
+  if( LOCK_Take( &xLock, HAL_WAIT_FOREVER ) ) {
     heatingTempRequested = ( MAX_ALLOWED_TEMP < temp ) ? MAX_ALLOWED_TEMP : temp;
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "HEATER(setTemperature): couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "HEATER(setTemperature): couldn't take semaphore %u times", failSemaphoreCounter );
   }
 }
 
@@ -141,13 +155,13 @@ void HEATER_setTime( uint32_t time ) {
     return;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, portMAX_DELAY ) ) {
+  if( LOCK_Take( &xLock, HAL_WAIT_FOREVER ) ) {
     heatingTimeRequested = time;
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "HEATER(setTime): couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "HEATER(setTime): couldn't take semaphore %u times", failSemaphoreCounter );
   }
 }
 
@@ -165,14 +179,15 @@ void HEATER_start( void ) {
     return;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, portMAX_DELAY ) ) {
+  if( LOCK_Take( &xLock, HAL_WAIT_FOREVER ) ) {
     switch( heaterState ) {
       case HEATING_STOP: {
         PID_SetPoint( heatingTempRequested );
-        heatingTimeStart = millis();
+        heatingTimeStart = HAL_millis();
         heatingTimePauseTotal = 0;
         PID_On();
         heaterState = HEATING_PROCESSING;
+        REC_Event( REC_EVENT_START );
         break;
       }
 
@@ -183,10 +198,10 @@ void HEATER_start( void ) {
       }
     }
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "HEATER(start): couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "HEATER(start): couldn't take semaphore %u times", failSemaphoreCounter );
   }
 }
 
@@ -195,21 +210,23 @@ void HEATER_pause( void ) {
     return;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, portMAX_DELAY ) ) {
+  if( LOCK_Take( &xLock, HAL_WAIT_FOREVER ) ) {
     switch( heaterState ) {
       case HEATING_PROCESSING: {
         PID_Off();
-        heatingTimePauseStart = millis();
+        heatingTimePauseStart = HAL_millis();
         heaterState = HEATING_PAUSE;
+        REC_Event( REC_EVENT_PAUSE );
         break;
       }
 
       case HEATING_PAUSE: {
         // recontinue processing
         PID_On();
-        heatingTimePauseTotal += ( millis() - heatingTimePauseStart );
-        Serial.printf( "Pause time total: %d\n", heatingTimePauseTotal );
+        heatingTimePauseTotal += ( HAL_millis() - heatingTimePauseStart );
+        LOG_Printf( LOG_INFO, "Pause time total: %u", heatingTimePauseTotal );
         heaterState = HEATING_PROCESSING;
+        REC_Event( REC_EVENT_RESUME );
         break;
       }
 
@@ -219,10 +236,10 @@ void HEATER_pause( void ) {
       }
     }
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "HEATER(pause): couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "HEATER(pause): couldn't take semaphore %u times", failSemaphoreCounter );
   }
 }
 
@@ -231,12 +248,13 @@ void HEATER_stop( void ) {
     return;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, portMAX_DELAY ) ) {
+  if( LOCK_Take( &xLock, HAL_WAIT_FOREVER ) ) {
     switch( heaterState ) {
       case HEATING_PROCESSING:
       case HEATING_PAUSE: {
         PID_Off();
         heaterState = HEATING_STOP;
+        REC_Event( REC_EVENT_STOP );
         break;
       }
 
@@ -246,10 +264,10 @@ void HEATER_stop( void ) {
       }
     }
 
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "HEATER(stop): couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "HEATER(stop): couldn't take semaphore %u times", failSemaphoreCounter );
   }
 }
 
@@ -274,7 +292,7 @@ uint32_t HEATER_getTimeRemaining() {
     return 0;
   }
 
-  if( pdTRUE == xSemaphoreTake( xSemaphore, portMAX_DELAY ) ) {
+  if( LOCK_Take( &xLock, HAL_WAIT_FOREVER ) ) {
     switch( heaterState ) {
       case HEATING_STOP: {
         // nothing to do
@@ -282,7 +300,7 @@ uint32_t HEATER_getTimeRemaining() {
       }
 
       case HEATING_PROCESSING: {
-        result = heatingTimeRequested - ( millis() - ( heatingTimeStart + heatingTimePauseTotal ));
+        result = heatingTimeRequested - ( HAL_millis() - ( heatingTimeStart + heatingTimePauseTotal ));
         break;
       }
 
@@ -291,10 +309,10 @@ uint32_t HEATER_getTimeRemaining() {
         break;
       }
     }
-    xSemaphoreGive( xSemaphore );
+    LOCK_Give( &xLock );
   } else {
     failSemaphoreCounter++;
-    Serial.println( "HEATER(getTimeRemaining): couldn't take semaphore " + (String)failSemaphoreCounter + " times" );
+    LOG_Printf( LOG_ERROR, "HEATER(getTimeRemaining): couldn't take semaphore %u times", failSemaphoreCounter );
   }
 
   return ( 0 > result ) ? 0 : (uint32_t)result;
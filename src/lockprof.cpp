@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+#include "lockprof.h"
+
+static profLock_t       * lockList = NULL;    // registered during init, read only afterwards
+static const char         siteOther[] = "other";
+
+static uint32_t bucket( uint32_t us ) {
+  uint32_t idx = 0;
+
+  for( uint32_t limit = 16; idx < LOCK_HIST_BUCKETS - 1 && us >= limit; limit <<= 2 ) {
+    idx++;
+  }
+  return idx;
+}
+
+static int32_t siteFind( lockStats_t * stats, const char * site, const char * task ) {
+  for( int x=0; x<LOCK_SITES_MAX; x++ ) {
+    if( NULL == stats->site[x].site ) {
+      stats->site[x].site = site;
+      stats->site[x].task = task;
+      return x;
+    }
+    if( site == stats->site[x].site && task == stats->site[x].task ) {
+      return x;
+    }
+  }
+  return -1;
+}
+
+void LOCK_Init( profLock_t * lock, const char * name ) {
+  memset( lock, 0, sizeof( profLock_t ) );
+  HAL_mutexInit( &lock->mutex );
+  lock->name = name;
+  lock->siteIdx = -1;
+
+  lock->next = lockList;
+  lockList = lock;
+}
+
+bool LOCK_TakeFrom( profLock_t * lock, uint32_t timeout, const char * site ) {
+  uint32_t start = HAL_micros();
+  const char * holderSite = NULL;
+  int32_t holderIdx = -1;
+  uint32_t wait = 0;
+
+  if( !HAL_mutexTake( &lock->mutex, 0 ) ) {
+    holderSite = __atomic_load_n( &lock->ownerSite, __ATOMIC_RELAXED );   // may be just released, good enough for statistics
+    holderIdx = __atomic_load_n( &lock->siteIdx, __ATOMIC_RELAXED );
+
+    if( 0 == timeout || !HAL_mutexTake( &lock->mutex, timeout ) ) {
+      __atomic_fetch_add( &lock->stats.timeouts, 1, __ATOMIC_RELAXED );
+      return false;
+    }
+    wait = HAL_micros() - start;
+  }
+
+  lockStats_t * stats = &lock->stats;   // guarded from here on
+  const char * task = HAL_taskName();
+
+  stats->takes++;
+  if( NULL != holderSite || 0 < wait ) {
+    stats->contended++;
+    stats->waitHist[ bucket( wait ) ]++;
+    if( wait > stats->waitMax ) {
+      stats->waitMax = wait;
+      stats->waitMaxSite = site;
+      stats->waitMaxHolder = holderSite;
+    }
+    if( 0 <= holderIdx && LOCK_SITES_MAX > holderIdx ) {
+      lockSite_t * holder = &stats->site[ holderIdx ];
+      holder->blockedCount++;
+      if( wait > holder->blockedMax ) {
+        holder->blockedMax = wait;
+      }
+    }
+  }
+
+  lock->siteIdx = siteFind( stats, site, task );
+  lock->ownerTask = task;
+  __atomic_store_n( &lock->ownerSite, site, __ATOMIC_RELAXED );
+  lock->takenAt = HAL_micros();
+  return true;
+}
+
+void LOCK_Give( profLock_t * lock ) {
+  lockStats_t * stats = &lock->stats;
+  uint32_t hold = HAL_micros() - lock->takenAt;
+
+  stats->holdHist[ bucket( hold ) ]++;
+  if( 0 <= lock->siteIdx ) {
+    lockSite_t * site = &stats->site[ lock->siteIdx ];
+    site->count++;
+    site->holdTotal += hold;
+    if( hold > site->holdMax ) {
+      site->holdMax = hold;
+    }
+  } else {
+    stats->otherCount++;
+  }
+
+  __atomic_store_n( &lock->ownerSite, NULL, __ATOMIC_RELAXED );
+  lock->siteIdx = -1;
+  HAL_mutexGive( &lock->mutex );
+}
+
+// statistics are copied/cleared by taking the mutex directly, the report itself is not recorded
+static bool statsAccess( profLock_t * lock, lockStats_t * copy ) {
+  if( !HAL_mutexTake( &lock->mutex, 100 ) ) {
+    return false;
+  }
+
+  if( NULL != copy ) {
+    *copy = lock->stats;
+    copy->timeouts = __atomic_load_n( &lock->stats.timeouts, __ATOMIC_RELAXED );
+  } else {
+    memset( &lock->stats, 0, sizeof( lockStats_t ) );
+  }
+  HAL_mutexGive( &lock->mutex );
+  return true;
+}
+
+void LOCK_Reset( void ) {
+  for( profLock_t * lock = lockList; NULL != lock; lock = lock->next ) {
+    statsAccess( lock, NULL );
+  }
+}
+
+uint32_t LOCK_format( char * buf, uint32_t size ) {
+  static lockStats_t stats;     // too big for the stack, report is made from one task at a time
+  static const char * bucketName[ LOCK_HIST_BUCKETS ] = { "<16u", "<64u", "<256u", "<1m", "<4m", "<16m", "<64m", ">64m" };
+  uint32_t len = 0;
+
+  buf[0] = 0;
+
+#define LOCK_APPEND( ... ) do { if( len < size ) { len += snprintf( buf + len, size - len, __VA_ARGS__ ); } } while( 0 )
+  for( profLock_t * lock = lockList; NULL != lock; lock = lock->next ) {
+    if( false == statsAccess( lock, &stats ) ) {
+      LOCK_APPEND( "%s: busy\n", lock->name );
+      continue;
+    }
+
+    LOCK_APPEND( "%s: %u takes, %u contended, %u timeouts, max wait %u[us]", lock->name, stats.takes, stats.contended, stats.timeouts, stats.waitMax );
+    if( NULL != stats.waitMaxSite ) {
+      LOCK_APPEND( " (%s behind %s)", stats.waitMaxSite, ( NULL != stats.waitMaxHolder ) ? stats.waitMaxHolder : "?" );
+    }
+    LOCK_APPEND( "\n%-6s", "" );
+    for( int x=0; x<LOCK_HIST_BUCKETS; x++ ) {
+      LOCK_APPEND( "%7s", bucketName[x] );
+    }
+    LOCK_APPEND( "\n%-6s", "wait" );
+    for( int x=0; x<LOCK_HIST_BUCKETS; x++ ) {
+      LOCK_APPEND( "%7u", stats.waitHist[x] );
+    }
+    LOCK_APPEND( "\n%-6s", "hold" );
+    for( int x=0; x<LOCK_HIST_BUCKETS; x++ ) {
+      LOCK_APPEND( "%7u", stats.holdHist[x] );
+    }
+    LOCK_APPEND( "\n  %-24s %-10s %7s %8s %8s %7s %8s\n", "site", "task", "count", "avg[us]", "max[us]", "blocked", "max[us]" );
+    for( int x=0; x<LOCK_SITES_MAX && NULL != stats.site[x].site; x++ ) {
+      const lockSite_t * site = &stats.site[x];
+      LOCK_APPEND( "  %-24s %-10s %7u %8u %8u %7u %8u\n", site->site, site->task, site->count,
+                   ( 0 < site->count ) ? (uint32_t)( site->holdTotal / site->count ) : 0, site->holdMax, site->blockedCount, site->blockedMax );
+    }
+    if( 0 < stats.otherCount ) {
+      LOCK_APPEND( "  %-24s %-10s %7u\n", siteOther, "", stats.otherCount );
+    }
+  }
+#undef LOCK_APPEND
+
+  return ( len < size ) ? len : size - 1;
+}
@@ -0,0 +1,119 @@
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include "logger.h"
+#include "hal.h"
+
+typedef struct {
+  uint32_t  turn;                       // sequence number of the slot minus its index (0 = free for first round)
+  uint8_t   level;
+  char      text[ LOG_TEXT_LENGTH ];    // message with new line
+} logRecord_t;
+
+// bounded multi-producer queue, every slot carries sequence number telling whether it is free or filled
+static logRecord_t        records[ LOG_QUEUE_LENGTH ];
+static uint32_t           enqueuePos = 0;       // claimed by producers with compare-and-swap
+static uint32_t           dequeuePos = 0;       // output task only
+static uint32_t           dropped = 0;          // messages lost because of full queue
+static logLevel           currentLevel = LOG_INFO;
+static bool               initialized = false;
+static logSinkCb          sink = NULL;
+static halTask_t          task;
+static halStack_t         taskStack[ LOG_STACK_SIZE ];
+
+static inline uint32_t slotSequence( uint32_t idx ) {
+  return __atomic_load_n( &records[ idx ].turn, __ATOMIC_ACQUIRE ) + idx;
+}
+
+static inline void slotPublish( uint32_t idx, uint32_t sequence ) {
+  __atomic_store_n( &records[ idx ].turn, sequence - idx, __ATOMIC_RELEASE );
+}
+
+static void vTaskLog( void * pvParameters ) {
+  while( 1 ) {
+    while( 1 ) {
+      uint32_t idx = dequeuePos & ( LOG_QUEUE_LENGTH - 1 );
+
+      if( slotSequence( idx ) != dequeuePos + 1 ) {
+        break;    // empty or producer still formatting
+      }
+
+      HAL_print( records[ idx ].text );
+      if( NULL != sink ) {
+        sink( records[ idx ].text );
+      }
+      slotPublish( idx, dequeuePos + LOG_QUEUE_LENGTH );   // free for producers
+      dequeuePos++;
+    }
+
+    uint32_t lost = __atomic_exchange_n( &dropped, 0, __ATOMIC_ACQ_REL );
+    if( 0 < lost ) {
+      HAL_printf( "LOG: %u messages dropped\n", lost );
+    }
+
+    HAL_delay( LOG_DRAIN_PERIOD );
+  }
+}
+
+void LOG_Init( void ) {
+  if( initialized ) {
+    return;
+  }
+
+  bool created = HAL_taskCreate( &task, vTaskLog, "Log", taskStack, LOG_STACK_SIZE, LOG_TASK_PRIORITY, 0 );
+  assert( created );
+
+  initialized = true;
+}
+
+void LOG_setLevel( logLevel level ) {
+  currentLevel = level;
+}
+
+void LOG_setSink( logSinkCb func ) {
+  sink = func;
+}
+
+bool LOG_Printf( logLevel level, const char * format, ... ) {
+  uint32_t pos = __atomic_load_n( &enqueuePos, __ATOMIC_RELAXED );
+  uint32_t idx;
+  int len;
+  va_list args;
+
+  if( level > currentLevel ) {
+    return false;
+  }
+
+  // claim a slot
+  while( 1 ) {
+    idx = pos & ( LOG_QUEUE_LENGTH - 1 );
+    int32_t diff = (int32_t)( slotSequence( idx ) - pos );
+
+    if( 0 == diff ) {
+      if( __atomic_compare_exchange_n( &enqueuePos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+        break;
+      }
+    } else if( 0 > diff ) {
+      __atomic_fetch_add( &dropped, 1, __ATOMIC_RELAXED );   // queue full, never wait
+      return false;
+    } else {
+      pos = __atomic_load_n( &enqueuePos, __ATOMIC_RELAXED );
+    }
+  }
+
+  va_start( args, format );
+  len = vsnprintf( records[ idx ].text, LOG_TEXT_LENGTH - 1, format, args );
+  va_end( args );
+
+  if( 0 > len ) {
+    len = 0;
+  } else if( LOG_TEXT_LENGTH - 2 < len ) {
+    len = LOG_TEXT_LENGTH - 2;    // truncated
+  }
+  records[ idx ].text[ len ] = '\n';
+  records[ idx ].text[ len + 1 ] = '\0';
+  records[ idx ].level = level;
+
+  slotPublish( idx, pos + 1 );
+  return true;
+}
@@ -5,25 +5,27 @@
 #include "buzzer.h"
 #include "helper.h"
 #include "config.h"
-
-heater_state heaterState = STATE_IDLE;
-heater_state heaterStateRequested = STATE_IDLE;
-event_state specialEventState = EVENT_STATE_IDLE;
-unsigned long currentTime, lastCurrentTime, next1S, next100mS, eventHandlingStart;
-static uint32_t targetHeatingTime;    // in miliseconds
-static uint16_t targetHeatingTemp;
-static int32_t specialEventCode;
-static uint32_t specialEventValue;
-static uint32_t eventBuzzing;
-static bakeName *bakeNames = NULL;
-static uint32_t bakeCount;
-static uint32_t bakeIdx;
-static uint32_t bakeStep;             // currently running step (from Bake's curve) count from 0
-static bool manualOperation;
-static bool specialEvent = false;
-static volatile bool heatingDoneTriggered = false;
-static volatile bool otaStateChangedTriggered = false;
-static volatile bool otaStateStatus;
+#include "sdcard.h"
+#include "persist.h"
+#include "recorder.h"
+#include "logger.h"
+#include "shell.h"
+#include "telemetry.h"
+#include "mqtt.h"
+#include "stats.h"
+#include "trace.h"
+#include "lockprof.h"
+#include "bench.h"
+#include "controller.h"
+
+// bake state is owned by the controller task (controller.cpp), GUI, shell and OTA only read its status
+static uint32_t bakeListGeneration;  // bake list generation shown on the screen
+static char bakeFilter[ BAKE_FILTER_LENGTH ] = "";  // bake search text typed on the screen
+static char statsReport[ STATS_REPORT_LENGTH ];   // shell and diagnostics page
+static char lockReport[ LOCK_REPORT_LENGTH ];     // shell only
+static bool bakesAddRequested = false;    // set by GUI option, bake list is imported by loop() (the task editing the list)
+static bool otaStatePending = false;      // set by OTA task, handled by loop() (GUI owner)
+static bool otaStateReported;
 // populate GUI options
 static setting_t settings[] = {     // preserve order according to optionType enum
   { "Buzzer activation", OPT_VAL_BOOL, 1, NULL },
@@ -33,268 +35,489 @@ static setting_t settings[] = {     // preserve order according to optionType en
 };
 
 
-static void updateTime( uint32_t time ) {
-  targetHeatingTime = time;
-  manualOperation = true;
+static void buzzerActivationHandle() {
+  if( true == settings[ OPTION_BUZZER ].currentValue.bValue ) {
+    Serial.println( "BUZZER deactivated" );
+    settings[ OPTION_BUZZER ].currentValue.bValue = false;
+  } else {
+    Serial.println( "BUZZER activated" );
+    settings[ OPTION_BUZZER ].currentValue.bValue = true;
+  }
+
+  BUZZ_Activate( settings[ OPTION_BUZZER ].currentValue.bValue );
+  GUI_setSoundIcon( settings[ OPTION_BUZZER ].currentValue.bValue );
+  GUI_updateOption( settings[ OPTION_BUZZER ] );
+  // GUI_SetTabActive( 0 );
+}
 
-  if( MAX_ALLOWED_TIME < targetHeatingTime ) {
-    targetHeatingTime = MAX_ALLOWED_TIME;
+static void otaToggleStateHandle() {
+  if( true == settings[ OPTION_OTA ].currentValue.bValue ) {
+    settings[ OPTION_OTA ].currentValue.bValue = false;
+  } else {
+    settings[ OPTION_OTA ].currentValue.bValue = true;
   }
 
-  GUI_SetTargetTime( targetHeatingTime );
+  OTA_Activate( settings[ OPTION_OTA ].currentValue.bValue );
+  GUI_updateOption( settings[ OPTION_OTA ] );
+  // GUI_SetTabActive( 0 );
 }
 
-static void updateTemp( uint16_t temp ) {
-  targetHeatingTemp = temp;
-  manualOperation = true;
+// loop() only, same task as other bake list edits and the list on the screen
+static void addBakesHandle() {
+  Serial.println( "Reloading Bakes file..." );
+  CONF_addBakesFromFile();
+  Serial.printf( "new bakeCount: %d", CONF_getBakeCount() );
+  GUI_SetTabActive( 1 );    // list itself is refreshed from loop() when bake list generation changes
+}
 
-  if( MAX_ALLOWED_TEMP < targetHeatingTemp ) {
-    targetHeatingTemp = MAX_ALLOWED_TEMP;
+// called from outside (persistence worker)
+static void settingsStored( bool success ) {
+  Serial.printf( "Settings %s\n", success ? "stored" : "NOT stored!" );
+  if( !success ) {
+    BUZZ_Add( 0, 80, 100, 3 );
   }
-  if( MIN_ALLOWED_TEMP > targetHeatingTemp ) {
-    targetHeatingTemp = MIN_ALLOWED_TEMP;
+}
+
+static void storeSettingsHandle() {
+  CONF_setOptionBool( CONF_OPT_BUZZER, settings[ OPTION_BUZZER ].currentValue.bValue );
+  CONF_setOptionBool( CONF_OPT_OTA, settings[ OPTION_OTA ].currentValue.bValue );
+  Serial.printf( "Saved options:\nOPTION_BUZZER: %d\nOPTION_OTA: %d\n", settings[ OPTION_BUZZER ].currentValue.bValue, settings[ OPTION_OTA ].currentValue.bValue );
+  CONF_flush( settingsStored );   // written in background, UI and heater keep running
+}
+
+static void applyBakeFilter() {
+  uint32_t count = CONF_getBakeCount();
+  uint16_t * found;
+
+  if( '\0' == bakeFilter[0] || 0 == count ) {
+    GUI_filterBakeList( NULL, 0 );
+    return;
+  }
+
+  found = (uint16_t *)malloc( count * sizeof( uint16_t ) );
+  if( NULL == found ) {
+    Serial.println( "Bake filter: Malloc failed" );
+    GUI_filterBakeList( NULL, 0 );
+    return;
   }
 
-  GUI_SetTargetTemp( targetHeatingTemp );
+  uint32_t foundCount = CONF_findBakes( bakeFilter, found, count );
+
+  GUI_filterBakeList( found, foundCount );
+  free( found );
+}
+
+static void filterBakes( const char * query ) {
+  strlcpy( bakeFilter, query, sizeof( bakeFilter ) );
+  applyBakeFilter();
+}
+
+static void refreshBakeList() {
+  bakeListGeneration = CONF_getBakeListGeneration();
+  GUI_populateBakeListNames( CONF_getBakeName, CONF_getBakeCount() );
+  if( '\0' != bakeFilter[0] ) {
+    applyBakeFilter();  // new list rows are all visible
+  }
+}
+
+static void removeBakes( const uint16_t * list, uint32_t count ) {
+  if( NULL == list ) {
+    Serial.println( "Remove bakes: NULL pointer error" );
+    return;
+  }
+
+  if( !CONF_removeBakes( list, count ) ) {
+    Serial.println( "Remove bakes: nothing removed" );
+  }
+}
+
+static void swapBakes( uint32_t first, uint32_t second ) {
+  if( !CONF_swapBakes( first, second ) ) {
+    Serial.println( "Swap bakes: two valid indexes required" );
+  }
+}
+
+static void moveBake( uint32_t from, uint32_t to ) {
+  if( !CONF_moveBake( from, to ) ) {
+    Serial.println( "Move bake: two valid indexes required" );
+  }
+}
+
+static void otaStateChangedHandle( bool otaStateStatus ) {
+  Serial.printf( "WiFi changed state to: %s\n", otaStateStatus?"connected":"disconnected" );
+  settings[ OPTION_OTA ].currentValue.bValue = otaStateStatus;
+  // update GUI icons
+  GUI_setWiFiIcon( settings[ OPTION_OTA ].currentValue.bValue );
+  GUI_updateOption( settings[ OPTION_OTA ] );
+  TELEM_Activate( otaStateStatus );
+  MQTT_Activate( otaStateStatus );
+}
+
+static void optionHandle( uint32_t option ) {
+  switch( option ) {
+    case OPTION_BUZZER: {
+      buzzerActivationHandle();
+      break;
+    }
+    case OPTION_OTA: {
+      otaToggleStateHandle();
+      break;
+    }
+    case OPTION_SAVE: {
+      storeSettingsHandle();
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+// called from GUI and shell in loop(), handled by controller task
+static void updateTime( uint32_t time ) {
+  CTRL_Post( CTRL_EVT_SET_TIME, (int32_t)time, 0 );
+}
+
+static void updateTemp( uint16_t temp ) {
+  CTRL_Post( CTRL_EVT_SET_TEMP, temp, 0 );
 }
 
 static void heatingStart() {
-  heaterStateRequested = STATE_START_REQUESTED;
+  CTRL_Post( CTRL_EVT_START, 0, 0 );
 }
 
 static void heatingStop() {
-  heaterStateRequested = STATE_STOP_REQUESTED;
+  CTRL_Post( CTRL_EVT_STOP, 0, 0 );
 }
 
 static void heatingPause() {
-  heaterStateRequested = STATE_PAUSE_REQUESTED;
+  CTRL_Post( CTRL_EVT_PAUSE, 0, 0 );
 }
 
 static void bakePickup( uint32_t idx, bool longPress ) {
-  if( STATE_IDLE == heaterState ) {
-    int32_t tmp_targetHeatingTime;
-    bakeIdx = idx;
-    bakeStep = 0;     // start from first step in "bake's curve"
-    manualOperation = false;
-
-    targetHeatingTime = 0;
-    specialEvent = false;
-    specialEventCode = 0;
-    specialEventValue = 0;
-
-    targetHeatingTemp = (uint16_t)CONF_getBakeTemp( bakeIdx, bakeStep );
-
-    tmp_targetHeatingTime = CONF_getBakeTime( bakeIdx, bakeStep );
-    if( 0 < tmp_targetHeatingTime ) {
-      targetHeatingTime = (uint32_t)SECONDS_TO_MILISECONDS( tmp_targetHeatingTime );
-    } else if( 0 > tmp_targetHeatingTime ) {  // special case: first step is an event
-      specialEvent = true;
-      targetHeatingTemp = 0;
-      specialEventCode = tmp_targetHeatingTime;
-      specialEventValue = CONF_getBakeTemp( bakeIdx, bakeStep );   // temp has different meaning in special event
-    } else {
-      targetHeatingTemp = 0;
-      Serial.printf( "CONTROLLER(bakePickup): Bake item incorrect!\n" );
-      BUZZ_Add( 0, 80, 100, 10 );
-      GUI_SetTargetTemp( 0 );
-      GUI_SetTargetTime( 0 );
-      return;
-    }
+  CTRL_Post( CTRL_EVT_BAKE_PICKUP, (int32_t)idx, longPress );
+}
 
-    GUI_SetTargetTemp( targetHeatingTemp );
-    GUI_SetTargetTime( targetHeatingTime );
-    GUI_setBakeName( CONF_getBakeName( bakeIdx ) );
+static void adjustTime( int32_t time ) {
+  CTRL_Post( CTRL_EVT_ADJUST_TIME, time, 0 );
+}
 
-    if( longPress ) {
-      heaterStateRequested = STATE_START_REQUESTED;
-    }
+// options are GUI callbacks, they run in loop() and don't touch bake state
+static void buzzerActivation() {
+  optionHandle( OPTION_BUZZER );
+}
 
-    Serial.printf( "Bake pickup[%d]:\"%s\"; Steps:%d\n", bakeIdx + 1, CONF_getBakeName( bakeIdx ), CONF_getBakeStepCount( bakeIdx ) );
-  } else {
-    BUZZ_Add( 0, 80, 100, 3 );
-  }
+static void otaToggleState() {
+  optionHandle( OPTION_OTA );
+}
 
-  GUI_SetTabActive( TAB_MAIN );
+// handled outside of GUI event callback (bake list has to be edited from one task)
+static void addBakes() {
+  __atomic_store_n( &bakesAddRequested, true, __ATOMIC_RELEASE );
 }
 
-static void buzzerActivation() {
-  if( true == settings[ OPTION_BUZZER ].currentValue.bValue ) {
-    Serial.println( "BUZZER deactivated" );
-    settings[ OPTION_BUZZER ].currentValue.bValue = false;
+static void storeSettings() {
+  optionHandle( OPTION_SAVE );
+}
+
+// called by OTA task, GUI is updated by loop()
+static void otaStateChanged( bool otaState ) {
+  __atomic_store_n( &otaStateReported, otaState, __ATOMIC_RELAXED );
+  __atomic_store_n( &otaStatePending, true, __ATOMIC_RELEASE );
+}
+
+// bake state changes, called by controller task
+static void bakeEvent( const char * name, int32_t value ) {
+  MQTT_Event( name, value );
+}
+
+// shell commands (executed from loop(), same way as GUI callbacks; state is only read, changes are posted to controller)
+static void cmdStatus( int argc, char * argv[] ) {
+  static const char * stateNames[ STATE_MAX ] = { "idle", "start requested", "heating", "next step requested",
+                                                  "pause requested", "paused", "stop requested", "special event" };
+
+  ctrlStatus_t ctrl;
+
+  CTRL_getStatus( &ctrl );
+  SHELL_Printf( "State: %s\n", stateNames[ ctrl.state ] );
+  SHELL_Printf( "Temp: %.1f/%u[C], power: %u[%%]\n", HEATER_getCurrentTemperature(), ctrl.targetTemp, HEATER_getCurrentPower() );
+  SHELL_Printf( "Time remaining: %u/%u[s]\n", HEATER_getTimeRemaining() / 1000, ctrl.targetTime / 1000 );
+  if( ctrl.manual ) {
+    SHELL_Printf( "Manual operation\n" );
   } else {
-    Serial.println( "BUZZER activated" );
-    settings[ OPTION_BUZZER ].currentValue.bValue = true;
+    SHELL_Printf( "Bake[%u]: \"%s\", step %u/%u, total %u[s]\n", ctrl.bakeIdx + 1, ctrl.bakeName, ctrl.step + 1, ctrl.steps, ctrl.totalTime / 1000 );
   }
+}
 
-  BUZZ_Activate( settings[ OPTION_BUZZER ].currentValue.bValue );
-  GUI_setSoundIcon( settings[ OPTION_BUZZER ].currentValue.bValue );
-  GUI_updateOption( settings[ OPTION_BUZZER ] );
-  // GUI_SetTabActive( 0 );
+static void cmdTemp( int argc, char * argv[] ) {
+  if( 2 != argc ) {
+    SHELL_Printf( "Temperature required\n" );
+  } else {
+    updateTemp( (uint16_t)atoi( argv[1] ) );   // limited (ignored while heating) by controller, see 'status'
+    SHELL_Printf( "Target temp %u[C] requested\n", atoi( argv[1] ) );
+  }
 }
 
-static void otaToggleState() {
-  if( true == settings[ OPTION_OTA ].currentValue.bValue ) {
-    settings[ OPTION_OTA ].currentValue.bValue = false;
+static void cmdTime( int argc, char * argv[] ) {
+  uint32_t minutes, seconds = 0;
+
+  if( 2 != argc || 1 > sscanf( argv[1], "%u:%u", &minutes, &seconds ) ) {
+    SHELL_Printf( "Time required (mm[:ss])\n" );
   } else {
-    settings[ OPTION_OTA ].currentValue.bValue = true;
+    updateTime( (uint32_t)SECONDS_TO_MILISECONDS( MINUTES_TO_SECONDS( minutes ) + seconds ) );
+    SHELL_Printf( "Target time %u[s] requested\n", MINUTES_TO_SECONDS( minutes ) + seconds );
   }
+}
 
-  OTA_Activate( settings[ OPTION_OTA ].currentValue.bValue );
-  GUI_updateOption( settings[ OPTION_OTA ] );
-  // GUI_SetTabActive( 0 );
+// state is checked by controller when it takes the command, see 'status'
+static void cmdStart( int argc, char * argv[] ) {
+  heatingStart();
+  SHELL_Printf( "Start requested\n" );
 }
 
-static void addBakes() {
-  Serial.println( "Reloading Bakes file..." );
-  CONF_addBakesFromFile();
-  free( bakeNames );
-  CONF_getBakeNames( &bakeNames, &bakeCount );
-  Serial.printf( "new bakeCount: %d", bakeCount );
-  GUI_populateBakeListNames( (char *)bakeNames, BAKE_NAME_LENGTH, bakeCount );
-  GUI_SetTabActive( 1 );
+static void cmdPause( int argc, char * argv[] ) {
+  heatingPause();   // same as GUI button: pause or continue
+  SHELL_Printf( "Pause/continue requested\n" );
 }
 
-static void storeSettings() {
-  CONF_setOptionBool( (int32_t)OPTION_BUZZER, settings[ OPTION_BUZZER ].currentValue.bValue );
-  CONF_setOptionBool( (int32_t)OPTION_OTA, settings[ OPTION_OTA ].currentValue.bValue );
-  Serial.printf( "Saved options:\nOPTION_BUZZER: %d\nOPTION_OTA: %d\n", settings[ OPTION_BUZZER ].currentValue.bValue, settings[ OPTION_OTA ].currentValue.bValue );
-  CONF_storeBakeList();
+static void cmdStop( int argc, char * argv[] ) {
+  heatingStop();
+  SHELL_Printf( "Stop requested\n" );
 }
 
-static void adjustTime( int32_t time ) {
-  int32_t newTime = targetHeatingTime + MINUTE_TO_MILLIS( time );
-  Serial.printf( "Adjust Time: %d[min]\n", time );
+static void cmdBake( int argc, char * argv[] ) {
+  uint32_t idx = ( 2 == argc ) ? atoi( argv[1] ) : 0;
 
-  if( 0 < newTime && MAX_ALLOWED_TIME > newTime ) {
-    targetHeatingTime = newTime;
-    GUI_SetTargetTime( targetHeatingTime );
+  if( 0 == idx || CONF_getBakeCount() < idx ) {
+    SHELL_Printf( "Bake number 1-%u required\n", CONF_getBakeCount() );
+  } else {
+    char name[ BAKE_NAME_LENGTH ];
 
-    if( STATE_HEATING == heaterState
-    || STATE_HEATING_PAUSE == heaterState ) {
-      HEATER_setTime( targetHeatingTime );
-    }
+    bakePickup( idx - 1, false );   // refused by controller while heating
+    SHELL_Printf( "Bake[%u]: \"%s\" requested\n", idx, CONF_getBakeName( idx - 1, name, sizeof( name ) ) ? name : "" );
   }
 }
 
-static void removeBakes( const uint8_t * list ) {
-  uint8_t arr[ BAKES_TO_REMOVE_MAX ] = { 0 };
-  uint32_t idx = 0;
-
-  if( NULL == list ) {
-    Serial.println( "Remove bakes: NULL pointer error" );
-    return;
-  }
+static void cmdBakes( int argc, char * argv[] ) {
+  uint16_t found[ 20 ];
+  char name[ BAKE_NAME_LENGTH ];
+  uint32_t count = CONF_findBakes( ( 2 <= argc ) ? argv[1] : "", found, sizeof( found ) / sizeof( found[0] ) );
 
-  for( int x=0; x<BAKES_TO_REMOVE_MAX; x++ ) {
-    if( 0 < list[x] ) {
-      arr[idx] = list[x] - 1; // arr have elements counted from 0
-      idx++;
+  for( int x=0; x<count; x++ ) {
+    if( CONF_getBakeName( found[x], name, sizeof( name ) ) ) {
+      SHELL_Printf( "%u: %s\n", found[x] + 1, name );
     }
   }
+  SHELL_Printf( "%u shown, %u bakes on the list\n", count, CONF_getBakeCount() );
+}
 
-  if( CONF_removeBakes( arr, idx ) ) {
-    if( bakeNames ) {
-      free( bakeNames );
-      bakeCount = 0;
-    }
-    CONF_getBakeNames( &bakeNames, &bakeCount );
-    GUI_populateBakeListNames( (char *)bakeNames, BAKE_NAME_LENGTH, bakeCount );
+static void cmdStats( int argc, char * argv[] ) {
+  SHELL_Printf( "Uptime: %lu[s]\n", millis() / 1000 );
+  SHELL_Printf( "Bakes: %u (list generation %u)\n", CONF_getBakeCount(), CONF_getBakeListGeneration() );
+  SHELL_Printf( "SD card: %s, persistence: %s\n", SDCARD_isAvailable() ? "mounted" : "missing", PERSIST_isIdle() ? "idle" : "busy" );
+}
+
+static void cmdTasks( int argc, char * argv[] ) {
+  STATS_format( statsReport, sizeof( statsReport ) );
+  OTA_LogWrite( statsReport );   // longer than single SHELL_Printf()
+}
+
+static void cmdTelem( int argc, char * argv[] ) {
+  if( 2 == argc ) {
+    TELEM_setPeriod( atoi( argv[1] ) );
   }
+  SHELL_Printf( "Telemetry period: %u[ms]\n", TELEM_getPeriod() );
 }
 
-static void swapBakes( const uint8_t * list ) {
-  uint8_t arr[ 2 ] = { 0 };
+static void cmdMqtt( int argc, char * argv[] ) {
+  mqttStats_t stats;
 
-  if( NULL == list ) {
-    Serial.println( "Swap bakes: NULL pointer error" );
-    return;
+  MQTT_getStats( &stats );
+  SHELL_Printf( "Broker %s: %s\n", MQTT_BROKER, stats.connected ? "connected" : "disconnected" );
+  SHELL_Printf( "Samples queued: %u, published: %u, dropped: %u\n", stats.queued, stats.published, stats.dropped );
+  SHELL_Printf( "Worst case queuing: %u cycles (%u[nS])\n", stats.maxCycles, stats.maxCycles * 1000 / getCpuFrequencyMhz() );
+}
+
+static void cmdTrace( int argc, char * argv[] ) {
+  if( 2 == argc && 0 == strcmp( argv[1], "start" ) ) {
+    TRACE_Start();
+    SHELL_Printf( "Tracing started\n" );
+  } else if( 2 == argc && 0 == strcmp( argv[1], "dump" ) ) {
+    SHELL_Printf( TRACE_Dump() ? "Tracing stopped, writing %s\n" : "Trace not available (%s)\n", TRACE_FILE_PATH );
+  } else {
+    SHELL_Printf( "Use: trace start|dump\n" );
   }
+}
 
-  // arr have elements counted from 0
-  if( 0 < list[0] && bakeCount >= list[0]
-   && 0 < list[1] && bakeCount >= list[1] ) {
-    arr[0] = list[0] - 1;
-    arr[1] = list[1] - 1;
+static void cmdLocks( int argc, char * argv[] ) {
+  if( 2 == argc && 0 == strcmp( argv[1], "reset" ) ) {
+    LOCK_Reset();
+    SHELL_Printf( "Lock statistics cleared\n" );
   } else {
-    Serial.println( "Swap bakes: two indexes required" );
-    return;
+    LOCK_format( lockReport, sizeof( lockReport ) );
+    OTA_LogWrite( lockReport );
   }
+}
 
-  if( CONF_swapBakes( arr ) ) {
-    if( bakeNames ) {
-      free( bakeNames );
-      bakeCount = 0;
-    }
-    CONF_getBakeNames( &bakeNames, &bakeCount );
-    GUI_populateBakeListNames( (char *)bakeNames, BAKE_NAME_LENGTH, bakeCount );
+static void cmdBench( int argc, char * argv[] ) {
+  SHELL_Printf( "Benchmark running...\n" );
+  if( BENCH_Run( OTA_LogWrite ) ) {
+    ctrlStatus_t ctrl;
+
+    CTRL_getStatus( &ctrl );
+    GUI_SetTargetTemp( ctrl.targetTemp );   // overwritten by GUI benchmark, current values are refreshed by the loop
+    GUI_SetTargetTime( ctrl.targetTime );
+  } else {
+    SHELL_Printf( "Benchmark not available (build with BENCH_ENABLE, heater stopped)\n" );
   }
 }
 
-// called from outside
-static void heatingDone() {
-  heatingDoneTriggered = true;
+static void cmdHeap( int argc, char * argv[] ) {
+  SHELL_Printf( "Heap free: %u, min free: %u, max block: %u\n", ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap() );
+}
+
+static const shellCommand_t commands[] = {
+  { "status", NULL, "heating state, temperature and time", cmdStatus },
+  { "temp", "<C>", "set target temperature", cmdTemp },
+  { "time", "<mm[:ss]>", "set heating time", cmdTime },
+  { "start", NULL, "start heating", cmdStart },
+  { "pause", NULL, "pause/continue heating", cmdPause },
+  { "stop", NULL, "stop heating", cmdStop },
+  { "bake", "<n>", "select bake from the list", cmdBake },
+  { "bakes", "[text]", "list bakes (matching text)", cmdBakes },
+  { "stats", NULL, "runtime statistics", cmdStats },
+  { "tasks", NULL, "task CPU share, stack and heap usage", cmdTasks },
+  { "heap", NULL, "heap usage", cmdHeap },
+  { "telem", "[ms]", "show/set telemetry push period", cmdTelem },
+  { "mqtt", NULL, "MQTT publisher statistics", cmdMqtt },
+  { "trace", "start|dump", "control-loop tracing (build with TRACE_ENABLE)", cmdTrace },
+  { "locks", "[reset]", "heater/buzzer/GUI mutex wait and hold times", cmdLocks },
+  { "bench", NULL, "hot path micro-benchmarks as JSON lines (build with BENCH_ENABLE)", cmdBench },
+};
+
+size_t getArduinoLoopTaskStackSize(void) {
+  return (10 * 1024);
+}
+
+// controller view state is rendered only when changed (GUI calls restart blinking and animations)
+static void screenUpdate( const ctrlStatus_t * ctrl ) {
+  static ctrlStatus_t shown;    // zeroed: everything is rendered first time
+
+  if( ctrl->buttons != shown.buttons ) {
+    GUI_setOperationButtons( ctrl->buttons );
+  }
+  if( ctrl->changeAllowed != shown.changeAllowed ) {
+    GUI_setTimeTempChangeAllowed( ctrl->changeAllowed );
+  }
+  if( ctrl->blinkFrame != shown.blinkFrame ) {
+    GUI_setBlinkScreenFrame( ctrl->blinkFrame );
+  }
+  if( ctrl->blinkTime != shown.blinkTime ) {
+    GUI_setBlinkTimeCurrent( ctrl->blinkTime );
+  }
+  if( ctrl->targetUpdates != shown.targetUpdates || ctrl->targetTemp != shown.targetTemp ) {
+    GUI_SetTargetTemp( ctrl->targetTemp );
+  }
+  if( ctrl->targetUpdates != shown.targetUpdates || ctrl->targetTime != shown.targetTime ) {
+    GUI_SetTargetTime( ctrl->targetTime );
+  }
+  if( 0 != strcmp( ctrl->bakeName, shown.bakeName ) ) {
+    GUI_setBakeName( ctrl->bakeName );
+  }
+  if( ctrl->mainTabRequests != shown.mainTabRequests ) {
+    GUI_SetTabActive( TAB_MAIN );
+  }
+
+  shown = *ctrl;
 }
 
-static void heatingDoneHandle() {
-  int32_t tmp_targetHeatingTime;
+// screen refresh, every 100ms
+static void screenRefresh( const ctrlStatus_t * ctrl ) {
+  float currentTemp = HEATER_getCurrentTemperature();
+  uint32_t timeRemaining = HEATER_getTimeRemaining();
+  uint8_t power = HEATER_getCurrentPower();
+  telemStatus_t status = { (int16_t)( currentTemp * 10 ), ctrl->targetTemp, power, (uint8_t)ctrl->state, timeRemaining / 1000 };
+
+  TELEM_Update( &status );
+  screenUpdate( ctrl );
 
-  if( manualOperation ) {
-    tmp_targetHeatingTime = 0;    // force end of heating
+  if( 0 < ctrl->targetTime ) {
+    uint32_t barTime = 1000 - (uint32_t)( (float)timeRemaining * 1000 / (float)ctrl->targetTime );
+    GUI_setTimeBar( barTime );
   } else {
-    // handle next step in bake curve (if exist)
-    bakeStep++;
-    tmp_targetHeatingTime = CONF_getBakeTime( bakeIdx, bakeStep );
-    Serial.printf("Handling next step (time=%d)\n", tmp_targetHeatingTime );
-  }
-  specialEvent = false;
-  specialEventCode = 0;
-  specialEventValue = 0;
-
-  if( 0 == tmp_targetHeatingTime ) {  // no next step, finish heating process
-    BUZZ_Add( 0, 1000, 200, 5 );
-    Serial.println( "Heating done!" );
-    heaterStateRequested = STATE_STOP_REQUESTED;
-  } else if( 0 < tmp_targetHeatingTime ) {  // there is next step, handle it
-    targetHeatingTime = (uint32_t)SECONDS_TO_MILISECONDS( tmp_targetHeatingTime );
-    targetHeatingTemp = (uint16_t)CONF_getBakeTemp( bakeIdx, bakeStep );
-    heaterStateRequested = STATE_NEXTSTEP_REQUESTED;
-  } else {                    // next step is an event
-    specialEvent = true;
-    targetHeatingTime = 0;
-    targetHeatingTemp = 0;
-    specialEventCode = tmp_targetHeatingTime;
-    specialEventValue = CONF_getBakeTemp( bakeIdx, bakeStep );   // temp has different meaning in special event
-  }
-}
-
-// called from outside
-static void otaStateChanged( bool otaState ) {
-  otaStateChangedTriggered = true;
-  otaStateStatus = otaState;
+    GUI_setTimeBar( 0 );
+  }
+
+  if( 0 < ctrl->targetTemp && 0.0f < currentTemp ) {
+    int32_t barTemp = (int32_t)( currentTemp * 100 / (float)ctrl->targetTemp );
+    GUI_setTempBar( barTemp );
+  } else {
+    GUI_setTempBar( 20 );   // room temp. by default
+  }
+
+  if( ctrl->manual ) {
+    GUI_setTotalTime( 0 );
+  } else if( STATE_IDLE == ctrl->state ) {
+    GUI_setTotalTime( ctrl->totalTime );
+  } else if( ctrl->step < ctrl->steps ) {
+    GUI_setTotalTime( ctrl->remainingAfter + ( ctrl->segmentTimed ? timeRemaining : 0 ) );   // segments waiting for user count as 0
+  } else {
+    GUI_setTotalTime( 0 );
+  }
+
+  // show time with seconds when time is less than 1h
+  if( MINUTES_TO_MS(60) > timeRemaining ) {
+    timeRemaining = MM_SS_TO_HH_MM( timeRemaining );
+  }
+
+  GUI_SetCurrentTemp( (uint16_t)currentTemp );
+  GUI_SetCurrentTime( timeRemaining );
+  GUI_setPowerBar( power );
+  GUI_setPowerIndicator( HEATER_isHeating() );
 }
 
-static void otaStateChangedHandle() {
-  Serial.printf( "WiFi changed state to: %s\n", otaStateStatus?"connected":"disconnected" );
-  settings[ OPTION_OTA ].currentValue.bValue = otaStateStatus;
-  // update GUI icons
-  GUI_setWiFiIcon( settings[ OPTION_OTA ].currentValue.bValue );
-  GUI_updateOption( settings[ OPTION_OTA ] );
+// slow housekeeping, every 1s
+static void housekeeping( unsigned long now, const ctrlStatus_t * ctrl ) {
+  mqttSample_t sample = { (uint32_t)now, (int16_t)( HEATER_getCurrentTemperature() * 10 ), ctrl->targetTemp,
+                          HEATER_getCurrentPower(), (uint8_t)ctrl->state };
+
+  Serial.print( "*" );
+  PERSIST_Signal( PERSIST_SIGNAL_SDCARD );    // card insertion/removal is probed by persistence worker (slow when no card)
+  MQTT_Sample( &sample );   // queued also while WiFi is down
+
+  uint32_t lvglUsed, lvglTotal;
+  if( GUI_getMemoryUsage( &lvglUsed, &lvglTotal ) ) {
+    STATS_setLvglMemory( lvglUsed, lvglTotal );
+  }
+  if( GUI_isDiagnosticsVisible() ) {
+    STATS_format( statsReport, sizeof( statsReport ) );
+    GUI_setDiagnosticsText( statsReport );
+  }
 }
 
-size_t getArduinoLoopTaskStackSize(void) {
-  return (10 * 1024);
+// persistence worker, SD card is probed there so that missing card never stalls the controller
+static bool sdcardProbe( void * arg ) {
+  SDCARD_Handle();
+  return true;
 }
 
 void setup() {
   Serial.begin( 115200 );
 
+  LOG_Init();
+  LOG_setSink( OTA_LogWrite );    // telnet client
+  PERSIST_Init();
+  PERSIST_setSignalJob( PERSIST_SIGNAL_SDCARD, sdcardProbe );
+  REC_Init();
   OTA_Init();
+  TELEM_Init();
+  MQTT_Init();
   BUZZ_Init();
   GUI_Init();
   HEATER_Init( GUI_getSPIinstance() );
-  HEATER_setCallback( heatingDone );
   CONF_Init( GUI_getSPIinstance() );
-  manualOperation = true;
+  CTRL_setEventCallback( bakeEvent );
+  CTRL_Init();    // takes heater callback
 
   // GUI callbacks
   GUI_setTimeCallback( updateTime );      // time will be updated when changed
@@ -306,14 +529,17 @@ void setup() {
   GUI_setAdjustTimeCallback( adjustTime );
   GUI_setRemoveBakesFromListCallback( removeBakes );
   GUI_setSwapBakesOnListCallback( swapBakes );
+  GUI_setMoveBakeOnListCallback( moveBake );
+  GUI_setBakeFilterCallback( filterBakes );
 
   OTA_setOtaActiveCallback( otaStateChanged );
+  SHELL_Init( commands, sizeof(commands)/sizeof(shellCommand_t) );
+  OTA_setCommandCallback( SHELL_Input );    // telnet command lines are executed by SHELL_Handle()
 
-  CONF_getBakeNames( &bakeNames, &bakeCount );
-  GUI_populateBakeListNames( (char *)bakeNames, BAKE_NAME_LENGTH, bakeCount );
+  refreshBakeList();
 
-  settings[ OPTION_BUZZER ].currentValue.bValue = CONF_getOptionBool( (int32_t)OPTION_BUZZER );
-  settings[ OPTION_OTA ].currentValue.bValue = CONF_getOptionBool( (int32_t)OPTION_OTA );
+  settings[ OPTION_BUZZER ].currentValue.bValue = CONF_getOptionBool( CONF_OPT_BUZZER );
+  settings[ OPTION_OTA ].currentValue.bValue = CONF_getOptionBool( CONF_OPT_OTA );
   BUZZ_Activate( settings[ OPTION_BUZZER ].currentValue.bValue );
   GUI_setSoundIcon( settings[ OPTION_BUZZER ].currentValue.bValue );
   GUI_setWiFiIcon( false ); // show no icon by default, it will change as soon as wifi connect
@@ -326,440 +552,44 @@ void setup() {
   settings[ OPTION_SAVE ].optionCallback = storeSettings;
   GUI_optionsPopulate( settings, sizeof(settings)/sizeof(setting_t) );
 
-  currentTime = next1S = millis();
-  lastCurrentTime = currentTime - 10;   // first call with 10ms
+  STATS_Init();   // all tasks are running now
 }
 
 void loop() {
-  currentTime = millis();
+  static unsigned long lastCurrentTime = millis() - 10;   // first call with 10ms
+  static unsigned long lastRefresh = 0;
+  static unsigned long lastHousekeeping = 0;
+  unsigned long currentTime = millis();
 
-  // handle stuff every 10 miliseconds (by default)
+  // handle stuff every 10 miliseconds (by default), bake control runs in controller task
   GUI_Handle( currentTime - lastCurrentTime );
   lastCurrentTime = currentTime;
 
-  // handle stuff every 100 miliseconds
-  if( currentTime >= next100mS ) {
-    float currentTemp = HEATER_getCurrentTemperature();
-    uint32_t timeRemaining = HEATER_getTimeRemaining();
-    uint8_t power = HEATER_getCurrentPower();
-
-    if( 0 < targetHeatingTime ) {
-      uint32_t barTime = 1000 - (uint32_t)( (float)timeRemaining * 1000 / (float)targetHeatingTime );
-      GUI_setTimeBar( barTime );
-    } else {
-      GUI_setTimeBar( 0 );
-    }
-
-    if( 0 < targetHeatingTemp && 0.0f < currentTemp ) {
-      int32_t barTemp = (int32_t)( currentTemp * 100 / (float)targetHeatingTemp );
-      GUI_setTempBar( barTemp );
-    } else {
-      GUI_setTempBar( 20 );   // room temp. by default
-    }
+  if( 100 <= currentTime - lastRefresh ) {
+    ctrlStatus_t ctrl;
 
-    // show time with seconds when time is less than 1h
-    if( MINUTES_TO_MS(60) > timeRemaining ) {
-      timeRemaining = MM_SS_TO_HH_MM( timeRemaining );
-    }
-
-    GUI_SetCurrentTemp( (uint16_t)currentTemp );
-    GUI_SetCurrentTime( timeRemaining );
-    GUI_setPowerBar( power );
-    GUI_setPowerIndicator( HEATER_isHeating() );
-    next100mS += 100;
-  }
-
-  // handle stuff every 1 second
-  if( currentTime >= next1S ) {
-    Serial.print( "*" );
-    next1S += 1000;
-  }
-
-  switch( heaterState ) {
-    case STATE_IDLE: {
-      // check against started heating
-      if( STATE_START_REQUESTED == heaterStateRequested ) { // in STATE_IDLE only STATE_START_REQUESTED allowed
-        // Serial.printf("START: specialEvent=%d, specialEventCode=%d, specialEventValue=%d\n", (int)specialEvent, specialEventCode, specialEventValue );
-        if( specialEvent ) {      // special case: first step is an event
-          specialEvent = false;
-          specialEventState = EVENT_STATE_BEGIN;
-          heaterState = STATE_SPECIAL_EVENT;
-          eventHandlingStart = currentTime;
-        }
-        else {
-          if( MAX_ALLOWED_TIME < targetHeatingTime ) {
-            targetHeatingTime = MAX_ALLOWED_TIME;
-          }
-          if( MAX_ALLOWED_TEMP < targetHeatingTemp ) {
-            targetHeatingTemp = MAX_ALLOWED_TEMP;
-          }
-          if( MIN_ALLOWED_TEMP > targetHeatingTemp ) {
-            targetHeatingTemp = MIN_ALLOWED_TEMP;
-          }
-
-          GUI_SetTargetTime( targetHeatingTime );
-          GUI_SetTargetTemp( targetHeatingTemp );
-
-          HEATER_setTime( targetHeatingTime );
-          HEATER_setTemperature( (uint16_t)targetHeatingTemp );
-          HEATER_start();
-
-          BUZZ_Add( 400 );
-          heaterState = STATE_HEATING;
-        }
-
-        // hide "Start" button, show "Pause" and "Stop" buttons
-        GUI_setOperationButtons( BUTTONS_PAUSE_STOP );
-        GUI_setTimeTempChangeAllowed( false );
-        GUI_setBlinkScreenFrame( true );
-        GUI_setBlinkTimeCurrent( false );    // no required here but just in case
-
-        heaterStateRequested = STATE_IDLE;
-      }
-      break;
-    }
-    case STATE_HEATING: {
-      if( STATE_STOP_REQUESTED == heaterStateRequested ) {
-        HEATER_stop();
-        GUI_setOperationButtons( BUTTONS_START );
-        GUI_setTimeTempChangeAllowed( true );
-        GUI_setBlinkScreenFrame( false );
-        GUI_setBlinkTimeCurrent( false );   // no required here but just in case
-
-        heaterStateRequested = STATE_IDLE;
-        heaterState = STATE_IDLE;
-        if( false == manualOperation ) {
-          bakePickup( bakeIdx, false );       // prepare for next round
-        }
-      }
-      else if( STATE_NEXTSTEP_REQUESTED == heaterStateRequested ) {
-        if( MAX_ALLOWED_TIME < targetHeatingTime ) {
-          targetHeatingTime = MAX_ALLOWED_TIME;
-        }
-        if( MAX_ALLOWED_TEMP < targetHeatingTemp ) {
-          targetHeatingTemp = MAX_ALLOWED_TEMP;
-        }
-        if( MIN_ALLOWED_TEMP > targetHeatingTemp ) {
-          targetHeatingTemp = MIN_ALLOWED_TEMP;
-        }
-
-        GUI_SetTargetTime( targetHeatingTime );
-        GUI_SetTargetTemp( targetHeatingTemp );
-
-        HEATER_setTime( targetHeatingTime );
-        HEATER_setTemperature( (uint16_t)targetHeatingTemp );
-        HEATER_start();
-
-        heaterStateRequested = STATE_IDLE;
-      }
-      else if( STATE_PAUSE_REQUESTED == heaterStateRequested ) {
-        HEATER_pause();
-        GUI_setOperationButtons( BUTTONS_CONTINUE_STOP );
-        GUI_setTimeTempChangeAllowed( false );
-        GUI_setBlinkScreenFrame( false );
-        GUI_setBlinkTimeCurrent( true );   // blinking 'TimeCurrent' indicate PAUSE active
-
-        heaterStateRequested = STATE_IDLE;
-        heaterState = STATE_HEATING_PAUSE;
-      }
-      else if( specialEvent ) {
-        specialEvent = false;
-        specialEventState = EVENT_STATE_BEGIN;
-        heaterState = STATE_SPECIAL_EVENT;
-        eventHandlingStart = currentTime;
-      }
-      break;
-    }
-    case STATE_HEATING_PAUSE: {
-      static bool buzzerActive = false;
-      if( !buzzerActive ) {
-        BUZZ_Delete( eventBuzzing );  // just in case it exist
-        eventBuzzing = BUZZ_Add( BUZZ_EVENT_PAUSE );
-        buzzerActive = true;
-      }
-
-      if( STATE_STOP_REQUESTED == heaterStateRequested ) {
-        HEATER_stop();
-        GUI_setOperationButtons( BUTTONS_START );
-        GUI_setTimeTempChangeAllowed( true );
-        GUI_setBlinkScreenFrame( false );
-        GUI_setBlinkTimeCurrent( false );   // stop blinking (stop heating)
-
-        buzzerActive = false;
-        BUZZ_Delete( eventBuzzing );
-        heaterStateRequested = STATE_IDLE;
-        heaterState = STATE_IDLE;
-        if( false == manualOperation ) {
-          bakePickup( bakeIdx, false );       // prepare for next round
-        }
-      }
-      else if( STATE_PAUSE_REQUESTED == heaterStateRequested ) {
-        HEATER_pause(); // continue processing (same API function for 'unpause')
-        GUI_setOperationButtons( BUTTONS_PAUSE_STOP );
-        GUI_setTimeTempChangeAllowed( false );
-        GUI_setBlinkScreenFrame( true );
-        GUI_setBlinkTimeCurrent( false );    // stop blinking (continue heating)
-
-        buzzerActive = false;
-        BUZZ_Delete( eventBuzzing );
-        heaterStateRequested = STATE_IDLE;
-        heaterState = STATE_HEATING;
-      }
-      break;
-    }
-    case STATE_SPECIAL_EVENT: {
-      switch( specialEventCode ) {
-        case EVENT_PREHEATING: {
-          static bool targetTempReached;
-
-          switch( specialEventState ) {
-            case EVENT_STATE_BEGIN: {
-              Serial.println( "Handle EVENT_PREHEATING..." );
-
-              targetHeatingTemp = specialEventValue;
-              if( MAX_ALLOWED_TEMP < targetHeatingTemp ) {
-                targetHeatingTemp = MAX_ALLOWED_TEMP;
-              }
-              if( MIN_ALLOWED_TEMP > targetHeatingTemp ) {
-                targetHeatingTemp = MIN_ALLOWED_TEMP;
-              }
-
-              GUI_SetTargetTime( 0 );
-              GUI_SetTargetTemp( targetHeatingTemp );
-
-              HEATER_setTime( EVENT_PREHEATING_MAX_TIME );
-              HEATER_setTemperature( (uint16_t)targetHeatingTemp );
-              HEATER_start();
-
-              GUI_setOperationButtons( BUTTONS_STOP );
-              GUI_setTimeTempChangeAllowed( false );
-              GUI_setBlinkScreenFrame( true );
-              GUI_setBlinkTimeCurrent( true );        // indicate we're in preheating mode
-
-              targetTempReached = false;
-              eventBuzzing = BUZZ_Add( BUZZ_EVENT_PREHEATING );
-              specialEventState = EVENT_STATE_HANDLING;
-
-              break;
-            }
-            case EVENT_STATE_HANDLING: {
-              if( STATE_STOP_REQUESTED == heaterStateRequested ) {
-                Serial.println( "...and go to STOP immediately" );
-                BUZZ_Delete( eventBuzzing );
-                heaterState = STATE_HEATING;    // preheating will be stopped in next cycle
-                specialEventState = EVENT_STATE_IDLE;
-              }
-              else if( STATE_PAUSE_REQUESTED == heaterStateRequested ) {  // CONTINUE was pressed
-                specialEventState = EVENT_STATE_END;
-              }
-
-              // target temp reached
-              if( !targetTempReached && HEATER_getCurrentTemperature() >= targetHeatingTemp ) {
-                Serial.println( "Target temp reached." );
-                targetTempReached = true;
-
-                GUI_setOperationButtons( BUTTONS_CONTINUE_STOP );
-                BUZZ_Delete( eventBuzzing );
-                eventBuzzing = BUZZ_Add( BUZZ_EVENT_TEMP_REACHED );
-              }
-
-              break;
-            }
-            case EVENT_STATE_END: {
-              Serial.println( "...go to PAUSE event and wait for user action" );
-              GUI_setOperationButtons( BUTTONS_PAUSE_STOP );
-              BUZZ_Delete( eventBuzzing );
-              HEATER_stop();
-
-              heaterStateRequested = STATE_IDLE;
-              heaterState = STATE_HEATING;
-              specialEventState = EVENT_STATE_IDLE;
-              heatingDoneHandle();        // go to next step
-
-              break;
-            }
-          }
-          break;
-        }
-        case EVENT_PAUSE: {
-          switch( specialEventState ) {
-            case EVENT_STATE_BEGIN: {
-              Serial.println( "Handle EVENT_PAUSE..." );
-
-              targetHeatingTemp = specialEventValue;
-              if( MAX_ALLOWED_TEMP < targetHeatingTemp ) {
-                targetHeatingTemp = MAX_ALLOWED_TEMP;
-              }
-              if( MIN_ALLOWED_TEMP > targetHeatingTemp ) {
-                targetHeatingTemp = MIN_ALLOWED_TEMP;
-              }
-
-              GUI_SetTargetTime( 0 );
-              GUI_SetTargetTemp( targetHeatingTemp );
-
-              HEATER_setTime( EVENT_PAUSE_MAX_TIME );
-              HEATER_setTemperature( (uint16_t)targetHeatingTemp );
-              HEATER_start();
-
-              GUI_setOperationButtons( BUTTONS_CONTINUE_STOP );
-              GUI_setTimeTempChangeAllowed( false );
-              GUI_setBlinkScreenFrame( true );
-              GUI_setBlinkTimeCurrent( true );        // indicate we're in pause mode
-
-              eventBuzzing = BUZZ_Add( BUZZ_EVENT_PAUSE );
-              specialEventState = EVENT_STATE_HANDLING;
-
-              break;
-            }
-            case EVENT_STATE_HANDLING: {
-              if( STATE_PAUSE_REQUESTED == heaterStateRequested ) {
-                specialEventState = EVENT_STATE_END;
-              }
-              else if( STATE_STOP_REQUESTED == heaterStateRequested ) {
-                Serial.println( "...and go to STOP immediately" );
-                BUZZ_Delete( eventBuzzing );
-                heaterState = STATE_HEATING;
-                specialEventState = EVENT_STATE_IDLE;
-              }
-
-              break;
-            }
-            case EVENT_STATE_END: {
-              Serial.println( "...and go to next step" );
-              BUZZ_Delete( eventBuzzing );
-              HEATER_stop();
-
-              GUI_setOperationButtons( BUTTONS_PAUSE_STOP );
-              GUI_setTimeTempChangeAllowed( false );
-              GUI_setBlinkScreenFrame( true );
-              GUI_setBlinkTimeCurrent( false );
-
-              heaterStateRequested = STATE_IDLE;
-              heaterState = STATE_HEATING;
-              specialEventState = EVENT_STATE_IDLE;
-              heatingDoneHandle();        // go to next step
-
-              break;
-            }
-          }
-          break;
-        }
-        case EVENT_SOUND: {
-          Serial.println( "Handle EVENT_SOUND and go to next step" );
-          BUZZ_Add( BUZZ_EVENT_SOUND );
-          heaterState = STATE_HEATING;
-          heatingDoneHandle();
-          break;
-        }
-        case EVENT_END: {
-          switch( specialEventState ) {
-            case EVENT_STATE_BEGIN: {
-              Serial.println( "Handle EVENT_END..." );
-
-              GUI_setOperationButtons( BUTTONS_STOP );
-              HEATER_stop();
-              eventBuzzing = BUZZ_Add( BUZZ_EVENT_END );
-              eventHandlingStart = currentTime;
-              specialEventState = EVENT_STATE_HANDLING;
-
-              break;
-            }
-            case EVENT_STATE_HANDLING: {
-              // 1 minute passed, activate new buzzing
-              if( (eventHandlingStart + BUZZ_EVENT_END_PERIOD) < currentTime ) {
-                eventBuzzing = BUZZ_Add( BUZZ_EVENT_END );
-                eventHandlingStart += BUZZ_EVENT_END_PERIOD;
-
-                if( BUZZ_EVENT_END_PERIOD > eventHandlingStart ) {    // just in case of time overflow (after ca. 50 days)
-                  heaterStateRequested = STATE_STOP_REQUESTED;
-                }
-              }
-
-              if( STATE_STOP_REQUESTED == heaterStateRequested ) {
-                specialEventState = EVENT_STATE_END;
-              }
-
-              break;
-            }
-            case EVENT_STATE_END: {
-              Serial.println( "...and go to STATE_IDLE" );
-              BUZZ_Delete( eventBuzzing );
-
-              GUI_setOperationButtons( BUTTONS_START );
-              GUI_setTimeTempChangeAllowed( true );
-              GUI_setBlinkScreenFrame( false );
-              GUI_setBlinkTimeCurrent( false );
-
-              heaterStateRequested = STATE_IDLE;
-              heaterState = STATE_IDLE;
-              specialEventState = EVENT_STATE_IDLE;
-              bakePickup( bakeIdx, false );       // prepare for next round
-
-              break;
-            }
-          }
-          break;
-        }
-        case EVENT_TIMER: {
-          Serial.println( "Handle EVENT_TIMER..." );
-
-          targetHeatingTime = (uint32_t)SECONDS_TO_MILISECONDS( specialEventValue );
-          if( MAX_ALLOWED_TIME < targetHeatingTime ) {
-            targetHeatingTime = MAX_ALLOWED_TIME;
-          }
-
-          GUI_SetTargetTime( targetHeatingTime );
-          GUI_SetTargetTemp( 0 );
-
-          HEATER_setTime( targetHeatingTime );
-          HEATER_setTemperature( 0 );
-          HEATER_start();
-
-          GUI_setOperationButtons( BUTTONS_PAUSE_STOP );
-          GUI_setTimeTempChangeAllowed( false );
-          GUI_setBlinkScreenFrame( true );
-          GUI_setBlinkTimeCurrent( false );
-
-          heaterState = STATE_HEATING;
-          heaterStateRequested = STATE_IDLE;
-
-          break;
-        }
-        default: {
-          Serial.printf( "Invalid event code: %d\n", specialEventCode );
-          BUZZ_Add( 5000 );
-          break;
-        }
-      }
-      break;
-    }
-    default: {
-      break;
+    CTRL_getStatus( &ctrl );
+    screenRefresh( &ctrl );
+    if( 1000 <= currentTime - lastHousekeeping ) {
+      housekeeping( currentTime, &ctrl );
+      lastHousekeeping = currentTime;
     }
+    lastRefresh = currentTime;
   }
 
-  // handle callbacks (instead of using semaphores wait for flags to be set from outside)
-  if( heatingDoneTriggered ) {
-    // special case: time's up for EVENT_PAUSE/EVENT_PREHEATING >> go to stop process
-    if( STATE_SPECIAL_EVENT == heaterState
-    && ( EVENT_PREHEATING == specialEventCode || EVENT_PAUSE == specialEventCode ) ) {
-      Serial.println( "Time's up for PAUSE/PREHEATING event! Go to STOP." );
-      BUZZ_Delete( eventBuzzing );
-      BUZZ_Add( 500, 500, 200, 10 );
-      heaterState = STATE_HEATING;
-      heaterStateRequested = STATE_STOP_REQUESTED;
-    }
-    else {
-      heatingDoneHandle();
-    }
+  if( __atomic_exchange_n( &otaStatePending, false, __ATOMIC_ACQ_REL ) ) {
+    otaStateChangedHandle( __atomic_load_n( &otaStateReported, __ATOMIC_RELAXED ) );
+  }
 
-    heatingDoneTriggered = false;
+  if( __atomic_exchange_n( &bakesAddRequested, false, __ATOMIC_ACQ_REL ) ) {
+    addBakesHandle();   // outside of GUI event callback, list rows are rebuilt below
   }
 
-  if( otaStateChangedTriggered ) {
-    otaStateChangedHandle();
-    otaStateChangedTriggered = false;
+  if( CONF_getBakeListGeneration() != bakeListGeneration ) {
+    refreshBakeList();
   }
 
+  SHELL_Handle();
+
   vTaskDelay( 10 / portTICK_PERIOD_MS );
 }
@@ -1,15 +1,13 @@
-#include "Arduino.h"
 #include "max6675.h"
-#include "SPI.h"
+#include "trace.h"
 
 static int8_t cs;         // chip select pin
 static bool   initialized = false;
 static volatile float     currentTemperature;
-static TaskHandle_t       taskHandle = NULL;
-static StaticTask_t       taskTCB;
-static StackType_t        taskStack[ MAX6675_STACK_SIZE ];
+static halTask_t          task;
+static halStack_t         taskStack[ MAX6675_STACK_SIZE ];
 
-SPIClass * sharedSpi;
+halSpi_t * sharedSpi;
 
 static void vTaskHeater( void * pvParameters );
 
@@ -18,11 +16,9 @@ static void vTaskHeater( void * pvParameters ) {
     if( initialized ) {
       uint16_t v;
 
-      sharedSpi->beginTransaction( SPISettings( 4000000, MSBFIRST, SPI_MODE0 ) );  // max SPI speed used succesfully:25MHz
-      digitalWrite( cs, LOW );
-      v = sharedSpi->transfer16( 0x00 );
-      digitalWrite( cs, HIGH );
-      sharedSpi->endTransaction();
+      TRACE_BEGIN( TRACE_SENSOR_READ, 0 );
+      v = HAL_spiRead16( sharedSpi, cs, MAX6675_SPI_FREQUENCY );
+      TRACE_END( TRACE_SENSOR_READ, v );
 
       if ( v & 0x4 ) {
         // no thermocouple attached!
@@ -35,11 +31,11 @@ static void vTaskHeater( void * pvParameters ) {
       currentTemperature = NAN;
     }
 
-    vTaskDelay( TEMP_READ_INTERVAL / portTICK_PERIOD_MS );
+    HAL_delay( TEMP_READ_INTERVAL );
   }
 }
 
-void MAX6675_Init( SPIClass * spi, int8_t _CS ) {
+void MAX6675_Init( halSpi_t * spi, int8_t _CS ) {
   if( true == initialized ) {
     return;
   }
@@ -51,12 +47,11 @@ void MAX6675_Init( SPIClass * spi, int8_t _CS ) {
   cs = _CS;
   sharedSpi = spi;
 
-  pinMode( cs, OUTPUT );
-  digitalWrite( cs, HIGH );
+  HAL_pinOutput( cs, true );
 
-  sharedSpi->begin();
+  HAL_spiBegin( sharedSpi );
 
-  taskHandle = xTaskCreateStatic( vTaskHeater, "Heater", MAX6675_STACK_SIZE, NULL, MAX6675_TASK_PRIORITY, taskStack, &taskTCB );
+  HAL_taskCreate( &task, vTaskHeater, "Heater", taskStack, MAX6675_STACK_SIZE, MAX6675_TASK_PRIORITY, HAL_CORE_ANY );
 
   initialized = true;
 }
@@ -0,0 +1,281 @@
+#include <WiFi.h>
+#include "mqtt.h"
+#include "myOTA.h"
+#include "logger.h"
+#include "helper.h"
+
+#define MQTT_CONNECT            0x10
+#define MQTT_CONNACK            0x20
+#define MQTT_PUBLISH            0x30    // QoS 0
+#define MQTT_PINGREQ            0xC0
+#define MQTT_DISCONNECT         0xE0
+#define MQTT_HEADER_MAX         5       // fixed header: type + up to 4 bytes of remaining length
+#define MQTT_CONNACK_TIMEOUT    2000    // [ms]
+
+typedef struct {
+  uint32_t      time;
+  const char *  name;
+  int32_t       value;
+} mqttEvent_t;
+
+// single producer (controller loop) / single consumer (MQTT task) queues, indexes are free running
+static mqttSample_t       samples[ MQTT_SAMPLE_QUEUE ];
+static uint32_t           sampleHead = 0;         // producer only
+static uint32_t           sampleTail = 0;         // consumer only
+static mqttEvent_t        events[ MQTT_EVENT_QUEUE ];
+static uint32_t           eventHead = 0;
+static uint32_t           eventTail = 0;
+static uint32_t           dropped = 0;
+static uint32_t           published = 0;
+static uint32_t           maxCycles = 0;          // producer only
+static bool               activeRequested = false;
+static bool               connected = false;
+static uint32_t           lastConnectTry;
+static uint32_t           lastSend;
+static WiFiClient         client;
+static uint8_t            packet[ MQTT_PACKET_LENGTH ];   // MQTT task only
+static bool               initialized = false;
+static TaskHandle_t       taskHandle = NULL;
+static StaticTask_t       taskTCB;
+static StackType_t        taskStack[ MQTT_STACK_SIZE ];
+
+static inline void costUpdate( uint32_t start ) {
+  uint32_t cycles = ESP.getCycleCount() - start;
+
+  if( cycles > maxCycles ) {
+    maxCycles = cycles;
+  }
+}
+
+/**
+ * Put fixed header in front of variable part stored from packet[ MQTT_HEADER_MAX ] and send whole packet
+ */
+static bool packetSend( uint8_t type, uint32_t len ) {
+  uint8_t header[ MQTT_HEADER_MAX ];
+  uint32_t headerLen = 0;
+  uint32_t remaining = len;
+
+  header[ headerLen++ ] = type;
+  do {
+    uint8_t byte = remaining % 128;
+    remaining /= 128;
+    header[ headerLen++ ] = ( 0 < remaining ) ? ( byte | 0x80 ) : byte;
+  } while( 0 < remaining );
+
+  uint8_t * start = &packet[ MQTT_HEADER_MAX - headerLen ];
+  memcpy( start, header, headerLen );
+  if( headerLen + len != client.write( start, headerLen + len ) ) {
+    return false;
+  }
+
+  lastSend = millis();
+  return true;
+}
+
+static uint32_t putString( uint32_t pos, const char * text ) {
+  uint32_t len = strlen( text );
+
+  packet[ pos++ ] = len >> 8;
+  packet[ pos++ ] = len & 0xFF;
+  memcpy( &packet[ pos ], text, len );
+  return pos + len;
+}
+
+static uint32_t putTopic( uint32_t pos, const char * topic ) {
+  char name[ 48 ];
+
+  snprintf( name, sizeof( name ), "%s%s", OTA_HOST_NAME, topic );
+  return putString( pos, name );
+}
+
+static void disconnect( void ) {
+  if( connected ) {
+    packetSend( MQTT_DISCONNECT, 0 );
+    LOG_Printf( LOG_INFO, "MQTT: disconnected" );
+  }
+  client.stop();
+  connected = false;
+}
+
+static bool connect( void ) {
+  uint32_t pos = MQTT_HEADER_MAX;
+  uint8_t connack[4];
+  uint32_t received = 0;
+  uint32_t start;
+
+  if( !client.connect( MQTT_BROKER, MQTT_PORT ) ) {
+    return false;
+  }
+
+  pos = putString( pos, "MQTT" );
+  packet[ pos++ ] = 4;              // protocol level 3.1.1
+  packet[ pos++ ] = 0x02;           // clean session
+  packet[ pos++ ] = MQTT_KEEPALIVE >> 8;
+  packet[ pos++ ] = MQTT_KEEPALIVE & 0xFF;
+  pos = putString( pos, OTA_HOST_NAME );   // client id
+  if( !packetSend( MQTT_CONNECT, pos - MQTT_HEADER_MAX ) ) {
+    client.stop();
+    return false;
+  }
+
+  start = millis();
+  while( received < sizeof( connack ) && MQTT_CONNACK_TIMEOUT > millis() - start ) {
+    if( client.available() ) {
+      connack[ received++ ] = client.read();
+    } else {
+      vTaskDelay( 10 / portTICK_PERIOD_MS );
+    }
+  }
+  if( sizeof( connack ) != received || MQTT_CONNACK != connack[0] || 0 != connack[3] ) {
+    LOG_Printf( LOG_WARNING, "MQTT: broker refused connection (%u)", ( sizeof( connack ) == received ) ? connack[3] : 0xFF );
+    client.stop();
+    return false;
+  }
+
+  connected = true;
+  LOG_Printf( LOG_INFO, "MQTT: connected to %s, %u samples queued", MQTT_BROKER, sampleHead - sampleTail );
+  return true;
+}
+
+static bool publishEvents( void ) {
+  uint32_t head = __atomic_load_n( &eventHead, __ATOMIC_ACQUIRE );
+
+  while( eventTail != head ) {
+    const mqttEvent_t * event = &events[ eventTail & ( MQTT_EVENT_QUEUE - 1 ) ];
+    uint32_t pos = putTopic( MQTT_HEADER_MAX, MQTT_TOPIC_EVENT );
+
+    pos += snprintf( (char *)&packet[ pos ], MQTT_PACKET_LENGTH - pos, "{\"now\":%lu,\"t\":%u,\"event\":\"%s\",\"value\":%d}",
+                     millis(), event->time, event->name, event->value );
+    if( !packetSend( MQTT_PUBLISH, pos - MQTT_HEADER_MAX ) ) {
+      return false;
+    }
+    __atomic_store_n( &eventTail, eventTail + 1, __ATOMIC_RELEASE );
+  }
+  return true;
+}
+
+/**
+ * Publish one batch of samples (when there is enough of them or when flushing backlog)
+ */
+static bool publishSamples( void ) {
+  uint32_t head = __atomic_load_n( &sampleHead, __ATOMIC_ACQUIRE );
+  uint32_t count = 0;
+  uint32_t pos;
+
+  if( MQTT_BATCH_SAMPLES > head - sampleTail ) {
+    return true;
+  }
+
+  pos = putTopic( MQTT_HEADER_MAX, MQTT_TOPIC_TELEMETRY );
+  pos += snprintf( (char *)&packet[ pos ], MQTT_PACKET_LENGTH - pos, "{\"now\":%lu,\"samples\":[", millis() );
+  while( sampleTail + count != head && MQTT_BATCH_SAMPLES > count ) {
+    const mqttSample_t * sample = &samples[ ( sampleTail + count ) & ( MQTT_SAMPLE_QUEUE - 1 ) ];
+
+    pos += snprintf( (char *)&packet[ pos ], MQTT_PACKET_LENGTH - pos, "%s[%u,%.1f,%u,%u,%u]", ( 0 < count ) ? "," : "",
+                     sample->time, sample->temp / 10.0f, sample->setpoint, sample->power, sample->state );
+    count++;
+  }
+  pos += snprintf( (char *)&packet[ pos ], MQTT_PACKET_LENGTH - pos, "]}" );
+
+  if( !packetSend( MQTT_PUBLISH, pos - MQTT_HEADER_MAX ) ) {
+    return false;
+  }
+  __atomic_store_n( &sampleTail, sampleTail + count, __ATOMIC_RELEASE );
+  __atomic_fetch_add( &published, count, __ATOMIC_RELAXED );
+  return true;
+}
+
+static void vTaskMqtt( void * pvParameters ) {
+  lastConnectTry = millis() - MQTT_RECONNECT_PERIOD;
+
+  while( 1 ) {
+    bool active = __atomic_load_n( &activeRequested, __ATOMIC_ACQUIRE );
+
+    if( !active ) {
+      if( connected ) {
+        disconnect();
+      }
+    } else if( !connected || !client.connected() ) {
+      connected = false;
+      if( MQTT_RECONNECT_PERIOD <= millis() - lastConnectTry ) {
+        lastConnectTry = millis();
+        connect();
+      }
+    } else {
+      while( client.available() ) {
+        client.read();    // PINGRESP, nothing else is subscribed
+      }
+
+      // after reconnect backlog is flushed batch by batch
+      bool sent = publishEvents();
+      for( int x=0; sent && x<MQTT_SAMPLE_QUEUE/MQTT_BATCH_SAMPLES && MQTT_BATCH_SAMPLES <= sampleHead - sampleTail; x++ ) {
+        sent = publishSamples();
+      }
+
+      if( sent && SECONDS_TO_MILISECONDS( MQTT_KEEPALIVE ) / 2 <= millis() - lastSend ) {
+        sent = packetSend( MQTT_PINGREQ, 0 );
+      }
+      if( !sent ) {
+        LOG_Printf( LOG_WARNING, "MQTT: publish failed, reconnecting" );
+        client.stop();
+        connected = false;
+      }
+    }
+
+    vTaskDelay( MQTT_POLL_PERIOD / portTICK_PERIOD_MS );
+  }
+}
+
+void MQTT_Init( void ) {
+  if( initialized ) {
+    return;
+  }
+
+  taskHandle = xTaskCreateStaticPinnedToCore( vTaskMqtt, "MQTT", MQTT_STACK_SIZE, NULL, MQTT_TASK_PRIORITY, taskStack, &taskTCB, 0 );
+  assert( taskHandle );
+
+  initialized = true;
+}
+
+void MQTT_Activate( bool active ) {
+  __atomic_store_n( &activeRequested, active, __ATOMIC_RELEASE );
+}
+
+bool MQTT_Sample( const mqttSample_t * sample ) {
+  uint32_t start = ESP.getCycleCount();
+  uint32_t head = sampleHead;
+
+  if( MQTT_SAMPLE_QUEUE <= head - __atomic_load_n( &sampleTail, __ATOMIC_ACQUIRE ) ) {
+    __atomic_fetch_add( &dropped, 1, __ATOMIC_RELAXED );
+    costUpdate( start );
+    return false;
+  }
+
+  samples[ head & ( MQTT_SAMPLE_QUEUE - 1 ) ] = *sample;
+  __atomic_store_n( &sampleHead, head + 1, __ATOMIC_RELEASE );
+  costUpdate( start );
+  return true;
+}
+
+bool MQTT_Event( const char * name, int32_t value ) {
+  uint32_t start = ESP.getCycleCount();
+  uint32_t head = eventHead;
+
+  if( MQTT_EVENT_QUEUE <= head - __atomic_load_n( &eventTail, __ATOMIC_ACQUIRE ) ) {
+    costUpdate( start );
+    return false;
+  }
+
+  events[ head & ( MQTT_EVENT_QUEUE - 1 ) ] = { (uint32_t)millis(), name, value };
+  __atomic_store_n( &eventHead, head + 1, __ATOMIC_RELEASE );
+  costUpdate( start );
+  return true;
+}
+
+void MQTT_getStats( mqttStats_t * stats ) {
+  stats->queued = sampleHead - __atomic_load_n( &sampleTail, __ATOMIC_ACQUIRE );
+  stats->published = __atomic_load_n( &published, __ATOMIC_RELAXED );
+  stats->dropped = __atomic_load_n( &dropped, __ATOMIC_RELAXED );
+  stats->maxCycles = maxCycles;
+  stats->connected = connected;
+}
@@ -11,6 +11,9 @@ bool initialized = false;
 bool otaOnRequested = false;
 bool otaOffRequested = false;
 static otaActiveCb otaActiveCB = NULL;
+static otaCommandCb otaCommandCB = NULL;
+static char commandLine[ OTA_LINE_LENGTH ];   // telnet input collected up to new line
+static uint32_t commandLength = 0;
 
 WiFiServer server( PORT ); // server port to listen on
 WiFiClient client;
@@ -72,14 +75,32 @@ static void otaHandle() {
         }
         Serial.print( "New client: " );
         Serial.println( client.remoteIP() );
+        commandLength = 0;
+        if( client && NULL != otaCommandCB ) {
+          client.print( "ElectricStove shell, type 'help'\n> " );
+        }
       }
     }
     //check clients for data
     if ( client && client.connected() ) {
       if ( client.available() ) {
-        //get data from the telnet client and push it to the UART
+        //get data from the telnet client and pass complete lines to command handler (or push it to the UART)
         while ( client.available() ) {
-          Serial.write( client.read() );
+          int c = client.read();
+
+          if( NULL == otaCommandCB ) {
+            Serial.write( c );
+          } else if( '\r' == c || '\n' == c ) {
+            if( 0 < commandLength ) {
+              commandLine[ commandLength ] = '\0';
+              commandLength = 0;
+              if( !otaCommandCB( commandLine ) ) {
+                client.print( "Busy, try again\n> " );
+              }
+            }
+          } else if( ' ' <= c && '~' >= c && OTA_LINE_LENGTH - 1 > commandLength ) {   // telnet negotiation dropped
+            commandLine[ commandLength++ ] = (char)c;
+          }
         }
       }
     } else {
@@ -234,6 +255,12 @@ void OTA_setOtaActiveCallback( otaActiveCb func ) {
   }
 }
 
+void OTA_setCommandCallback( otaCommandCb func ) {
+  if( NULL != func ) {
+    otaCommandCB = func;
+  }
+}
+
 void OTA_LogWrite( const char *buf ) {
   if( false == initialized ) {
     return;
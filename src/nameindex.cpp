@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "nameindex.h"
+#include "hal.h"
+
+typedef struct {
+  uint32_t sig[2];    // trigram signature: bit set for every (hashed) trigram of lower case name
+  uint32_t pos;       // position on the list
+} nidxEntry_t;
+
+static nidxNameCb getNameCB = NULL;
+static nidxCountCb getCountCB = NULL;
+static nidxEntry_t * entries = NULL;      // sorted by name (dynamically allocated)
+static uint32_t entriesSize = 0;          // allocated entries
+static uint32_t entriesCount = 0;
+static bool indexValid = false;           // entries reflect the list, otherwise rebuilt on next search
+
+static inline const char * entryName( const nidxEntry_t * entry ) {
+  const char * name = getNameCB( entry->pos );
+  return ( NULL != name ) ? name : "";
+}
+
+static void signature( const char * text, uint32_t sig[2] ) {
+  uint32_t len = strlen( text );
+
+  sig[0] = 0;
+  sig[1] = 0;
+  for( int x=0; x+2<len; x++ ) {
+    uint32_t hash = tolower( (uint8_t)text[x] ) * 0x9E3779B1u
+                  ^ tolower( (uint8_t)text[x+1] ) * 0x85EBCA77u
+                  ^ tolower( (uint8_t)text[x+2] ) * 0xC2B2AE3Du;
+    hash >>= 26;  // 0-63
+    sig[ hash / 32 ] |= 1u << ( hash % 32 );
+  }
+}
+
+/**
+ * Case insensitive strstr()
+ */
+static bool containsNoCase( const char * text, const char * query, uint32_t queryLen ) {
+  for( ; *text; text++ ) {
+    if( 0 == strncasecmp( text, query, queryLen ) ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool reserveEntries( uint32_t count ) {
+  if( entriesSize < count ) {
+    uint32_t newSize = ( NIDX_MIN_SIZE > entriesSize ) ? NIDX_MIN_SIZE : entriesSize;
+    while( newSize < count ) {
+      newSize *= 2;
+    }
+
+    nidxEntry_t * tmpEntries = (nidxEntry_t *)realloc( entries, newSize * sizeof( nidxEntry_t ) );
+    if( NULL == tmpEntries ) {
+      HAL_printf( "NIDX(reserveEntries): realloc failed!\n" );
+      return false;
+    }
+    entries = tmpEntries;
+    entriesSize = newSize;
+  }
+  return true;
+}
+
+static int compareEntries( const void * a, const void * b ) {
+  int retVal = strcasecmp( entryName( (const nidxEntry_t *)a ), entryName( (const nidxEntry_t *)b ) );
+
+  if( 0 == retVal ) {   // equal names keep list order
+    retVal = ( ((const nidxEntry_t *)a)->pos < ((const nidxEntry_t *)b)->pos ) ? -1 : 1;
+  }
+  return retVal;
+}
+
+static bool rebuild() {
+  uint32_t count = getCountCB();
+  uint32_t start = HAL_micros();
+
+  if( !reserveEntries( count ) ) {
+    return false;
+  }
+
+  for( int x=0; x<count; x++ ) {
+    entries[x].pos = x;
+    signature( entryName( &entries[x] ), entries[x].sig );
+  }
+  qsort( entries, count, sizeof( nidxEntry_t ), compareEntries );
+  entriesCount = count;
+  indexValid = true;
+
+  HAL_printf( "NIDX: %u names indexed in %u[uS]\n", count, HAL_micros() - start );
+  return true;
+}
+
+void NIDX_Init( nidxNameCb getName, nidxCountCb getCount ) {
+  getNameCB = getName;
+  getCountCB = getCount;
+  indexValid = false;
+}
+
+void NIDX_Invalidate( void ) {
+  indexValid = false;
+  entriesCount = 0;
+}
+
+void NIDX_Rebuild( void ) {
+  if( NULL != getNameCB && NULL != getCountCB ) {
+    rebuild();
+  }
+}
+
+void NIDX_Add( uint32_t pos ) {
+  const char * name;
+  uint32_t low = 0;
+  uint32_t high = entriesCount;
+
+  if( !indexValid ) {
+    return;
+  }
+
+  if( !reserveEntries( entriesCount + 1 ) ) {
+    NIDX_Invalidate();
+    return;
+  }
+
+  // insert after all equal names (new position is the last one on the list)
+  name = getNameCB( pos );
+  name = ( NULL != name ) ? name : "";
+  while( low < high ) {
+    uint32_t mid = ( low + high ) / 2;
+
+    if( 0 >= strcasecmp( entryName( &entries[ mid ] ), name ) ) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  memmove( &entries[ low + 1 ], &entries[ low ], ( entriesCount - low ) * sizeof( nidxEntry_t ) );
+  entries[ low ].pos = pos;
+  signature( name, entries[ low ].sig );
+  entriesCount++;
+}
+
+void NIDX_Remove( const uint8_t removed[], uint32_t oldCount ) {
+  uint16_t * newPos;
+  uint32_t kept = 0;
+
+  if( !indexValid ) {
+    return;
+  }
+
+  newPos = (uint16_t *)malloc( oldCount * sizeof( uint16_t ) );
+  if( NULL == newPos ) {
+    NIDX_Invalidate();
+    return;
+  }
+
+  for( int x=0; x<oldCount; x++ ) {
+    newPos[x] = kept;
+    if( 0 == ( removed[ x / 8 ] & ( 1 << ( x % 8 ) ) ) ) {
+      kept++;
+    }
+  }
+
+  // drop removed entries, sort order of the remaining ones doesn't change
+  kept = 0;
+  for( int x=0; x<entriesCount; x++ ) {
+    uint32_t pos = entries[x].pos;
+
+    if( 0 == ( removed[ pos / 8 ] & ( 1 << ( pos % 8 ) ) ) ) {
+      entries[ kept ] = entries[x];
+      entries[ kept++ ].pos = newPos[ pos ];
+    }
+  }
+  entriesCount = kept;
+
+  free( newPos );
+}
+
+void NIDX_Swap( uint32_t first, uint32_t second ) {
+  if( !indexValid ) {
+    return;
+  }
+
+  for( int x=0; x<entriesCount; x++ ) {
+    if( first == entries[x].pos ) {
+      entries[x].pos = second;
+    } else if( second == entries[x].pos ) {
+      entries[x].pos = first;
+    }
+  }
+}
+
+void NIDX_Move( uint32_t from, uint32_t to ) {
+  if( !indexValid ) {
+    return;
+  }
+
+  for( int x=0; x<entriesCount; x++ ) {
+    uint32_t pos = entries[x].pos;
+
+    if( from == pos ) {
+      entries[x].pos = to;
+    } else if( from < to && from < pos && to >= pos ) {
+      entries[x].pos = pos - 1;
+    } else if( to < from && to <= pos && from > pos ) {
+      entries[x].pos = pos + 1;
+    }
+  }
+}
+
+void NIDX_Reorder( const uint16_t order[], uint32_t count ) {
+  uint16_t * newPos;
+
+  if( !indexValid ) {
+    return;
+  }
+
+  newPos = (uint16_t *)malloc( count * sizeof( uint16_t ) );
+  if( NULL == newPos || count != entriesCount ) {
+    free( newPos );
+    NIDX_Invalidate();
+    return;
+  }
+
+  for( int x=0; x<count; x++ ) {
+    newPos[ order[x] ] = x;
+  }
+  for( int x=0; x<entriesCount; x++ ) {
+    entries[x].pos = newPos[ entries[x].pos ];
+  }
+
+  free( newPos );
+}
+
+uint32_t NIDX_Find( const char * query, uint16_t results[], uint32_t max ) {
+  uint32_t queryLen;
+  uint32_t found = 0;
+  uint32_t low = 0;
+  uint32_t high;
+
+  if( NULL == getNameCB || NULL == query || NULL == results ) {
+    return 0;
+  }
+
+  if( !indexValid && !rebuild() ) {
+    return 0;
+  }
+
+  // prefix matches are continuous range in sorted index
+  queryLen = strlen( query );
+  high = entriesCount;
+  while( low < high ) {
+    uint32_t mid = ( low + high ) / 2;
+
+    if( 0 > strncasecmp( entryName( &entries[ mid ] ), query, queryLen ) ) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  for( int x=low; x<entriesCount && found<max; x++ ) {
+    if( 0 != strncasecmp( entryName( &entries[x] ), query, queryLen ) ) {
+      break;
+    }
+    results[ found++ ] = entries[x].pos;
+  }
+
+  // names containing query: trigram signature rejects most of them without touching the name
+  if( NIDX_TRIGRAM_MIN <= queryLen ) {
+    uint32_t sig[2];
+
+    signature( query, sig );
+    for( int x=0; x<entriesCount && found<max; x++ ) {
+      const char * name;
+
+      if( ( entries[x].sig[0] & sig[0] ) != sig[0] || ( entries[x].sig[1] & sig[1] ) != sig[1] ) {
+        continue;
+      }
+      name = entryName( &entries[x] );
+      if( 0 != strncasecmp( name, query, queryLen ) && containsNoCase( name, query, queryLen ) ) {
+        results[ found++ ] = entries[x].pos;
+      }
+    }
+  }
+
+  return found;
+}
@@ -0,0 +1,353 @@
+#ifndef ARDUINO
+
+// [env:native] entry point
+// usage: .pio/build/native/program [check] [bakes.txt]                  - compile every bake and print its timeline
+//        .pio/build/native/program sim [options] [bakes.txt]            - import bakes into the list, run each one by the controller
+//                                                                         against furnace model, print metrics
+//                                                                         (exit code 1 also when metrics contradict each other)
+//        options: -a ambient[C] -p power[W] -c capacity[J/K] -l loss[W/K] -d deadTime[s] -e elementLag[s] -s sensorLag[s]
+//                 -b band[C] -u userDelay[s]
+//        .pio/build/native/program bench [bakes.txt]                    - hot path benchmarks as JSON lines
+//                                                                         (bake list of NATIVE_BENCH_BAKES copies of the file's bakes)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <ArduinoJson.h>
+#include "hal.h"
+#include "helper.h"
+#include "recipe.h"
+#include "recorder.h"
+#include "sim.h"
+#include "bench.h"
+#include "buzzer.h"
+#include "config.h"
+#include "sdcard.h"
+#include "persist.h"
+#include "controller.h"
+
+#define NATIVE_BAKES_FILE     "tools/bakes.txt"
+#define NATIVE_WORKDIR        "/tmp/oven-XXXXXX"    // flash/ and sdcard/ of the HAL while config runs
+#define NATIVE_IDLE_POLL      100     // persistence worker is checked this often while waiting for it [ms]
+#define NATIVE_BENCH_BAKES    200     // bake list size for config benchmark (about a full list on the device)
+
+typedef void (* bakeCb)( recipe_t * recipe );
+
+static recipe_t     recipe;
+static bakeStep_t   steps[ BAKE_MAX_STEPS ];
+static simResult_t  result;
+static uint32_t     simFailed;      // runs with contradicting metrics
+static char         workDir[] = NATIVE_WORKDIR;
+
+// no SD card on the host, runs are not recorded
+void REC_Start( const char * name ) {
+}
+
+void REC_Stop( void ) {
+}
+
+void REC_Event( uint16_t events ) {
+}
+
+void REC_Sample( float temp, uint16_t setpoint, uint8_t power, uint8_t state ) {
+}
+
+static char * fileRead( const char * path ) {
+  FILE * f = fopen( path, "rb" );
+  char * buf = NULL;
+  long size;
+
+  if( NULL == f ) {
+    return NULL;
+  }
+  if( 0 == fseek( f, 0, SEEK_END ) && 0 <= ( size = ftell( f ) ) && 0 == fseek( f, 0, SEEK_SET ) ) {
+    buf = (char *)malloc( size + 1 );
+    if( NULL != buf ) {
+      buf[ fread( buf, 1, size, f ) ] = 0;
+    }
+  }
+  fclose( f );
+  return buf;
+}
+
+/**
+ * Compile every bake from the bake list file (same format as on flash) and pass it to func
+ *
+ * return   - number of invalid bakes, -1 when file can't be read
+ */
+static int32_t bakesForEach( const char * path, bakeCb func ) {
+  uint32_t invalid = 0;
+  JsonDocument doc;
+
+  char * json = fileRead( path );
+  if( NULL == json ) {
+    HAL_printf( "Can't read %s\n", path );
+    return -1;
+  }
+
+  DeserializationError error = deserializeJson( doc, json );
+  free( json );
+  if( error ) {
+    HAL_printf( "%s: %s\n", path, error.c_str() );
+    return -1;
+  }
+
+  for( JsonVariantConst bake : doc["data"].as<JsonArrayConst>() ) {
+    uint32_t count = bake["stepCount"] | 0;
+
+    if( BAKE_MAX_STEPS < count ) {
+      count = BAKE_MAX_STEPS;
+    }
+    for( uint32_t s=0; s<count; s++ ) {
+      steps[s].temp = bake["step"][s]["temp"];
+      steps[s].time = bake["step"][s]["time"];
+    }
+
+    if( RECIPE_Compile( bake["name"] | "", steps, count, &recipe ) ) {
+      func( &recipe );
+    } else {
+      HAL_printf( "'%s' is invalid\n", (const char *)( bake["name"] | "" ) );
+      invalid++;
+    }
+  }
+  return invalid;
+}
+
+static void recipePrint( recipe_t * recipe ) {
+  HAL_printf( "'%s': %u segments, total %u[s]\n", recipe->name, recipe->count, recipe->totalTime / 1000 );
+  for( uint32_t x=0; x<recipe->count; x++ ) {
+    const recipeSegment_t * segment = &recipe->segment[x];
+
+    HAL_printf( "  %3u: event %2d, temp %3u[C], time %6u[s], deadline %6u[s], remaining after %6u[s]\n", x + 1, segment->event,
+                segment->temp, segment->time / 1000, segment->deadline / 1000, segment->remainingAfter / 1000 );
+  }
+}
+
+static int workdirRemove( const char * path, const struct stat * st, int flag, struct FTW * ftw ) {
+  return remove( path );
+}
+
+static void persistWait( void ) {
+  while( !PERSIST_isIdle() ) {
+    HAL_delay( NATIVE_IDLE_POLL );    // bake list snapshot is being written
+  }
+}
+
+/**
+ * Write bake list file for the card with bakes of another list repeated (numbered names)
+ * json     - bake list file content
+ * copies   - number of bakes written
+ */
+static bool cardListWrite( const char * json, uint32_t copies ) {
+  JsonDocument in, out;
+  char name[ BAKE_NAME_LENGTH ];
+  uint32_t x = 0;
+  bool retVal = false;
+
+  if( deserializeJson( in, json ) || 0 == in["data"].size() ) {
+    return false;
+  }
+
+  JsonArray data = out["data"].to<JsonArray>();
+  while( x < copies ) {
+    for( JsonVariantConst bake : in["data"].as<JsonArrayConst>() ) {
+      if( copies <= x++ ) {
+        break;
+      }
+      JsonObject copy = data.add<JsonObject>();
+      copy.set( bake.as<JsonObjectConst>() );
+      snprintf( name, sizeof( name ), "%s %u", (const char *)( bake["name"] | "" ), x );
+      copy["name"] = name;
+    }
+  }
+  out["count"] = copies;
+
+  size_t len = measureJson( out );
+  char * buf = (char *)malloc( len + 1 );
+  FILE * f = fopen( SD_HOST_ROOT BAKE_FILE_NAME, "w" );
+  if( NULL != buf && NULL != f ) {
+    serializeJson( out, buf, len + 1 );
+    retVal = ( len == fwrite( buf, 1, len, f ) );
+  }
+  if( NULL != f ) {
+    fclose( f );
+  }
+  free( buf );
+  return retVal;
+}
+
+/**
+ * Move to empty temporary directory, so that config starts with empty flash and the bake list file on the card
+ * bakes    - bake list file, linked to the card as it is
+ * copies   - 0 or number of bakes written to the card instead, the file's bakes are repeated
+ *
+ * return   - false when the file can't be read or the directory can't be prepared
+ */
+static bool workdirEnter( const char * bakes, uint32_t copies ) {
+  char * path = realpath( bakes, NULL );
+  char * json = ( NULL != path && 0 < copies ) ? fileRead( path ) : NULL;
+  bool retVal = false;
+
+  if( NULL == path || ( 0 < copies && NULL == json ) ) {
+    HAL_printf( "Can't read %s\n", bakes );
+    free( path );
+    return false;
+  }
+  if( NULL != mkdtemp( workDir ) && 0 == chdir( workDir ) && 0 == mkdir( SD_HOST_ROOT, 0755 ) ) {
+    retVal = ( 0 < copies ) ? cardListWrite( json, copies ) : ( 0 == symlink( path, SD_HOST_ROOT BAKE_FILE_NAME ) );
+  }
+  if( !retVal ) {
+    HAL_printf( "Can't prepare %s\n", workDir );
+  }
+  free( json );
+  free( path );
+  return retVal;
+}
+
+static void workdirLeave( void ) {
+  persistWait();
+  if( 0 == chdir( "/" ) ) {
+    nftw( workDir, workdirRemove, 8, FTW_DEPTH | FTW_PHYS );
+  }
+}
+
+/**
+ * Import bake list file as the device does (SD card), persisted on flash in the background
+ * bakes    - bake list file
+ * copies   - see workdirEnter()
+ *
+ * return   - number of bakes on the list, -1 when the work directory can't be prepared
+ */
+static int32_t configStart( const char * bakes, uint32_t copies ) {
+  if( !workdirEnter( bakes, copies ) ) {
+    return -1;
+  }
+  PERSIST_Init();
+  CONF_Init( NULL );    // no SPI bus behind the host card
+  CONF_addBakesFromFile();
+  return CONF_getBakeCount();
+}
+
+/**
+ * Run every bake on the list by the controller
+ *
+ * return   - number of invalid bakes
+ */
+static uint32_t bakesSimulate( uint32_t count ) {
+  char name[ BAKE_NAME_LENGTH ];
+  uint32_t invalid = 0;
+
+  for( uint32_t idx=0; idx<count; idx++ ) {
+    uint32_t stepCount = CONF_copyBake( idx, name, sizeof( name ), steps, BAKE_MAX_STEPS );
+
+    if( !RECIPE_Compile( name, steps, stepCount, &recipe ) ) {
+      HAL_printf( "'%s' is invalid\n", name );   // refused by the controller too
+      invalid++;
+      continue;
+    }
+    SIM_Run( idx, &recipe, &result );
+    SIM_Print( &recipe, &result );
+    if( !SIM_Check( &result ) ) {
+      simFailed++;
+    }
+  }
+  return invalid;
+}
+
+static int check( int argc, char * argv[] ) {
+  const char * path = ( optind < argc ) ? argv[ optind ] : NATIVE_BAKES_FILE;
+
+  int32_t invalid = bakesForEach( path, recipePrint );
+  return ( 0 > invalid ) ? 2 : ( 0 == invalid ) ? 0 : 1;
+}
+
+static int simulate( int argc, char * argv[] ) {
+  simConfig_t config;
+  int opt;
+
+  PLANT_getDefaults( &config.plant );
+  config.band = SIM_BAND;
+  config.userDelay = SIM_USER_DELAY * 1000;
+
+  while( -1 != ( opt = getopt( argc, argv, "a:p:c:l:d:e:s:b:u:" ) ) ) {
+    float value = strtof( optarg, NULL );
+
+    switch( opt ) {
+      case 'a': { config.plant.ambient = value; break; }
+      case 'p': { config.plant.power = value; break; }
+      case 'c': { config.plant.capacity = value; break; }
+      case 'l': { config.plant.loss = value; break; }
+      case 'd': { config.plant.deadTime = value; break; }
+      case 'e': { config.plant.elementLag = value; break; }
+      case 's': { config.plant.sensorLag = value; break; }
+      case 'b': { config.band = value; break; }
+      case 'u': { config.userDelay = (uint32_t)( value * 1000 ); break; }
+      default: {
+        return 2;
+      }
+    }
+  }
+
+  HAL_printf( "Plant: ambient %.1f[C], %.0f[W], %.0f[J/K], loss %.2f[W/K], dead time %.1f[s], element %.1f[s], sensor %.1f[s]\n",
+              config.plant.ambient, config.plant.power, config.plant.capacity, config.plant.loss, config.plant.deadTime,
+              config.plant.elementLag, config.plant.sensorLag );
+  SIM_Init( &config );    // logger is not started, its task would wake up every LOG_DRAIN_PERIOD of simulated time
+
+  int32_t count = configStart( ( optind < argc ) ? argv[ optind ] : NATIVE_BAKES_FILE, 0 );
+  if( 0 >= count ) {
+    if( 0 == count ) {
+      HAL_printf( "No bakes imported\n" );
+      workdirLeave();
+    }
+    return 2;
+  }
+
+  CTRL_Init();
+  uint32_t invalid = bakesSimulate( count );
+  workdirLeave();
+  return ( 0 == invalid && 0 == simFailed ) ? 0 : 1;
+}
+
+static int benchmark( int argc, char * argv[] ) {
+  simConfig_t config;
+  bool done;
+
+  PLANT_getDefaults( &config.plant );
+  config.band = SIM_BAND;
+  config.userDelay = SIM_USER_DELAY * 1000;
+  SIM_Init( &config );    // heater reads the plant, its task runs only when the benchmark waits for PID
+  BUZZ_Init();
+  if( 0 > configStart( ( optind < argc ) ? argv[ optind ] : NATIVE_BAKES_FILE, NATIVE_BENCH_BAKES ) ) {
+    return 2;
+  }
+  persistWait();    // imported list is on flash, benchmark doesn't swap the list while its snapshot is written
+
+  done = BENCH_Run( HAL_print );
+  workdirLeave();
+  if( !done ) {
+    HAL_printf( "Benchmark not available (build with BENCH_ENABLE)\n" );
+    return 2;
+  }
+  return 0;
+}
+
+int main( int argc, char * argv[] ) {
+  optind = 1;
+  if( 1 < argc && 0 == strcmp( argv[1], "bench" ) ) {
+    optind = 2;
+    return benchmark( argc, argv );
+  }
+  if( 1 < argc && 0 == strcmp( argv[1], "sim" ) ) {
+    optind = 2;
+    return simulate( argc, argv );
+  }
+  if( 1 < argc && 0 == strcmp( argv[1], "check" ) ) {
+    optind = 2;
+  }
+  return check( argc, argv );
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,159 @@
+#include <assert.h>
+#include "persist.h"
+#include "logger.h"
+#include "hal.h"
+
+#define PERSIST_NOTIFY_QUEUE    0x01                    // request was queued
+#define PERSIST_NOTIFY_SIGNAL   0x02                    // PERSIST_SIGNAL_x bits follow
+
+typedef struct {
+  persistJob    job;
+  void *        arg;
+  persistDoneCb done;
+} persistRequest_t;
+
+static persistRequest_t   requestList[ PERSIST_QUEUE_LENGTH ];   // ring buffer, guarded by mutex
+static uint32_t           requestHead = 0;                        // next request to run
+static uint32_t           requestCount = 0;
+static bool               jobRunning = false;                     // guarded by mutex
+static persistJob         signalJobs[ PERSIST_SIGNAL_COUNT ];     // set before the worker gets signals
+static uint32_t           failSignalCounter = 0;                  // debug purpose only
+static bool               initialized = false;
+static uint32_t           failSemaphoreCounter = 0;               // debug purpose only
+static halMutex_t         mutex;
+static halTask_t          task;
+static halStack_t         taskStack[ PERSIST_STACK_SIZE ];
+
+static void vTaskPersist( void * pvParameters ) {
+  persistRequest_t request;
+  bool available;
+  uint32_t notified;
+
+  while( 1 ) {
+    notified = HAL_taskWait( HAL_WAIT_FOREVER );
+
+    for( int x=0; x<PERSIST_SIGNAL_COUNT; x++ ) {
+      if( ( notified & ( PERSIST_NOTIFY_SIGNAL << x ) ) && NULL != signalJobs[x] ) {
+        HAL_mutexTake( &mutex, HAL_WAIT_FOREVER );
+        jobRunning = true;
+        HAL_mutexGive( &mutex );
+
+        if( !signalJobs[x]( NULL ) ) {
+          LOG_Printf( LOG_WARNING, "PERSIST: signal %d job failed", x );
+        }
+
+        HAL_mutexTake( &mutex, HAL_WAIT_FOREVER );
+        jobRunning = false;
+        HAL_mutexGive( &mutex );
+      }
+    }
+
+    do {
+      available = false;
+      if( HAL_mutexTake( &mutex, HAL_WAIT_FOREVER ) ) {
+        if( 0 < requestCount ) {
+          request = requestList[ requestHead ];
+          requestHead = ( requestHead + 1 ) % PERSIST_QUEUE_LENGTH;
+          requestCount--;
+          jobRunning = true;
+          available = true;
+        }
+        HAL_mutexGive( &mutex );
+      }
+
+      if( available ) {
+        uint32_t start = HAL_micros();
+        bool success = request.job( request.arg );
+
+        HAL_printf( "PERSIST: job %s in %u[uS]\n", success ? "done" : "failed", HAL_micros() - start );
+        if( NULL != request.done ) {
+          request.done( success );
+        }
+
+        HAL_mutexTake( &mutex, HAL_WAIT_FOREVER );
+        jobRunning = false;
+        HAL_mutexGive( &mutex );
+      }
+    } while( available );
+  }
+}
+
+void PERSIST_Init( void ) {
+  if( initialized ) {
+    return;
+  }
+
+  HAL_mutexInit( &mutex );
+
+  bool created = HAL_taskCreate( &task, vTaskPersist, "Persist", taskStack, PERSIST_STACK_SIZE, PERSIST_TASK_PRIORITY, 0 );
+  assert( created );
+
+  initialized = true;
+}
+
+bool PERSIST_Submit( persistJob job, void * arg, persistDoneCb done ) {
+  bool retVal = false;
+
+  if( false == initialized || NULL == job ) {
+    return false;
+  }
+
+  if( HAL_mutexTake( &mutex, 1000 ) ) {
+    // merge with identical waiting request (e.g. many edits in a row need only one flush)
+    for( int x=0; x<requestCount; x++ ) {
+      persistRequest_t * req = &requestList[ ( requestHead + x ) % PERSIST_QUEUE_LENGTH ];
+      if( job == req->job && arg == req->arg && done == req->done ) {
+        retVal = true;
+        break;
+      }
+    }
+
+    if( !retVal && PERSIST_QUEUE_LENGTH > requestCount ) {
+      persistRequest_t * req = &requestList[ ( requestHead + requestCount ) % PERSIST_QUEUE_LENGTH ];
+      req->job = job;
+      req->arg = arg;
+      req->done = done;
+      requestCount++;
+      retVal = true;
+    }
+    HAL_mutexGive( &mutex );
+  } else {
+    failSemaphoreCounter++;
+    LOG_Printf( LOG_ERROR, "PERSIST(Submit): couldn't take semaphore %u times", failSemaphoreCounter );
+  }
+
+  if( retVal ) {
+    HAL_taskNotify( &task, PERSIST_NOTIFY_QUEUE );
+  } else {
+    LOG_Printf( LOG_ERROR, "PERSIST(Submit): request rejected" );
+  }
+
+  return retVal;
+}
+
+void PERSIST_setSignalJob( persistSignal signal, persistJob job ) {
+  if( PERSIST_SIGNAL_COUNT > signal ) {
+    signalJobs[ signal ] = job;
+  }
+}
+
+void PERSIST_Signal( persistSignal signal ) {
+  if( false == initialized || PERSIST_SIGNAL_COUNT <= signal || NULL == signalJobs[ signal ] ) {
+    failSignalCounter++;
+    LOG_Printf( LOG_ERROR, "PERSIST(Signal): signal %d not registered (%u times)", signal, failSignalCounter );
+    return;
+  }
+
+  HAL_taskNotify( &task, PERSIST_NOTIFY_SIGNAL << signal );
+}
+
+bool PERSIST_isIdle( void ) {
+  bool retVal = false;
+
+  if( initialized && HAL_mutexTake( &mutex, 1000 ) ) {
+    retVal = ( 0 == requestCount && !jobRunning );
+    HAL_mutexGive( &mutex );
+  }
+
+  return retVal;
+}
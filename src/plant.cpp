@@ -0,0 +1,78 @@
+#include <string.h>
+#include "plant.h"
+
+static plantParams_t      plant;
+static float              dt;                                 // [s]
+static bool               deadLine[ PLANT_DEAD_STEPS_MAX ];   // relay states waiting for dead time to pass
+static uint32_t           deadLength;                         // [steps]
+static uint32_t           deadPos;
+static float              elementPower;                       // heat flow from element to the oven [W]
+static float              ovenTemp;                           // [C]
+static float              sensorTemp;                         // [C]
+
+void PLANT_getDefaults( plantParams_t * params ) {
+  params->ambient = 20.0f;
+  params->power = 2000.0f;
+  params->capacity = 8000.0f;     // oven time constant capacity/loss ~ 20 minutes, 230C in ~20 minutes
+  params->loss = 7.0f;            // steady state: ambient + power/loss ~ 300C
+  params->deadTime = 8.0f;
+  params->elementLag = 45.0f;
+  params->sensorLag = 6.0f;
+}
+
+void PLANT_Init( const plantParams_t * params, float step ) {
+  plant = *params;
+  dt = step;
+
+  deadLength = (uint32_t)( plant.deadTime / dt + 0.5f );
+  if( PLANT_DEAD_STEPS_MAX < deadLength ) {
+    deadLength = PLANT_DEAD_STEPS_MAX;
+  }
+  memset( deadLine, 0, sizeof( deadLine ) );
+  deadPos = 0;
+
+  elementPower = 0.0f;
+  ovenTemp = plant.ambient;
+  sensorTemp = plant.ambient;
+}
+
+// first order lag for one step, stable for any time constant
+static float lag( float value, float target, float timeConstant ) {
+  if( dt >= timeConstant ) {
+    return target;
+  }
+  return value + ( target - value ) * dt / timeConstant;
+}
+
+void PLANT_Step( bool heaterOn ) {
+  bool delayed = heaterOn;
+
+  if( 0 < deadLength ) {
+    delayed = deadLine[ deadPos ];
+    deadLine[ deadPos ] = heaterOn;
+    deadPos = ( deadPos + 1 ) % deadLength;
+  }
+
+  elementPower = lag( elementPower, delayed ? plant.power : 0.0f, plant.elementLag );
+  ovenTemp += ( elementPower - plant.loss * ( ovenTemp - plant.ambient ) ) * dt / plant.capacity;
+  sensorTemp = lag( sensorTemp, ovenTemp, plant.sensorLag );
+}
+
+float PLANT_getTemperature( void ) {
+  return ovenTemp;
+}
+
+float PLANT_getSensor( void ) {
+  return sensorTemp;
+}
+
+uint16_t PLANT_readMax6675( void ) {
+  float temp = sensorTemp;
+
+  if( 0.0f > temp ) {
+    temp = 0.0f;
+  } else if( PLANT_TC_MAX < temp ) {
+    temp = PLANT_TC_MAX;
+  }
+  return (uint16_t)( (uint16_t)( temp / PLANT_TC_RESOLUTION ) << 3 );   // truncated like the converter does
+}
@@ -0,0 +1,122 @@
+#include <string.h>
+#include "recipe.h"
+#include "heater.h"
+
+static uint16_t limitTemp( int32_t temp ) {
+  if( MAX_ALLOWED_TEMP < temp ) {
+    return MAX_ALLOWED_TEMP;
+  }
+  if( MIN_ALLOWED_TEMP > temp ) {
+    return MIN_ALLOWED_TEMP;
+  }
+  return (uint16_t)temp;
+}
+
+static uint32_t limitTime( int32_t seconds ) {
+  uint64_t time = ( 0 < seconds ) ? SECONDS_TO_MILISECONDS( (uint64_t)seconds ) : 0;
+
+  return ( MAX_ALLOWED_TIME < time ) ? MAX_ALLOWED_TIME : (uint32_t)time;
+}
+
+// step from the bake file >> segment, false for unknown event
+static bool segmentCompile( const bakeStep_t * step, recipeSegment_t * segment ) {
+  segment->event = ( 0 < step->time ) ? 0 : step->time;
+  segment->temp = 0;
+  segment->time = 0;
+  segment->deadline = 0;
+
+  switch( segment->event ) {
+    case 0: {
+      segment->temp = limitTemp( step->temp );
+      segment->time = limitTime( step->time );
+      segment->deadline = segment->time;
+      break;
+    }
+    case EVENT_PREHEATING: {
+      segment->temp = limitTemp( step->temp );    // temp has different meaning in special event
+      segment->deadline = EVENT_PREHEATING_MAX_TIME;
+      break;
+    }
+    case EVENT_PAUSE: {
+      segment->temp = limitTemp( step->temp );
+      segment->deadline = EVENT_PAUSE_MAX_TIME;
+      break;
+    }
+    case EVENT_TIMER: {
+      segment->time = limitTime( step->temp );    // heater off, temp field keeps the time [s]
+      segment->deadline = segment->time;
+      break;
+    }
+    case EVENT_SOUND:
+    case EVENT_END: {
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RECIPE_Compile( const char * name, const bakeStep_t steps[], uint32_t count, recipe_t * recipe ) {
+  uint32_t total = 0;
+
+  strncpy( recipe->name, name, sizeof( recipe->name ) - 1 );
+  recipe->name[ sizeof( recipe->name ) - 1 ] = 0;
+  recipe->count = 0;
+  recipe->current = 0;
+  recipe->totalTime = 0;
+
+  for( uint32_t x=0; x<count && RECIPE_SEGMENTS_MAX > recipe->count; x++ ) {
+    recipeSegment_t * segment = &recipe->segment[ recipe->count ];
+
+    if( 0 == steps[x].time ) {
+      break;    // end of the curve
+    }
+    if( !segmentCompile( &steps[x], segment ) ) {
+      HAL_printf( "RECIPE: '%s' step %u has invalid event code %d\n", recipe->name, x + 1, steps[x].time );
+      recipe->count = 0;
+      return false;
+    }
+
+    recipe->count++;
+    total += segment->time;
+    if( EVENT_END == segment->event ) {
+      break;    // waits for user, nothing after it can run
+    }
+  }
+
+  if( 0 == recipe->count ) {
+    return false;
+  }
+
+  // expected time after each segment, so remaining time is O(1) while running
+  recipe->totalTime = total;
+  for( uint32_t x=0; x<recipe->count; x++ ) {
+    total -= recipe->segment[x].time;
+    recipe->segment[x].remainingAfter = total;
+  }
+
+  return true;
+}
+
+void RECIPE_Rewind( recipe_t * recipe ) {
+  recipe->current = 0;
+}
+
+const recipeSegment_t * RECIPE_Current( const recipe_t * recipe ) {
+  return ( recipe->current < recipe->count ) ? &recipe->segment[ recipe->current ] : NULL;
+}
+
+const recipeSegment_t * RECIPE_Next( recipe_t * recipe ) {
+  if( recipe->current < recipe->count ) {
+    recipe->current++;
+  }
+  return RECIPE_Current( recipe );
+}
+
+uint32_t RECIPE_getRemaining( const recipe_t * recipe, uint32_t segmentRemaining ) {
+  const recipeSegment_t * segment = RECIPE_Current( recipe );
+
+  return ( NULL != segment ) ? segmentRemaining + segment->remainingAfter : 0;
+}
@@ -0,0 +1,143 @@
+#include <Arduino.h>
+#include "recorder.h"
+#include "sdcard.h"
+#include "persist.h"
+
+static_assert( REC_BLOCK_SIZE == SD_BULK_SIZE, "blocks have to match SD bulk writes" );
+
+typedef struct __attribute__((packed)) recBlock {
+  recBlockHeader_t  header;
+  recSample_t       sample[ REC_BLOCK_SAMPLES ];
+} recBlock_t;
+
+// single producer (heater task) / single consumer (persistence worker) ring, indexes are free running
+static recSample_t        ring[ REC_RING_SAMPLES ];
+static uint32_t           ringHead = 0;             // written by heater task only
+static uint32_t           ringTail = 0;             // written by persistence worker only
+static uint32_t           pendingEvents = 0;        // REC_EVENT_x waiting for next sample (any task)
+static bool               flushQueued = false;      // block flush signalled and not finished yet
+static bool               finishRequested = false;  // run ended, its last (partial) block has to be written
+static bool               recording = false;        // heater task only
+static uint32_t           lastSampleTime;           // heater task only
+static uint32_t           dropped = 0;              // samples lost because of full ring, heater task only
+static char               runName[ REC_NAME_LENGTH ];   // set by REC_Start(), taken by worker with run's first sample
+static uint32_t           runStart = 0;
+static recBlock_t         block;                    // persistence worker only
+static uint32_t           blockRunStart = 0;        // persistence worker only
+static char               blockRunName[ REC_NAME_LENGTH ];
+static uint16_t           blockNumber = 0;
+
+/**
+ * Write collected samples to SD card in blocks (persistence worker)
+ * Only full blocks are written during the run, the rest when the run is finished
+ */
+static bool recFlush( void * arg ) {
+  bool finish = __atomic_exchange_n( &finishRequested, false, __ATOMIC_ACQ_REL );
+  bool retVal = true;
+
+  while( 1 ) {
+    uint32_t head = __atomic_load_n( &ringHead, __ATOMIC_ACQUIRE );
+    uint32_t count = 0;
+    bool cut = false;
+
+    while( ringTail + count != head && REC_BLOCK_SAMPLES > count ) {
+      const recSample_t * sample = &ring[ ( ringTail + count ) & ( REC_RING_SAMPLES - 1 ) ];
+
+      if( sample->events & REC_EVENT_RUN_START ) {
+        if( 0 < count ) {
+          cut = true;   // new run always starts new block
+          break;
+        }
+        blockRunStart = runStart;
+        memcpy( blockRunName, runName, sizeof( blockRunName ) );
+        blockNumber = 0;
+      }
+      block.sample[ count++ ] = *sample;
+    }
+
+    if( 0 == count || ( REC_BLOCK_SAMPLES > count && !cut && !finish ) ) {
+      break;    // partial block waits for more samples
+    }
+    __atomic_store_n( &ringTail, ringTail + count, __ATOMIC_RELEASE );   // copied, heater can reuse the space
+
+    block.header.magic = REC_MAGIC;
+    block.header.runStart = blockRunStart;
+    block.header.block = blockNumber++;
+    block.header.count = (uint16_t)count;
+    memcpy( block.header.name, blockRunName, sizeof( block.header.name ) );
+
+    uint32_t len = sizeof( recBlockHeader_t ) + count * sizeof( recSample_t );
+    if( len != SDCARD_writeBulk( REC_FILE_PATH, (const uint8_t *)&block, len, true ) ) {
+      retVal = false;   // samples are lost, the run goes on
+    }
+  }
+
+  __atomic_store_n( &flushQueued, false, __ATOMIC_RELEASE );
+
+  if( finish ) {
+    Serial.printf( "REC: run '%s' finished (%u blocks), %u samples dropped\n", blockRunName, blockNumber, dropped );
+  }
+  return retVal;
+}
+
+void REC_Init( void ) {
+  PERSIST_setSignalJob( PERSIST_SIGNAL_RECORDER, recFlush );
+}
+
+void REC_Start( const char * name ) {
+  strlcpy( runName, ( NULL != name ) ? name : "", sizeof( runName ) );
+  runStart = millis();
+  REC_Event( REC_EVENT_RUN_START );
+}
+
+void REC_Stop( void ) {
+  REC_Event( REC_EVENT_RUN_END );
+}
+
+void REC_Event( uint16_t events ) {
+  __atomic_fetch_or( &pendingEvents, (uint32_t)events, __ATOMIC_ACQ_REL );
+}
+
+void REC_Sample( float temp, uint16_t setpoint, uint8_t power, uint8_t state ) {
+  uint32_t now = millis();
+  uint32_t events = __atomic_exchange_n( &pendingEvents, 0, __ATOMIC_ACQ_REL );
+  uint32_t head = ringHead;
+  uint32_t tail = __atomic_load_n( &ringTail, __ATOMIC_ACQUIRE );
+
+  if( events & REC_EVENT_RUN_START ) {
+    recording = true;
+    lastSampleTime = now;
+    dropped = 0;
+  }
+
+  if( !recording ) {
+    return;
+  }
+
+  if( REC_RING_SAMPLES <= head - tail ) {
+    dropped++;
+    __atomic_fetch_or( &pendingEvents, events, __ATOMIC_ACQ_REL );   // keep events for the next sample
+    return;
+  }
+
+  recSample_t * sample = &ring[ head & ( REC_RING_SAMPLES - 1 ) ];
+  uint32_t dt = now - lastSampleTime;
+
+  sample->dt = ( UINT16_MAX < dt ) ? UINT16_MAX : (uint16_t)dt;
+  sample->temp = (int16_t)( temp * 10 );
+  sample->setpoint = setpoint;
+  sample->power = power;
+  sample->state = state;
+  sample->events = (uint16_t)events;
+  __atomic_store_n( &ringHead, head + 1, __ATOMIC_RELEASE );
+  lastSampleTime = now;
+
+  if( events & REC_EVENT_RUN_END ) {
+    recording = false;
+    __atomic_store_n( &finishRequested, true, __ATOMIC_RELEASE );
+    PERSIST_Signal( PERSIST_SIGNAL_RECORDER );    // runs again even when block flush is in progress
+  } else if( REC_BLOCK_SAMPLES <= head + 1 - tail && !__atomic_load_n( &flushQueued, __ATOMIC_ACQUIRE ) ) {
+    __atomic_store_n( &flushQueued, true, __ATOMIC_RELEASE );
+    PERSIST_Signal( PERSIST_SIGNAL_RECORDER );
+  }
+}
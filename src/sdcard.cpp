@@ -1,7 +1,24 @@
 #include "sdcard.h"
 
+#ifdef ARDUINO
+
+#include "SD.h"
+
 static bool cardAvailable = false;
 static SPIClass * sharedSPI;
+static uint32_t cardFrequency = 0;
+static uint32_t probeCountdown = 0;
+static uint8_t sectorBuffer[ 2 ][ SD_SECTOR_SIZE ];   // raw sector reads (card verification/presence), guarded by xSemaphore
+static SemaphoreHandle_t  xSemaphore = NULL;
+static StaticSemaphore_t  xMutexBuffer;
+
+static bool sdLock() {
+  return NULL != xSemaphore && pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 1000/portTICK_PERIOD_MS ) );
+}
+
+static void sdUnlock() {
+  xSemaphoreGive( xSemaphore );
+}
 
 static void writeFile( fs::FS &fs, const char * path, const char * message ) {
   if( false == cardAvailable ) {
@@ -69,21 +86,51 @@ static void printDirectory( File dir, int numTabs ) {
   }
 }
 
+/**
+ * Read sector 0 (MBR/boot sector) twice, both reads must succeed, be equal and carry boot signature
+ */
+static bool verifyCard() {
+  if( !SD.readRAW( sectorBuffer[0], 0 ) || !SD.readRAW( sectorBuffer[1], 0 ) ) {
+    return false;
+  }
+
+  return 0x55 == sectorBuffer[0][ SD_SECTOR_SIZE - 2 ]
+      && 0xAA == sectorBuffer[0][ SD_SECTOR_SIZE - 1 ]
+      && 0 == memcmp( sectorBuffer[0], sectorBuffer[1], SD_SECTOR_SIZE );
+}
+
+/**
+ * Mount card with the highest SPI clock at which raw reads are stable
+ */
 static bool initializeSdCard() {
-  if( !SD.begin( SD_CS, *sharedSPI ) ) {
-    Serial.println( "Card Mount Failed" );
-    cardAvailable = false;
+  static const uint32_t frequencies[] = SD_FREQUENCIES;
+  unsigned long start = micros();
+
+  cardAvailable = false;
+  cardFrequency = 0;
+
+  // cheap presence check at safe clock, don't negotiate when there is no card at all
+  if( !SD.begin( SD_CS, *sharedSPI, SD_PROBE_FREQUENCY ) || CARD_NONE == SD.cardType() ) {
+    SD.end();
     return false;
   }
+  SD.end();
 
-  uint8_t cardType = SD.cardType();
+  for( int x=0; x<sizeof( frequencies )/sizeof( frequencies[0] ); x++ ) {
+    if( SD.begin( SD_CS, *sharedSPI, frequencies[x] ) && CARD_NONE != SD.cardType() && verifyCard() ) {
+      cardFrequency = frequencies[x];
+      break;
+    }
+    SD.end();
+  }
 
-  if( cardType == CARD_NONE ) {
-    Serial.println( "No SD card attached" );
-    cardAvailable = false;
+  if( 0 == cardFrequency ) {
+    Serial.println( "Card Mount Failed" );
     return false;
   }
 
+  uint8_t cardType = SD.cardType();
+
   Serial.print("SD Card Type: ");
   if (cardType == CARD_MMC) {
     Serial.println("MMC");
@@ -96,54 +143,98 @@ static bool initializeSdCard() {
   }
 
   uint64_t cardSize = SD.cardSize() / (1024 * 1024);
-  Serial.printf("SD Card Size: %lluMB\n", cardSize);
+  Serial.printf("SD Card Size: %lluMB, SPI clock: %u[kHz], mounted in %lu[uS]\n", cardSize, cardFrequency / 1000, micros() - start );
 
   cardAvailable = true;
 
   return true;
 }
 
-void SDCARD_Setup( SPIClass * spi ) {
+void SDCARD_Setup( halSpi_t * spi ) {
   if( NULL == spi ) {
     return;
   }
 
   sharedSPI = spi;
+  if( NULL == xSemaphore ) {
+    xSemaphore = xSemaphoreCreateMutexStatic( &xMutexBuffer );
+  }
 
-  if( false == initializeSdCard() ) {
-    return;
+  if( sdLock() ) {
+    initializeSdCard();
+    sdUnlock();
   }
 }
 
-bool SDCARD_Reinit() {
-  SD.end();
-  SDCARD_Setup( sharedSPI );
-  return cardAvailable;
+void SDCARD_Handle( void ) {
+  if( NULL == sharedSPI || NULL == xSemaphore || pdTRUE != xSemaphoreTake( xSemaphore, 0 ) ) {
+    return;   // card is in use right now, check next time
+  }
+
+  if( cardAvailable ) {
+    if( !SD.readRAW( sectorBuffer[0], 0 ) ) {
+      Serial.println( "SD card removed" );
+      SD.end();
+      cardAvailable = false;
+      cardFrequency = 0;
+      probeCountdown = SD_ABSENT_PROBE_EVERY;
+    }
+  } else if( 0 == probeCountdown-- ) {
+    probeCountdown = SD_ABSENT_PROBE_EVERY;
+    if( initializeSdCard() ) {
+      Serial.println( "SD card inserted" );
+    }
+  }
+
+  sdUnlock();
 }
 
-void SDCARD_Eject() {
-  SD.end();
+bool SDCARD_isAvailable( void ) {
+  bool retVal = false;
+
+  if( sdLock() ) {
+    if( !cardAvailable && NULL != sharedSPI ) {
+      initializeSdCard();
+    }
+    retVal = cardAvailable;
+    sdUnlock();
+  }
+
+  return retVal;
+}
+
+uint32_t SDCARD_getFrequency( void ) {
+  return cardFrequency;
 }
 
 void SDCARD_list() {
-  if( !cardAvailable ) {
+  if( !sdLock() ) {
     return;
   }
 
-  File root = SD.open( "/" );
-  if( root ) {
-    unsigned long start = micros();
-    printDirectory( root, 0 );
-    Serial.printf( "listing time: %llu[uS]\n", micros() - start );
-    root.close();
+  if( cardAvailable ) {
+    File root = SD.open( "/" );
+    if( root ) {
+      unsigned long start = micros();
+      printDirectory( root, 0 );
+      Serial.printf( "listing time: %llu[uS]\n", micros() - start );
+      root.close();
+    }
   }
+
+  sdUnlock();
 }
 
 int SDCARD_readFile( const char * path ) {
   int retVal = 0;
 
+  if( !sdLock() ) {
+    return -1;
+  }
+
   if( false == cardAvailable ) {
     Serial.println( "SDCARD(readFile): No SDCard" );
+    sdUnlock();
     return -1;
   }
 
@@ -152,18 +243,25 @@ int SDCARD_readFile( const char * path ) {
   if( !file ) {
     Serial.println( "SDCARD(readFile): Failed to open file, creating file" );
     writeFile( SD, path, "-1" );
+    sdUnlock();
     return -1;
   }
 
   retVal = file.read();
   file.close();
+  sdUnlock();
 
   return retVal;
 }
 
 void SDCARD_writeFile( const char * path, int value ) {
+  if( !sdLock() ) {
+    return;
+  }
+
   if( false == cardAvailable ) {
     Serial.println( "SDCARD(writeFile): No SDCard" );
+    sdUnlock();
     return;
   }
 
@@ -172,6 +270,7 @@ void SDCARD_writeFile( const char * path, int value ) {
   if( !file ) {
     Serial.println( "SDCARD(writeFile): Failed to open file, creating file" );
     writeFile( SD, path, String(value).c_str() );
+    sdUnlock();
     return;
   }
 
@@ -182,50 +281,251 @@ void SDCARD_writeFile( const char * path, int value ) {
   }
 
   file.close();
+  sdUnlock();
 }
 
 void SDCARD_writeFile( const char * path, const char * msg ) {
-  writeFile( SD, path, msg );
+  if( sdLock() ) {
+    writeFile( SD, path, msg );
+    sdUnlock();
+  }
 }
 
-uint32_t SDCARD_getFileContent( const char * path, uint8_t ** buf ) {
-  uint32_t retVal = 0;
+uint32_t SDCARD_writeBulk( const char * path, const uint8_t * data, uint32_t len, bool append ) {
+  uint32_t done = 0;
+
+  if( NULL == path || NULL == data || !sdLock() ) {
+    return 0;
+  }
 
   if( false == cardAvailable ) {
-    Serial.println( "SDCARD(getFileContent): No SDCard" );
+    Serial.println( "SDCARD(writeBulk): No SDCard" );
+    sdUnlock();
     return 0;
   }
 
-  if( NULL == path ) {
+  File file = SD.open( path, append ? FILE_APPEND : FILE_WRITE );
+
+  if( file ) {
+    unsigned long start = micros();
+
+    // first chunk fills up the sector started by previous content, the rest goes in whole sectors
+    uint32_t chunk = SD_BULK_SIZE - ( append ? ( (uint32_t)file.size() % SD_BULK_SIZE ) : 0 );
+
+    while( done < len ) {
+      uint32_t part = ( len - done < chunk ) ? ( len - done ) : chunk;
+      uint32_t written = (uint32_t)file.write( data + done, part );
+
+      done += written;
+      if( written != part ) {
+        Serial.println( "SDCARD(writeBulk): Write failed" );
+        break;
+      }
+      chunk = SD_BULK_SIZE;
+    }
+    file.close();
+    Serial.printf( "SDCARD(writeBulk): %u bytes in %lu[uS]\n", done, micros() - start );
+  } else {
+    Serial.println( "SDCARD(writeBulk): Failed to open file" );
+  }
+
+  sdUnlock();
+  return done;
+}
+
+uint32_t SDCARD_getFileContent( const char * path, uint8_t ** buf ) {
+  uint32_t retVal = 0;
+
+  if( NULL == path || NULL == buf || !sdLock() ) {
     return retVal;
   }
 
+  if( false == cardAvailable ) {
+    Serial.println( "SDCARD(getFileContent): No SDCard" );
+    sdUnlock();
+    return 0;
+  }
+
+  *buf = NULL;
   File file = SD.open( path, FILE_READ );
 
   if( file ) {
-    uint32_t bufLen = (uint32_t)file.size() + 1;  // +1 for safety (we can end buffer content with NULL character)
+    uint32_t fileSize = (uint32_t)file.size();
+    unsigned long start = micros();
 
-    if( 1 < bufLen ) {
-      *buf = (uint8_t *)malloc( bufLen );
+    if( 0 < fileSize ) {
+      *buf = (uint8_t *)malloc( fileSize + 1 );  // +1 for safety (we can end buffer content with NULL character)
     }
-    // Serial.printf( "Allocated buffer size: %d\n", bufLen );
-    // Serial.printf( "file content: %s\n", *buf );
 
     if( NULL != *buf ) {
-      int rlen = file.available();
-      // Serial.printf( "file available: %d\n", rlen );
-
-      if( 0 < rlen && rlen < bufLen ) {
-        retVal = (uint32_t)( file.read( *buf, bufLen ) );
-      }
-      else {
-        Serial.println( "SDCARD(readFileContent): Buffer size to small" );
-        free( *buf );
-        *buf = NULL;
+      // whole sectors go straight into the buffer, no byte by byte copying through file cache
+      while( retVal < fileSize ) {
+        uint32_t part = ( fileSize - retVal < SD_BULK_SIZE ) ? ( fileSize - retVal ) : SD_BULK_SIZE;
+        int rlen = file.read( *buf + retVal, part );
+
+        if( 0 >= rlen ) {
+          break;
+        }
+        retVal += (uint32_t)rlen;
       }
+      (*buf)[ retVal ] = 0;
+      Serial.printf( "SDCARD(getFileContent): %u bytes in %lu[uS]\n", retVal, micros() - start );
     }
     file.close();
   }
 
+  sdUnlock();
+  return retVal;
+}
+
+#else
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define SD_HOST_PATH_LENGTH   320     // root + file name up to NAME_MAX
+
+static bool cardAvailable = false;
+
+static void hostPath( char * buf, const char * path ) {
+  snprintf( buf, SD_HOST_PATH_LENGTH, SD_HOST_ROOT "%s%s", ( '/' == path[0] ) ? "" : "/", path );
+}
+
+static bool cardPresent() {
+  struct stat st;
+
+  return 0 == stat( SD_HOST_ROOT, &st ) && S_ISDIR( st.st_mode );
+}
+
+static FILE * openFile( const char * path, const char * mode ) {
+  char buf[ SD_HOST_PATH_LENGTH ];
+
+  if( !cardPresent() ) {
+    return NULL;
+  }
+  hostPath( buf, path );
+  return fopen( buf, mode );
+}
+
+void SDCARD_Setup( halSpi_t * spi ) {
+  cardAvailable = cardPresent();
+}
+
+void SDCARD_Handle( void ) {
+  bool present = cardPresent();
+
+  if( present != cardAvailable ) {
+    HAL_printf( "SD card %s\n", present ? "inserted" : "removed" );
+    cardAvailable = present;
+  }
+}
+
+bool SDCARD_isAvailable( void ) {
+  cardAvailable = cardPresent();
+  return cardAvailable;
+}
+
+uint32_t SDCARD_getFrequency( void ) {
+  return 0;   // no SPI bus behind the directory
+}
+
+void SDCARD_list() {
+  char buf[ SD_HOST_PATH_LENGTH ];
+  struct dirent * entry;
+  struct stat st;
+
+  DIR * dir = opendir( SD_HOST_ROOT );
+  if( NULL == dir ) {
+    return;
+  }
+  while( NULL != ( entry = readdir( dir ) ) ) {
+    if( '.' == entry->d_name[0] ) {
+      continue;
+    }
+    hostPath( buf, entry->d_name );
+    if( 0 == stat( buf, &st ) ) {
+      HAL_printf( "%s\t\t%ld\n", entry->d_name, (long)st.st_size );
+    }
+  }
+  closedir( dir );
+}
+
+int SDCARD_readFile( const char * path ) {
+  FILE * f = openFile( path, "rb" );
+  int retVal;
+
+  if( NULL == f ) {
+    return -1;
+  }
+  retVal = fgetc( f );
+  fclose( f );
+
+  return ( EOF == retVal ) ? -1 : retVal;
+}
+
+void SDCARD_writeFile( const char * path, int value ) {
+  FILE * f = openFile( path, "w" );
+
+  if( NULL != f ) {
+    fprintf( f, "%d", value );
+    fclose( f );
+  }
+}
+
+void SDCARD_writeFile( const char * path, const char * msg ) {
+  FILE * f = openFile( path, "w" );
+
+  if( NULL != f ) {
+    fputs( msg, f );
+    fclose( f );
+  }
+}
+
+uint32_t SDCARD_writeBulk( const char * path, const uint8_t * data, uint32_t len, bool append ) {
+  uint32_t done = 0;
+
+  if( NULL == path || NULL == data ) {
+    return 0;
+  }
+
+  FILE * f = openFile( path, append ? "ab" : "wb" );
+  if( NULL == f ) {
+    HAL_printf( "SDCARD(writeBulk): Failed to open file\n" );
+    return 0;
+  }
+  done = (uint32_t)fwrite( data, 1, len, f );
+  fclose( f );
+
+  return done;
+}
+
+uint32_t SDCARD_getFileContent( const char * path, uint8_t ** buf ) {
+  uint32_t retVal = 0;
+  long size = 0;
+
+  if( NULL == path || NULL == buf ) {
+    return 0;
+  }
+
+  *buf = NULL;
+  FILE * f = openFile( path, "rb" );
+  if( NULL == f ) {
+    HAL_printf( "SDCARD(getFileContent): Failed to open file\n" );
+    return 0;
+  }
+
+  if( 0 == fseek( f, 0, SEEK_END ) && 0 < ( size = ftell( f ) ) && 0 == fseek( f, 0, SEEK_SET ) ) {
+    *buf = (uint8_t *)malloc( size + 1 );   // buffer is NULL terminated as on the device
+  }
+  if( NULL != *buf ) {
+    retVal = (uint32_t)fread( *buf, 1, size, f );
+    (*buf)[ retVal ] = 0;
+  }
+  fclose( f );
+
   return retVal;
-}
\ No newline at end of file
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,87 @@
+#include <Arduino.h>
+#include "shell.h"
+#include "myOTA.h"
+
+static const shellCommand_t * commandTable = NULL;
+static uint32_t           commandCount = 0;
+static char               pendingLine[ SHELL_LINE_LENGTH ];   // written by input task while lineReady is false
+static bool               lineReady = false;
+
+static void help( void ) {
+  SHELL_Printf( "help - this list\n" );
+  for( int x=0; x<commandCount; x++ ) {
+    SHELL_Printf( "%s%s%s - %s\n", commandTable[x].name, ( NULL != commandTable[x].args ) ? " " : "",
+                  ( NULL != commandTable[x].args ) ? commandTable[x].args : "", commandTable[x].help );
+  }
+}
+
+static void execute( char * line ) {
+  char * argv[ SHELL_ARGS_MAX ];
+  int argc = 0;
+  char * save;
+
+  for( char * token = strtok_r( line, " \t", &save ); NULL != token; token = strtok_r( NULL, " \t", &save ) ) {
+    if( SHELL_ARGS_MAX <= argc ) {
+      SHELL_Printf( "Too many arguments\n" );
+      return;
+    }
+    argv[ argc++ ] = token;
+  }
+
+  if( 0 == argc ) {
+    return;
+  }
+
+  if( 0 == strcmp( argv[0], "help" ) ) {
+    help();
+    return;
+  }
+
+  for( int x=0; x<commandCount; x++ ) {
+    if( 0 == strcmp( argv[0], commandTable[x].name ) ) {
+      commandTable[x].handler( argc, argv );
+      return;
+    }
+  }
+  SHELL_Printf( "Unknown command '%s', try 'help'\n", argv[0] );
+}
+
+void SHELL_Init( const shellCommand_t commands[], uint32_t count ) {
+  commandTable = commands;
+  commandCount = ( NULL != commands ) ? count : 0;
+}
+
+bool SHELL_Input( const char * line ) {
+  if( __atomic_load_n( &lineReady, __ATOMIC_ACQUIRE ) ) {
+    return false;
+  }
+
+  strlcpy( pendingLine, line, sizeof( pendingLine ) );
+  __atomic_store_n( &lineReady, true, __ATOMIC_RELEASE );
+  return true;
+}
+
+void SHELL_Handle( void ) {
+  char line[ SHELL_LINE_LENGTH ];
+
+  if( !__atomic_load_n( &lineReady, __ATOMIC_ACQUIRE ) ) {
+    return;
+  }
+
+  memcpy( line, pendingLine, sizeof( line ) );
+  __atomic_store_n( &lineReady, false, __ATOMIC_RELEASE );
+
+  execute( line );
+  SHELL_Printf( "> " );
+}
+
+void SHELL_Printf( const char * format, ... ) {
+  char buf[ SHELL_REPLY_LENGTH ];
+  va_list args;
+
+  va_start( args, format );
+  vsnprintf( buf, sizeof( buf ), format, args );
+  va_end( args );
+
+  OTA_LogWrite( buf );
+}
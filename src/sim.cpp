@@ -0,0 +1,237 @@
+#ifndef ARDUINO
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "hal.h"
+#include "heater.h"
+#include "controller.h"
+#include "max6675.h"
+#include "PID.h"
+
+#define STEADY_SAMPLES    ( SIM_STEADY_WINDOW * 1000 / SIM_STEP )
+
+// metrics of the running segment
+typedef struct {
+  simSegment_t  * out;
+  uint64_t        start;        // simulated time [us]
+  bool            relay;
+  uint32_t        count;        // samples in steady[]
+  uint32_t        pos;
+  double          sum;          // of steady[]
+  float           steady[ STEADY_SAMPLES ];   // last errors
+} segmentStats_t;
+
+static simConfig_t        config;
+static halSpi_t           spi;
+static segmentStats_t     stats;        // too big for the stack
+static float              lastSetpoint; // of the previous segment run with heater, ambient when it was off
+
+static uint16_t spiTransfer( uint8_t cs ) {
+  return PLANT_readMax6675();
+}
+
+static uint32_t elapsed( uint64_t since ) {
+  return (uint32_t)( ( HAL_simTime() - since ) / 1000 );
+}
+
+static void statsBegin( simSegment_t * out, const recipeSegment_t * segment, uint16_t temp ) {
+  memset( out, 0, sizeof( simSegment_t ) );
+  out->event = segment->event;
+  out->temp = temp;
+  out->settling = 0;
+  out->rising = ( temp >= lastSetpoint );   // holding the same setpoint overshoots above it too
+  if( EVENT_SOUND != segment->event ) {     // sound does not change the heater
+    lastSetpoint = ( 0 < temp ) ? temp : config.plant.ambient;
+  }
+
+  stats.out = out;
+  stats.start = HAL_simTime();
+  stats.count = 0;
+  stats.pos = 0;
+  stats.sum = 0.0;
+}
+
+static void statsSample( simResult_t * result ) {
+  simSegment_t * out = stats.out;
+  float temp = PLANT_getTemperature();
+  bool relay = HAL_pinRead( PID_PIN_RELAY );
+
+  if( relay && !stats.relay ) {
+    out->relayCycles++;
+    result->relayCycles++;
+  }
+  stats.relay = relay;
+  if( temp > result->maxTemp ) {
+    result->maxTemp = temp;
+  }
+
+  if( 0 == out->temp ) {
+    return;
+  }
+
+  float error = temp - out->temp;
+
+  if( fabsf( error ) > config.band ) {
+    out->settling = elapsed( stats.start ) + SIM_STEP;    // still outside, can't be settled before next sample
+  }
+  if( ( out->rising ? error : -error ) > out->overshoot ) {
+    out->overshoot = out->rising ? error : -error;
+  }
+
+  if( STEADY_SAMPLES == stats.count ) {
+    stats.sum -= stats.steady[ stats.pos ];
+  } else {
+    stats.count++;
+  }
+  stats.steady[ stats.pos ] = error;
+  stats.sum += error;
+  stats.pos = ( stats.pos + 1 ) % STEADY_SAMPLES;
+}
+
+static void statsEnd( void ) {
+  simSegment_t * out = stats.out;
+
+  out->duration = elapsed( stats.start );
+  if( 0 < out->temp ) {
+    if( out->settling >= out->duration ) {
+      out->settling = SIM_NEVER;
+    }
+    out->steadyError = ( 0 < stats.count ) ? (float)( stats.sum / stats.count ) : 0.0f;
+  }
+}
+
+// one controller cycle: plant follows the relay, tasks (heater, controller) run up to the next cycle
+static void step( ctrlStatus_t * ctrl ) {
+  PLANT_Step( HAL_pinRead( PID_PIN_RELAY ) );
+  HAL_delay( SIM_STEP );
+  CTRL_getStatus( ctrl );
+}
+
+// setpoint the controller runs the segment with, sound and end don't change the heater (0 - no temperature metrics)
+static uint16_t segmentTemp( const recipeSegment_t * segment ) {
+  return ( EVENT_SOUND == segment->event || EVENT_END == segment->event ) ? 0 : segment->temp;
+}
+
+void SIM_Init( const simConfig_t * simConfig ) {
+  config = *simConfig;
+  spi.transfer16 = spiTransfer;
+
+  HAL_simEnable();
+  HEATER_Init( &spi );
+}
+
+void SIM_Run( uint32_t idx, const recipe_t * recipe, simResult_t * result ) {
+  clock_t cpuStart = clock();
+  uint64_t runStart;
+  uint64_t continueAt = UINT64_MAX;
+  bool userCalled = false;      // user was already called in the running segment
+  ctrlStatus_t ctrl;
+
+  memset( result, 0, sizeof( simResult_t ) );
+  result->completed = true;
+
+  PLANT_Init( &config.plant, SIM_STEP / 1000.0f );
+  HAL_delay( TEMP_READ_INTERVAL );    // thermocouple reads ambient before the start
+  runStart = HAL_simTime();
+  lastSetpoint = config.plant.ambient;
+
+  CTRL_Post( CTRL_EVT_BAKE_PICKUP, (int32_t)idx, 0 );
+  CTRL_Post( CTRL_EVT_START, 0, 0 );
+  do {
+    step( &ctrl );
+  } while( STATE_IDLE == ctrl.state );    // commands are taken by the controller task during the delay
+
+  while( STATE_IDLE != ctrl.state ) {
+    // segments the controller went through since the last sample (sound takes no time)
+    while( result->count <= ctrl.step && result->count < recipe->count ) {
+      const recipeSegment_t * segment = &recipe->segment[ result->count ];
+
+      if( 0 < result->count ) {
+        statsEnd();
+      }
+      statsBegin( &result->segment[ result->count++ ], segment, segmentTemp( segment ) );
+      continueAt = UINT64_MAX;
+      userCalled = false;
+    }
+    statsSample( result );
+
+    // user presses CONTINUE when called (pause, preheating temperature reached) and STOP at the end
+    if( !userCalled && BUTTONS_CONTINUE_STOP == ctrl.buttons ) {
+      continueAt = HAL_simTime() + config.userDelay * 1000ULL;
+      userCalled = true;
+    }
+    if( HAL_simTime() >= continueAt ) {
+      CTRL_Post( CTRL_EVT_PAUSE, 0, 0 );
+      continueAt = UINT64_MAX;
+    }
+    if( STATE_SPECIAL_EVENT == ctrl.state && EVENT_END == ctrl.event ) {
+      CTRL_Post( CTRL_EVT_STOP, 0, 0 );
+    }
+
+    step( &ctrl );
+  }
+
+  if( 0 < result->count ) {
+    int32_t event = result->segment[ result->count - 1 ].event;
+
+    statsEnd();
+    if( EVENT_PREHEATING == event || EVENT_PAUSE == event ) {
+      result->completed = false;    // deadline, controller stopped the bake
+    }
+  }
+  result->duration = elapsed( runStart );
+  result->cpuTime = (uint32_t)( ( clock() - cpuStart ) * 1000 / CLOCKS_PER_SEC );
+}
+
+bool SIM_Check( const simResult_t * result ) {
+  bool valid = true;
+
+  for( uint32_t x=0; x<result->count; x++ ) {
+    const simSegment_t * segment = &result->segment[x];
+    float steady = segment->rising ? segment->steadyError : -segment->steadyError;
+
+    // mean of the errors can't be further beyond setpoint than the largest one
+    if( 0 < segment->temp && steady > segment->overshoot + SIM_CHECK_TOLERANCE ) {
+      HAL_printf( "  segment %u: overshoot %.2f[C] is below steady state error %.2f[C]\n", x + 1, segment->overshoot, steady );
+      valid = false;
+    }
+  }
+  return valid;
+}
+
+static const char * eventName( int32_t event ) {
+  switch( event ) {
+    case 0:                 return "heat";
+    case EVENT_PREHEATING:  return "preheat";
+    case EVENT_PAUSE:       return "pause";
+    case EVENT_SOUND:       return "sound";
+    case EVENT_END:         return "end";
+    case EVENT_TIMER:       return "timer";
+    default:                return "?";
+  }
+}
+
+void SIM_Print( const recipe_t * recipe, const simResult_t * result ) {
+  HAL_printf( "'%s': %s, %u:%02u:%02u simulated in %u[ms], max %.1f[C], %u relay cycles\n", recipe->name,
+              result->completed ? "completed" : "stopped at deadline", result->duration / 3600000, result->duration / 60000 % 60,
+              result->duration / 1000 % 60, result->cpuTime, result->maxTemp, result->relayCycles );
+  HAL_printf( "  %3s %-8s %6s %9s %10s %10s %10s %7s\n", "#", "event", "sp[C]", "time[s]", "overs.[C]", "settle[s]", "sserr[C]", "cycles" );
+
+  for( uint32_t x=0; x<result->count; x++ ) {
+    const simSegment_t * segment = &result->segment[x];
+
+    HAL_printf( "  %3u %-8s %6u %9u", x + 1, eventName( segment->event ), segment->temp, segment->duration / 1000 );
+    if( 0 == segment->temp ) {
+      HAL_printf( " %10s %10s %10s", "-", "-", "-" );
+    } else if( SIM_NEVER == segment->settling ) {
+      HAL_printf( " %10.2f %10s %10.2f", segment->overshoot, "never", segment->steadyError );
+    } else {
+      HAL_printf( " %10.2f %10u %10.2f", segment->overshoot, segment->settling / 1000, segment->steadyError );
+    }
+    HAL_printf( " %7u\n", segment->relayCycles );
+  }
+}
+
+#endif  // ARDUINO
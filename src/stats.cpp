@@ -0,0 +1,301 @@
+#include <Arduino.h>
+#include "stats.h"
+#include "logger.h"
+#include "esp_freertos_hooks.h"
+
+#if ( 1 == configUSE_TRACE_FACILITY )
+  #define STATS_SYSTEM_STATE    1     // all tasks are listed by the kernel
+#else
+  #define STATS_SYSTEM_STATE    0     // only tasks known by name
+#endif
+#if ( 1 == configUSE_TRACE_FACILITY ) && ( 1 == configGENERATE_RUN_TIME_STATS )
+  #define STATS_CPU             1     // per task run time counters available
+#else
+  #define STATS_CPU             0     // sampled from tick hooks (stock arduino-esp32 has no run time counters)
+#endif
+
+typedef struct {
+  TaskHandle_t  handle;
+  uint32_t      runTime;            // run time counter at previous collection
+  uint32_t      warnedStack;        // stack free when warning was logged last time (0 - never)
+} statsHistory_t;
+
+static stats_t            current;                          // guarded by mutex
+static statsHistory_t     history[ STATS_TASKS_MAX ];       // stats task only
+#if !STATS_CPU
+typedef struct {
+  TaskHandle_t  handle;
+  uint32_t      ticks;              // ticks the task was running when the tick interrupt came
+} statsSample_t;
+
+static statsSample_t      samples[ portNUM_PROCESSORS ][ STATS_TASKS_MAX ];   // each row written by tick hook of its core only
+static uint32_t           sampleTicks[ portNUM_PROCESSORS ];
+#endif
+static uint32_t           lastTotalRunTime = 0;
+static uint32_t           lvglUsed = 0;
+static uint32_t           lvglTotal = 0;
+static bool               initialized = false;
+static SemaphoreHandle_t  xSemaphore = NULL;
+static StaticSemaphore_t  xMutexBuffer;
+static TaskHandle_t       taskHandle = NULL;
+static StaticTask_t       taskTCB;
+static StackType_t        taskStack[ STATS_STACK_SIZE ];
+
+#if !STATS_SYSTEM_STATE
+static const char * knownTasks[] = { "loopTask", "Heater", "Buzzer", "OTA", "Controller", "Persist", "Log", "Telemetry", "MQTT", "Stats", "IDLE0", "IDLE1" };
+#endif
+
+static statsHistory_t * historyFind( TaskHandle_t handle ) {
+  statsHistory_t * freeSlot = NULL;
+
+  for( int x=0; x<STATS_TASKS_MAX; x++ ) {
+    if( handle == history[x].handle ) {
+      return &history[x];
+    }
+    if( NULL == history[x].handle && NULL == freeSlot ) {
+      freeSlot = &history[x];
+    }
+  }
+
+  if( NULL != freeSlot ) {
+    freeSlot->handle = handle;
+    freeSlot->runTime = 0;
+    freeSlot->warnedStack = 0;
+  }
+  return freeSlot;
+}
+
+#if !STATS_CPU
+static inline void IRAM_ATTR sampleTick( BaseType_t core ) {
+  TaskHandle_t running = xTaskGetCurrentTaskHandleForCPU( core );
+  statsSample_t * sample = samples[ core ];
+
+  for( int x=0; x<STATS_TASKS_MAX; x++ ) {
+    if( running == sample[x].handle ) {
+      sample[x].ticks++;
+      break;
+    }
+    if( NULL == sample[x].handle ) {
+      sample[x].ticks = 1;
+      __atomic_store_n( &sample[x].handle, running, __ATOMIC_RELEASE );   // ticks are valid before the slot is visible
+      break;
+    }
+  }
+  sampleTicks[ core ]++;
+}
+
+static void IRAM_ATTR sampleTickCore0( void ) {
+  sampleTick( 0 );
+}
+
+#if ( 1 < portNUM_PROCESSORS )
+static void IRAM_ATTR sampleTickCore1( void ) {
+  sampleTick( 1 );
+}
+#endif
+
+// ticks of the task summed over both cores (task may not be pinned)
+static uint32_t sampleGet( TaskHandle_t handle ) {
+  uint32_t ticks = 0;
+
+  for( int core=0; core<portNUM_PROCESSORS; core++ ) {
+    for( int x=0; x<STATS_TASKS_MAX; x++ ) {
+      if( handle == __atomic_load_n( &samples[ core ][x].handle, __ATOMIC_ACQUIRE ) ) {
+        ticks += __atomic_load_n( &samples[ core ][x].ticks, __ATOMIC_RELAXED );
+        break;
+      }
+    }
+  }
+  return ticks;
+}
+
+// share of one core [0.1 %] since previous call, -1 at first collection
+static int32_t sampleCpu( statsHistory_t * hist, uint32_t period ) {
+  int32_t cpu = -1;
+
+  if( NULL == hist ) {
+    return cpu;
+  }
+
+  uint32_t ticks = sampleGet( hist->handle );
+  if( 0 < lastTotalRunTime && 0 < period ) {
+    cpu = (int32_t)( (uint64_t)( ticks - hist->runTime ) * 1000 / period );
+  }
+  hist->runTime = ticks;
+  return cpu;
+}
+#endif
+
+static void stackCheck( statsHistory_t * hist, const statsTask_t * task ) {
+  if( NULL == hist || STATS_STACK_WARNING <= task->stackFree ) {
+    return;
+  }
+
+  if( 0 == hist->warnedStack || task->stackFree < hist->warnedStack ) {
+    LOG_Printf( LOG_WARNING, "STATS: task '%s' close to stack overflow, %u bytes left", task->name, task->stackFree );
+    hist->warnedStack = task->stackFree;
+  }
+}
+
+static void collect( stats_t * stats ) {
+  stats->time = millis();
+  stats->taskTotal = uxTaskGetNumberOfTasks();
+  stats->taskCount = 0;
+
+#if STATS_SYSTEM_STATE
+  static TaskStatus_t taskStatus[ STATS_TASKS_MAX ];
+  uint32_t totalRunTime = 0;
+  uint32_t count = uxTaskGetSystemState( taskStatus, STATS_TASKS_MAX, &totalRunTime );
+#if !STATS_CPU
+  totalRunTime = __atomic_load_n( &sampleTicks[0], __ATOMIC_RELAXED );   // one core time in ticks
+#endif
+  uint32_t period = totalRunTime - lastTotalRunTime;
+
+  for( int x=0; x<count; x++ ) {
+    statsTask_t * task = &stats->task[ stats->taskCount++ ];
+    statsHistory_t * hist = historyFind( taskStatus[x].xHandle );
+
+    strlcpy( task->name, taskStatus[x].pcTaskName, sizeof( task->name ) );
+    task->priority = taskStatus[x].uxCurrentPriority;
+    task->stackFree = taskStatus[x].usStackHighWaterMark;
+    task->cpu = -1;
+  #if STATS_CPU
+    if( NULL != hist && 0 < lastTotalRunTime && 0 < period ) {
+      task->cpu = (int32_t)( (uint64_t)( taskStatus[x].ulRunTimeCounter - hist->runTime ) * 1000 / period );
+    }
+    if( NULL != hist ) {
+      hist->runTime = taskStatus[x].ulRunTimeCounter;
+    }
+  #else
+    task->cpu = sampleCpu( hist, period );
+  #endif
+    stackCheck( hist, task );
+  }
+  lastTotalRunTime = totalRunTime;
+  (void)period;
+#else
+  uint32_t totalRunTime = __atomic_load_n( &sampleTicks[0], __ATOMIC_RELAXED );
+  uint32_t period = totalRunTime - lastTotalRunTime;
+
+  for( int x=0; x<sizeof( knownTasks ) / sizeof( knownTasks[0] ) && STATS_TASKS_MAX > stats->taskCount; x++ ) {
+    TaskHandle_t handle = xTaskGetHandle( knownTasks[x] );
+
+    if( NULL != handle ) {
+      statsTask_t * task = &stats->task[ stats->taskCount++ ];
+      statsHistory_t * hist = historyFind( handle );
+
+      strlcpy( task->name, knownTasks[x], sizeof( task->name ) );
+      task->priority = uxTaskPriorityGet( handle );
+      task->stackFree = uxTaskGetStackHighWaterMark( handle );
+      task->cpu = sampleCpu( hist, period );
+      stackCheck( hist, task );
+    }
+  }
+  lastTotalRunTime = totalRunTime;
+#endif
+
+  stats->heapFree = ESP.getFreeHeap();
+  stats->heapMinFree = ESP.getMinFreeHeap();
+  stats->heapMaxBlock = ESP.getMaxAllocHeap();
+  stats->lvglUsed = __atomic_load_n( &lvglUsed, __ATOMIC_RELAXED );
+  stats->lvglTotal = __atomic_load_n( &lvglTotal, __ATOMIC_RELAXED );
+}
+
+static void vTaskStats( void * pvParameters ) {
+  static stats_t collected;     // too big for the stack
+  static char report[ STATS_REPORT_LENGTH ];
+  uint32_t lastPrint = millis();
+
+  while( 1 ) {
+    collect( &collected );
+
+    if( pdTRUE == xSemaphoreTake( xSemaphore, portMAX_DELAY ) ) {
+      current = collected;
+      xSemaphoreGive( xSemaphore );
+    }
+
+    if( 0 < STATS_SERIAL_PERIOD && STATS_SERIAL_PERIOD <= millis() - lastPrint ) {
+      STATS_format( report, sizeof( report ) );
+      Serial.print( report );
+      lastPrint = millis();
+    }
+
+    vTaskDelay( STATS_PERIOD / portTICK_PERIOD_MS );
+  }
+}
+
+void STATS_Init( void ) {
+  if( initialized ) {
+    return;
+  }
+
+  xSemaphore = xSemaphoreCreateMutexStatic( &xMutexBuffer );
+  assert( xSemaphore );
+
+#if !STATS_CPU
+  // without hooks cpu stays n/a
+  if( ESP_OK != esp_register_freertos_tick_hook_for_cpu( sampleTickCore0, 0 ) ) {
+    LOG_Printf( LOG_WARNING, "STATS: tick hook not registered, cpu share not available" );
+  }
+  #if ( 1 < portNUM_PROCESSORS )
+  if( ESP_OK != esp_register_freertos_tick_hook_for_cpu( sampleTickCore1, 1 ) ) {
+    LOG_Printf( LOG_WARNING, "STATS: tick hook of core 1 not registered, cpu share only from core 0" );
+  }
+  #endif
+#endif
+
+  taskHandle = xTaskCreateStaticPinnedToCore( vTaskStats, "Stats", STATS_STACK_SIZE, NULL, STATS_TASK_PRIORITY, taskStack, &taskTCB, 0 );
+  assert( taskHandle );
+
+  initialized = true;
+}
+
+void STATS_setLvglMemory( uint32_t used, uint32_t total ) {
+  __atomic_store_n( &lvglUsed, used, __ATOMIC_RELAXED );
+  __atomic_store_n( &lvglTotal, total, __ATOMIC_RELAXED );
+}
+
+void STATS_get( stats_t * stats ) {
+  if( false == initialized ) {
+    memset( stats, 0, sizeof( stats_t ) );
+    return;
+  }
+
+  if( pdTRUE == xSemaphoreTake( xSemaphore, (TickType_t)( 100/portTICK_PERIOD_MS ) ) ) {
+    *stats = current;
+    xSemaphoreGive( xSemaphore );
+  } else {
+    memset( stats, 0, sizeof( stats_t ) );
+  }
+}
+
+uint32_t STATS_format( char * buf, uint32_t size ) {
+  stats_t stats;
+  uint32_t len = 0;
+
+  STATS_get( &stats );
+
+#define STATS_APPEND( ... ) do { if( len < size ) { len += snprintf( buf + len, size - len, __VA_ARGS__ ); } } while( 0 )
+  STATS_APPEND( "Uptime %u[s], %u tasks\n", stats.time / 1000, stats.taskTotal );
+  STATS_APPEND( "%-12s %4s %6s %6s\n", "task", "prio", "stack", "cpu%" );
+  for( int x=0; x<stats.taskCount; x++ ) {
+    const statsTask_t * task = &stats.task[x];
+
+    if( 0 <= task->cpu ) {
+      STATS_APPEND( "%-12s %4u %6u %4d.%d%s\n", task->name, task->priority, task->stackFree, task->cpu / 10, task->cpu % 10,
+                    ( STATS_STACK_WARNING > task->stackFree ) ? " LOW STACK" : "" );
+    } else {
+      STATS_APPEND( "%-12s %4u %6u %6s%s\n", task->name, task->priority, task->stackFree, "n/a",
+                    ( STATS_STACK_WARNING > task->stackFree ) ? " LOW STACK" : "" );
+    }
+  }
+  STATS_APPEND( "Heap free: %u, min free: %u, max block: %u\n", stats.heapFree, stats.heapMinFree, stats.heapMaxBlock );
+  if( 0 < stats.lvglTotal ) {
+    STATS_APPEND( "LVGL heap: %u of %u used\n", stats.lvglUsed, stats.lvglTotal );
+  } else {
+    STATS_APPEND( "LVGL heap: system heap\n" );
+  }
+#undef STATS_APPEND
+
+  return ( len < size ) ? len : size - 1;
+}
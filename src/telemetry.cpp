@@ -0,0 +1,321 @@
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+#include "telemetry.h"
+#include "logger.h"
+
+#define WS_GUID                 "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_OPCODE_TEXT          0x1
+#define WS_OPCODE_CLOSE         0x8
+#define WS_FIN                  0x80
+
+typedef struct {
+  WiFiClient    conn;
+  bool          used;
+  bool          websocket;                          // handshake done, telemetry is pushed
+  char          request[ TELEM_REQUEST_LENGTH ];    // HTTP request collected until empty line
+  uint32_t      requestLength;
+  telemStatus_t sent;                               // last status queued to the client
+  bool          sentValid;                          // false: next update carries all fields
+  uint32_t      nextSend;
+  uint8_t       frame[ TELEM_FRAME_LENGTH ];        // frame being sent (slow client gets it in parts)
+  uint32_t      frameLength;
+  uint32_t      framePos;
+  uint32_t      skipped;                            // updates merged into later ones because client was slow
+} telemClient_t;
+
+static const char statusPage[] =
+  "<!DOCTYPE html><html><head><meta name=viewport content=\"width=device-width\"><title>ElectricStove</title></head>"
+  "<body style=\"font-family:sans-serif\"><h2>ElectricStove</h2><table>"
+  "<tr><td>State</td><td id=st>-</td></tr>"
+  "<tr><td>Temperature</td><td><span id=t>-</span> / <span id=s>-</span> &deg;C</td></tr>"
+  "<tr><td>Power</td><td><span id=p>-</span> %</td></tr>"
+  "<tr><td>Remaining</td><td id=r>-</td></tr></table><p id=c>connecting...</p><script>"
+  "var n=['idle','start requested','heating','next step requested','pause requested','paused','stop requested','special event'];"
+  "function go(){var w=new WebSocket('ws://'+location.host+'/ws');"
+  "w.onopen=function(){c.textContent='live'};"
+  "w.onclose=function(){c.textContent='disconnected';setTimeout(go,2000)};"
+  "w.onmessage=function(e){var d=JSON.parse(e.data);"
+  "if('t'in d)t.textContent=(d.t/10).toFixed(1);"
+  "if('s'in d)s.textContent=d.s;"
+  "if('p'in d)p.textContent=d.p;"
+  "if('r'in d)r.textContent=Math.floor(d.r/60)+':'+('0'+d.r%60).slice(-2);"
+  "if('st'in d)st.textContent=n[d.st]||d.st}}"
+  "go();</script></body></html>";
+
+static WiFiServer         server( TELEM_PORT );
+static telemClient_t      clients[ TELEM_CLIENTS_MAX ];
+static telemStatus_t      snapshot;                   // written by controller only
+static uint32_t           snapshotSequence = 0;       // odd while snapshot is being written
+static uint32_t           pushPeriod = TELEM_PERIOD_DEFAULT;
+static bool               activeRequested = false;
+static bool               serverRunning = false;      // telemetry task only
+static bool               initialized = false;
+static TaskHandle_t       taskHandle = NULL;
+static StaticTask_t       taskTCB;
+static StackType_t        taskStack[ TELEM_STACK_SIZE ];
+
+static void readSnapshot( telemStatus_t * status ) {
+  uint32_t sequence;
+
+  do {
+    sequence = __atomic_load_n( &snapshotSequence, __ATOMIC_ACQUIRE );
+    memcpy( status, &snapshot, sizeof( telemStatus_t ) );
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+  } while( ( sequence & 1 ) || sequence != __atomic_load_n( &snapshotSequence, __ATOMIC_RELAXED ) );
+}
+
+static void clientClose( telemClient_t * client ) {
+  if( client->websocket ) {
+    LOG_Printf( LOG_INFO, "TELEM: WebSocket client left, %u updates merged", client->skipped );
+  }
+  client->conn.stop();
+  client->used = false;
+}
+
+/**
+ * Continue sending current frame without blocking
+ * return   - false when connection failed
+ */
+static bool frameFlush( telemClient_t * client ) {
+  while( client->framePos < client->frameLength ) {
+    int sent = send( client->conn.fd(), client->frame + client->framePos, client->frameLength - client->framePos, MSG_DONTWAIT );
+
+    if( 0 < sent ) {
+      client->framePos += sent;
+    } else if( 0 > sent && ( EAGAIN == errno || EWOULDBLOCK == errno ) ) {
+      return true;    // socket buffer full, rest goes next time
+    } else {
+      return false;
+    }
+  }
+  client->frameLength = 0;
+  client->framePos = 0;
+  return true;
+}
+
+/**
+ * Build text frame with fields changed since the last update
+ * return   - false when nothing changed
+ */
+static bool frameBuild( telemClient_t * client, const telemStatus_t * status ) {
+  char * text = (char *)&client->frame[2];
+  uint32_t size = TELEM_FRAME_LENGTH - 2;
+  uint32_t len = 0;
+  bool all = !client->sentValid;
+
+  len += snprintf( text + len, size - len, "{" );
+  if( all || status->temp != client->sent.temp ) {
+    len += snprintf( text + len, size - len, "\"t\":%d,", status->temp );
+  }
+  if( all || status->setpoint != client->sent.setpoint ) {
+    len += snprintf( text + len, size - len, "\"s\":%u,", status->setpoint );
+  }
+  if( all || status->power != client->sent.power ) {
+    len += snprintf( text + len, size - len, "\"p\":%u,", status->power );
+  }
+  if( all || status->remaining != client->sent.remaining ) {
+    len += snprintf( text + len, size - len, "\"r\":%u,", status->remaining );
+  }
+  if( all || status->state != client->sent.state ) {
+    len += snprintf( text + len, size - len, "\"st\":%u,", status->state );
+  }
+  if( 1 == len ) {
+    return false;
+  }
+  text[ len - 1 ] = '}';    // replace last comma
+
+  client->frame[0] = WS_FIN | WS_OPCODE_TEXT;
+  client->frame[1] = (uint8_t)len;    // always < 126, unmasked
+  client->frameLength = len + 2;
+  client->framePos = 0;
+  client->sent = *status;
+  client->sentValid = true;
+  return true;
+}
+
+static void requestHandle( telemClient_t * client ) {
+  const char * key = strcasestr( client->request, "Sec-WebSocket-Key:" );
+
+  if( NULL != key && NULL != strcasestr( client->request, "Upgrade: websocket" ) ) {
+    char acceptKey[ 64 ];
+    uint8_t hash[ 20 ];
+    uint8_t accept[ 32 ];
+    size_t acceptLen = 0;
+    uint32_t len = 0;
+
+    key += strlen( "Sec-WebSocket-Key:" );
+    while( ' ' == *key ) {
+      key++;
+    }
+    while( len < 24 && '\r' != key[ len ] && '\0' != key[ len ] ) {
+      len++;
+    }
+    snprintf( acceptKey, sizeof( acceptKey ), "%.*s" WS_GUID, (int)len, key );
+    mbedtls_sha1( (const uint8_t *)acceptKey, strlen( acceptKey ), hash );
+    mbedtls_base64_encode( accept, sizeof( accept ) - 1, &acceptLen, hash, sizeof( hash ) );
+    accept[ acceptLen ] = '\0';
+
+    client->conn.printf( "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                         "Sec-WebSocket-Accept: %s\r\n\r\n", (const char *)accept );
+    client->websocket = true;
+    client->sentValid = false;
+    client->frameLength = 0;
+    client->framePos = 0;
+    client->skipped = 0;
+    client->nextSend = millis();
+    LOG_Printf( LOG_INFO, "TELEM: WebSocket client %s", client->conn.remoteIP().toString().c_str() );
+  } else if( 0 == strncmp( client->request, "GET / ", 6 ) ) {
+    client->conn.printf( "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: %u\r\nConnection: close\r\n\r\n", sizeof( statusPage ) - 1 );
+    client->conn.write( (const uint8_t *)statusPage, sizeof( statusPage ) - 1 );
+    clientClose( client );
+  } else {
+    client->conn.print( "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n" );
+    clientClose( client );
+  }
+}
+
+static void clientHandle( telemClient_t * client ) {
+  if( !client->conn.connected() ) {
+    clientClose( client );
+    return;
+  }
+
+  if( !client->websocket ) {
+    while( client->conn.available() && TELEM_REQUEST_LENGTH - 1 > client->requestLength ) {
+      client->request[ client->requestLength++ ] = client->conn.read();
+    }
+    client->request[ client->requestLength ] = '\0';
+
+    if( NULL != strstr( client->request, "\r\n\r\n" ) ) {
+      requestHandle( client );
+    } else if( TELEM_REQUEST_LENGTH - 1 <= client->requestLength ) {
+      clientClose( client );    // request too long
+    }
+    return;
+  }
+
+  // browser sends nothing but close (client frames are not interpreted any further)
+  if( client->conn.available() ) {
+    uint8_t buf[ 32 ];
+    int len = client->conn.read( buf, sizeof( buf ) );
+
+    if( 0 < len && WS_OPCODE_CLOSE == ( buf[0] & 0x0F ) ) {
+      uint8_t closeFrame[2] = { WS_FIN | WS_OPCODE_CLOSE, 0 };
+      send( client->conn.fd(), closeFrame, sizeof( closeFrame ), MSG_DONTWAIT );
+      clientClose( client );
+      return;
+    }
+  }
+
+  if( !frameFlush( client ) ) {
+    clientClose( client );
+    return;
+  }
+
+  if( (int32_t)( millis() - client->nextSend ) >= 0 ) {
+    telemStatus_t status;
+
+    client->nextSend += pushPeriod;
+    if( (int32_t)( millis() - client->nextSend ) >= 0 ) {
+      client->nextSend = millis() + pushPeriod;   // don't try to catch up
+    }
+
+    if( 0 < client->frameLength ) {
+      client->skipped++;    // previous frame still pending, changes go with the next update
+      return;
+    }
+
+    readSnapshot( &status );
+    if( frameBuild( client, &status ) && !frameFlush( client ) ) {
+      clientClose( client );
+    }
+  }
+}
+
+static void serverStart( void ) {
+  server.begin();
+  serverRunning = true;
+  LOG_Printf( LOG_INFO, "TELEM: server started, http://%s/", WiFi.localIP().toString().c_str() );
+}
+
+static void serverStop( void ) {
+  for( int x=0; x<TELEM_CLIENTS_MAX; x++ ) {
+    if( clients[x].used ) {
+      clientClose( &clients[x] );
+    }
+  }
+  server.end();
+  serverRunning = false;
+  LOG_Printf( LOG_INFO, "TELEM: server stopped" );
+}
+
+static void vTaskTelemetry( void * pvParameters ) {
+  while( 1 ) {
+    bool active = __atomic_load_n( &activeRequested, __ATOMIC_ACQUIRE );
+
+    if( active && !serverRunning ) {
+      serverStart();
+    } else if( !active && serverRunning ) {
+      serverStop();
+    }
+
+    if( serverRunning ) {
+      if( server.hasClient() ) {
+        WiFiClient conn = server.accept();
+
+        for( int x=0; x<TELEM_CLIENTS_MAX; x++ ) {
+          if( !clients[x].used ) {
+            clients[x].conn = conn;
+            clients[x].used = true;
+            clients[x].websocket = false;
+            clients[x].requestLength = 0;
+            break;
+          }
+        }
+        // no free slot: 'conn' is closed when it goes out of scope
+      }
+
+      for( int x=0; x<TELEM_CLIENTS_MAX; x++ ) {
+        if( clients[x].used ) {
+          clientHandle( &clients[x] );
+        }
+      }
+    }
+
+    vTaskDelay( TELEM_POLL_PERIOD / portTICK_PERIOD_MS );
+  }
+}
+
+void TELEM_Init( void ) {
+  if( initialized ) {
+    return;
+  }
+
+  taskHandle = xTaskCreateStaticPinnedToCore( vTaskTelemetry, "Telemetry", TELEM_STACK_SIZE, NULL, TELEM_TASK_PRIORITY, taskStack, &taskTCB, 0 );
+  assert( taskHandle );
+
+  initialized = true;
+}
+
+void TELEM_Activate( bool active ) {
+  __atomic_store_n( &activeRequested, active, __ATOMIC_RELEASE );
+}
+
+void TELEM_Update( const telemStatus_t * status ) {
+  uint32_t sequence = snapshotSequence;
+
+  __atomic_store_n( &snapshotSequence, sequence + 1, __ATOMIC_RELAXED );
+  __atomic_thread_fence( __ATOMIC_RELEASE );
+  memcpy( &snapshot, status, sizeof( telemStatus_t ) );
+  __atomic_store_n( &snapshotSequence, sequence + 2, __ATOMIC_RELEASE );
+}
+
+void TELEM_setPeriod( uint32_t period ) {
+  pushPeriod = ( TELEM_PERIOD_MIN > period ) ? TELEM_PERIOD_MIN : period;
+}
+
+uint32_t TELEM_getPeriod( void ) {
+  return pushPeriod;
+}
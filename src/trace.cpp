@@ -0,0 +1,78 @@
+#include "trace.h"
+#include "hal.h"
+
+#ifdef TRACE_ENABLE
+
+#include "persist.h"
+#include "sdcard.h"
+
+static traceRecord_t      records[ TRACE_RECORDS ];   // ring buffer, slot is claimed by atomic increment
+static uint32_t           writePos = 0;               // free running
+static bool               tracing = false;
+
+static bool traceWrite( void * arg ) {
+  traceHeader_t header;
+  uint32_t pos = __atomic_load_n( &writePos, __ATOMIC_ACQUIRE );
+  uint32_t count = ( TRACE_RECORDS < pos ) ? TRACE_RECORDS : pos;
+  uint32_t first = ( pos - count ) & ( TRACE_RECORDS - 1 );
+  uint32_t chunk = ( TRACE_RECORDS - first < count ) ? TRACE_RECORDS - first : count;
+  bool retVal;
+
+  header.magic = TRACE_MAGIC;
+  header.cpuMhz = HAL_cpuMhz();
+  header.recordSize = sizeof( traceRecord_t );
+  header.count = count;
+  header.lost = pos - count;
+
+  retVal = ( sizeof( header ) == SDCARD_writeBulk( TRACE_FILE_PATH, (const uint8_t *)&header, sizeof( header ), false ) );
+  if( retVal && 0 < chunk ) {   // ring wraps: oldest part first
+    retVal = ( chunk * sizeof( traceRecord_t ) == SDCARD_writeBulk( TRACE_FILE_PATH, (const uint8_t *)&records[ first ], chunk * sizeof( traceRecord_t ), true ) );
+  }
+  if( retVal && count > chunk ) {
+    retVal = ( ( count - chunk ) * sizeof( traceRecord_t ) == SDCARD_writeBulk( TRACE_FILE_PATH, (const uint8_t *)&records[0], ( count - chunk ) * sizeof( traceRecord_t ), true ) );
+  }
+
+  HAL_printf( "TRACE: %u records written to %s (%u lost)\n", count, TRACE_FILE_PATH, header.lost );
+  return retVal;
+}
+
+void HAL_IRAM TRACE_Record( uint16_t id, uint8_t type, uint32_t arg ) {
+  if( !__atomic_load_n( &tracing, __ATOMIC_RELAXED ) ) {
+    return;
+  }
+
+  uint32_t pos = __atomic_fetch_add( &writePos, 1, __ATOMIC_RELAXED );
+  traceRecord_t * record = &records[ pos & ( TRACE_RECORDS - 1 ) ];
+
+  record->time = HAL_micros();
+  record->cycles = HAL_cycles();
+  record->id = id;
+  record->type = type;
+  record->core = HAL_coreId();
+  record->arg = arg;
+}
+
+void TRACE_Start( void ) {
+  __atomic_store_n( &tracing, false, __ATOMIC_RELEASE );
+  __atomic_store_n( &writePos, 0, __ATOMIC_RELEASE );
+  __atomic_store_n( &tracing, true, __ATOMIC_RELEASE );
+}
+
+bool TRACE_Dump( void ) {
+  __atomic_store_n( &tracing, false, __ATOMIC_RELEASE );   // records still being written are done before the job runs
+  return PERSIST_Submit( traceWrite, NULL, NULL );
+}
+
+#else
+
+void TRACE_Record( uint16_t id, uint8_t type, uint32_t arg ) {
+}
+
+void TRACE_Start( void ) {
+}
+
+bool TRACE_Dump( void ) {
+  return false;
+}
+
+#endif  // TRACE_ENABLE
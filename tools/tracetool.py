@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Control-loop trace dump analysis (firmware built with TRACE_ENABLE, dump made by 'trace dump' telnet command).
+
+  tracetool.py trace.bin                  latency/jitter histograms
+  tracetool.py trace.bin -o trace.json    also Chrome trace timeline (chrome://tracing or ui.perfetto.dev)
+"""
+import argparse
+import json
+import struct
+import sys
+
+TRACE_MAGIC = 0x31435254
+HEADER = struct.Struct('<IHHII')
+RECORD = struct.Struct('<IIHBBI')
+
+# keep in sync with traceId in include/trace.h
+NAMES = ['heater cycle', 'sensor read', 'PID compute', 'relay', 'GUI flush', 'heater lock', 'GUI lock', 'conf lock']
+HEATER_CYCLE, SENSOR_READ, PID_COMPUTE, RELAY = 0, 1, 2, 3
+INSTANT, BEGIN, END = 0, 1, 2
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, mhz, size, count, lost = HEADER.unpack_from(data, 0)
+    if TRACE_MAGIC != magic or RECORD.size != size:
+        sys.exit('%s: not a trace dump' % path)
+
+    records = []
+    last = None
+    high = 0
+    for x in range(count):
+        time, cycles, rid, rtype, core, arg = RECORD.unpack_from(data, HEADER.size + x * size)
+        # slot is claimed before the time is read, records of two cores (or a preempted writer) can step slightly back
+        if last is not None and last - time > 1 << 31:
+            high += 1 << 32     # esp_timer wrapped (after ~71 minutes)
+        elif last is not None and time - last > 1 << 31:
+            high -= 1 << 32     # late record from before the wrap
+        last = time
+        records.append({'t': high + time, 'cycles': cycles, 'id': rid, 'type': rtype, 'core': core, 'arg': arg})
+    records.sort(key=lambda rec: rec['t'])     # stable, order of equal times is kept
+    return mhz, lost, records
+
+
+def spans(records, mhz):
+    """Pair BEGIN/END per tracepoint and core, duration in us (cycle accurate when both ends are on one core)"""
+    open_spans = {}
+    result = {}
+    for rec in records:
+        key = (rec['id'], rec['core'])
+        if BEGIN == rec['type']:
+            open_spans[key] = rec
+        elif END == rec['type'] and key in open_spans:
+            begin = open_spans.pop(key)
+            duration = ((rec['cycles'] - begin['cycles']) & 0xFFFFFFFF) / mhz
+            result.setdefault(rec['id'], []).append((begin, rec, duration))
+    return result
+
+
+def histogram(title, values, unit='us'):
+    if not values:
+        print('%s: no data' % title)
+        return
+    values = sorted(values)
+    count = len(values)
+    pct = lambda p: values[min(count - 1, int(p * count))]
+    print('%s: %d samples, min %.1f, p50 %.1f, p99 %.1f, max %.1f [%s]'
+          % (title, count, values[0], pct(0.5), pct(0.99), values[-1], unit))
+
+    low, high = values[0], values[-1]
+    buckets = 10
+    step = (high - low) / buckets or 1
+    counts = [0] * buckets
+    for v in values:
+        counts[min(buckets - 1, int((v - low) / step))] += 1
+    scale = max(counts)
+    for x, c in enumerate(counts):
+        print('  %10.1f - %10.1f | %-40s %d' % (low + x * step, low + (x + 1) * step, '#' * (c * 40 // scale), c))
+
+
+def analyse(records, mhz):
+    span = spans(records, mhz)
+    for rid, items in sorted(span.items()):
+        histogram(NAMES[rid] + ' duration', [d for _, _, d in items])
+
+    cycles = [r['t'] for r in records if HEATER_CYCLE == r['id']]
+    histogram('heater cycle period', [(b - a) / 1000.0 for a, b in zip(cycles, cycles[1:])], 'ms')
+
+    # latency from the end of thermocouple read to the PID decision using it and to relay edges
+    reads = [end['t'] for _, end, _ in span.get(SENSOR_READ, [])]
+    def since_read(t):
+        last = None
+        for r in reads:
+            if r > t:
+                break
+            last = r
+        return None if last is None else t - last
+    pid = [since_read(end['t']) for _, end, _ in span.get(PID_COMPUTE, [])]
+    histogram('sensor read -> PID compute', [v for v in pid if v is not None])
+    relay = [since_read(r['t']) for r in records if RELAY == r['id']]
+    histogram('sensor read -> relay edge', [v for v in relay if v is not None])
+
+
+def chrome_trace(records, path):
+    events = []
+    for rec in records:
+        event = {'name': NAMES[rec['id']] if rec['id'] < len(NAMES) else str(rec['id']),
+                 'ts': rec['t'], 'pid': 0, 'tid': rec['id'], 'args': {'arg': rec['arg'], 'core': rec['core']}}
+        if INSTANT == rec['type']:
+            event.update(ph='i', s='t')
+        else:
+            event['ph'] = 'B' if BEGIN == rec['type'] else 'E'
+        events.append(event)
+    for rid, name in enumerate(NAMES):
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': rid, 'args': {'name': name}})
+    with open(path, 'w') as f:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, f)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='ElectricStove control-loop trace analysis')
+    parser.add_argument('dump', help='trace dump (trace.bin from SD card)')
+    parser.add_argument('-o', '--output', help='write Chrome trace JSON timeline')
+    args = parser.parse_args()
+
+    mhz, lost, records = load(args.dump)
+    print('%d records, %d lost, CPU %d MHz' % (len(records), lost, mhz))
+    analyse(records, mhz)
+    if args.output:
+        chrome_trace(records, args.output)
+        print('timeline written to %s' % args.output)
+
+
+if __name__ == '__main__':
+    main()